@@ -23,8 +23,6 @@
 #include <QDebug>
 #include <QtGlobal>
 
-#include "config/config.h"
-
 namespace olive {
 
 const rational AudioVisualWaveform::kMinimumSampleRate = rational(1, 8);
@@ -251,6 +249,17 @@ AudioVisualWaveform AudioVisualWaveform::Mid(const rational &offset, const ratio
   return mid;
 }
 
+qint64 AudioVisualWaveform::memory_usage() const
+{
+  qint64 sz = 0;
+
+  for (auto it=mipmapped_data_.cbegin(); it!=mipmapped_data_.cend(); it++) {
+    sz += it->second.capacity() * sizeof(SamplePerChannel);
+  }
+
+  return sz;
+}
+
 void AudioVisualWaveform::Resize(const rational &length)
 {
   if (length_ == length) {
@@ -425,7 +434,7 @@ void AudioVisualWaveform::DrawSample(QPainter *painter, const Sample& sample, in
   }
 }
 
-void AudioVisualWaveform::DrawWaveform(QPainter *painter, const QRect& rect, const double& scale, const AudioVisualWaveform &samples, const rational& start_time)
+void AudioVisualWaveform::DrawWaveform(QPainter *painter, const QRect& rect, const double& scale, const AudioVisualWaveform &samples, const rational& start_time, bool rectified)
 {
   if (samples.mipmapped_data_.empty()) {
     return;
@@ -453,9 +462,7 @@ void AudioVisualWaveform::DrawWaveform(QPainter *painter, const QRect& rect, con
   QPoint top_left = painter->transform().map(viewport.topLeft());
 
   size_t start = qMax(rect.x(), -top_left.x());
-  size_t end = qMin(rect.right(), -top_left.x() + viewport.width());
-
-  bool rectified = OLIVE_CONFIG("RectifiedWaveforms").toBool();
+  size_t end = qMin(rect.x() + rect.width(), -top_left.x() + viewport.width());
 
   for (size_t i=start;i<end;i++) {
     sample_index = next_sample_index;
@@ -98,6 +98,11 @@ public:
 
   void Resize(const rational &length);
 
+  /**
+   * @brief Number of bytes held by the sums of every mipmap
+   */
+  qint64 memory_usage() const;
+
   void TrimRange(const rational &in, const rational &length);
 
   Sample GetSummaryFromTime(const rational& start, const rational& length) const;
@@ -108,7 +113,7 @@ public:
 
   static void DrawSample(QPainter* painter, const Sample &sample, int x, int y, int height, bool rectified);
 
-  static void DrawWaveform(QPainter* painter, const QRect &rect, const double &scale, const AudioVisualWaveform& samples, const rational &start_time);
+  static void DrawWaveform(QPainter* painter, const QRect &rect, const double &scale, const AudioVisualWaveform& samples, const rational &start_time, bool rectified);
 
   // Must be a power of 2
   static const rational kMinimumSampleRate;
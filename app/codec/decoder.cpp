@@ -31,6 +31,7 @@
 #include "common/filefunctions.h"
 #include "conformmanager.h"
 #include "node/project.h"
+#include "render/rendertrace.h"
 #include "task/taskmanager.h"
 
 namespace olive {
@@ -116,7 +117,10 @@ TexturePtr Decoder::RetrieveVideo(const RetrieveVideoParams &p)
     return cached_texture_;
   }
 
-  cached_texture_ = RetrieveVideoInternal(p);
+  {
+    RenderTraceSpan span("Decoder", "Retrieve Video", p.time);
+    cached_texture_ = RetrieveVideoInternal(p);
+  }
   cached_time_ = p.time;
   cached_divider_ = p.divider;
 
@@ -272,6 +276,17 @@ TexturePtr Decoder::RetrieveVideoInternal(const RetrieveVideoParams &p)
   return nullptr;
 }
 
+bool Decoder::ExtractThumbnails(const QString &filename, int stream_index, const QVector<rational> &times, const QSize &size, CancelAtom *cancelled, const ThumbnailCallback &callback) const
+{
+  Q_UNUSED(filename)
+  Q_UNUSED(stream_index)
+  Q_UNUSED(times)
+  Q_UNUSED(size)
+  Q_UNUSED(cancelled)
+  Q_UNUSED(callback)
+  return false;
+}
+
 bool Decoder::ConformAudioInternal(const QVector<QString> &filenames, const AudioParams &params, CancelAtom *cancelled)
 {
   Q_UNUSED(filenames)
@@ -25,7 +25,9 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
+#include <functional>
 #include <QFileInfo>
+#include <QImage>
 #include <QMutex>
 #include <QObject>
 #include <QWaitCondition>
@@ -212,6 +214,21 @@ public:
    */
   virtual FootageDescription Probe(const QString& filename, CancelAtom *cancelled) const = 0;
 
+  using ThumbnailCallback = std::function<void(const rational &time, const QImage &image)>;
+
+  /**
+   * @brief Quickly decode small previews of a video stream for thumbnails
+   *
+   * Unlike RetrieveVideo(), this doesn't require the decoder to be open, isn't color managed, and
+   * may show a nearby frame rather than the exact one. `callback` is called in order for each of
+   * `times` that a thumbnail could be made for, with an image that fits within `size`.
+   *
+   * Returns FALSE if this decoder has no such fast path or the file couldn't be read, in which
+   * case thumbnails should be rendered normally. Even on success, any times the callback wasn't
+   * called for should be rendered normally. Like Probe(), this function is re-entrant.
+   */
+  virtual bool ExtractThumbnails(const QString &filename, int stream_index, const QVector<rational> &times, const QSize &size, CancelAtom *cancelled, const ThumbnailCallback &callback) const;
+
   /**
    * @brief Closes media/deallocates memory
    *
@@ -42,7 +42,9 @@ extern "C" {
 #include "codec/planarfiledevice.h"
 #include "common/ffmpegutils.h"
 #include "common/filefunctions.h"
+#include "render/memorymanager.h"
 #include "render/renderer.h"
+#include "render/rendertrace.h"
 #include "render/subtitleparams.h"
 
 namespace olive {
@@ -53,6 +55,7 @@ QVariant DeinterlaceShader;
 FFmpegDecoder::FFmpegDecoder() :
   sws_ctx_(nullptr),
   working_packet_(nullptr),
+  cached_frames_bytes_(0),
   cache_at_zero_(false),
   cache_at_eof_(false)
 {
@@ -89,8 +92,7 @@ TexturePtr FFmpegDecoder::ProcessFrameIntoTexture(AVFramePtr f, const RetrieveVi
                  VideoParams::kInterlaceNone,
                  p.divider);
 
-  // Create texture
-  TexturePtr tex = p.renderer->CreateTexture(vp);
+  TexturePtr tex;
 
   switch (f->format) {
   case AV_PIX_FMT_YUV420P:
@@ -142,7 +144,11 @@ TexturePtr FFmpegDecoder::ProcessFrameIntoTexture(AVFramePtr f, const RetrieveVi
     plane_params.set_channel_count(1);
     plane_params.set_format(native_fmt);
 
-    TexturePtr y_plane = p.renderer->CreateTexture(plane_params, hw_in->data[0], hw_in->linesize[0] / px_size);
+    // Planes are only intermediates for the conversion below, so stream them through the upload
+    // ring rather than allocating new textures every frame
+    upload_ring_.Advance();
+
+    TexturePtr y_plane = upload_ring_.Upload(p.renderer, 0, plane_params, hw_in->data[0], hw_in->linesize[0] / px_size);
 
     switch (f->format) {
     case AV_PIX_FMT_YUV420P:
@@ -163,8 +169,12 @@ TexturePtr FFmpegDecoder::ProcessFrameIntoTexture(AVFramePtr f, const RetrieveVi
       break;
     }
 
-    TexturePtr u_plane = p.renderer->CreateTexture(plane_params, hw_in->data[1], hw_in->linesize[1] / px_size);
-    TexturePtr v_plane = p.renderer->CreateTexture(plane_params, hw_in->data[2], hw_in->linesize[2] / px_size);
+    TexturePtr u_plane = upload_ring_.Upload(p.renderer, 1, plane_params, hw_in->data[1], hw_in->linesize[1] / px_size);
+    TexturePtr v_plane = upload_ring_.Upload(p.renderer, 2, plane_params, hw_in->data[2], hw_in->linesize[2] / px_size);
+
+    if (!y_plane || !u_plane || !v_plane) {
+      return nullptr;
+    }
 
     ShaderJob job;
     job.Insert(QStringLiteral("y_channel"), NodeValue(NodeValue::kTexture, QVariant::fromValue(y_plane)));
@@ -186,7 +196,10 @@ TexturePtr FFmpegDecoder::ProcessFrameIntoTexture(AVFramePtr f, const RetrieveVi
   case AV_PIX_FMT_RGBA:
   case AV_PIX_FMT_RGBA64LE:
     // RGBA can be uploaded directly to the texture
-    tex->Upload(f->data[0], f->linesize[0] / vp.GetBytesPerPixel());
+    tex = p.renderer->CreateTexture(vp, f->data[0], f->linesize[0] / vp.GetBytesPerPixel());
+    break;
+  default:
+    tex = p.renderer->CreateTexture(vp);
     break;
   }
 
@@ -270,6 +283,8 @@ void FFmpegDecoder::CloseInternal()
   ClearFrameCache();
   FreeScaler();
 
+  upload_ring_.Release();
+
   instance_.Close();
 }
 
@@ -536,6 +551,123 @@ FootageDescription FFmpegDecoder::Probe(const QString &filename, CancelAtom *can
   return desc;
 }
 
+bool FFmpegDecoder::ExtractThumbnails(const QString &filename, int stream_index, const QVector<rational> &times, const QSize &size, CancelAtom *cancelled, const ThumbnailCallback &callback) const
+{
+  Instance instance;
+  instance.SetPreviewSize(size);
+  if (!instance.Open(filename.toUtf8().constData(), stream_index)) {
+    return false;
+  }
+
+  AVStream *avstream = instance.avstream();
+
+  int64_t start_ts = 0;
+  if (instance.fmt_ctx()->start_time != AV_NOPTS_VALUE) {
+    start_ts = av_rescale_q(instance.fmt_ctx()->start_time, {1, AV_TIME_BASE}, avstream->time_base);
+  }
+
+  // Past this distance, seeking is cheaper than reading through the packets in between
+  const int64_t max_read_ahead = Timecode::time_to_timestamp(rational(5), avstream->time_base);
+
+  AVPacket *pkt = av_packet_alloc();
+  SwsContext *scaler = nullptr;
+
+  // The last keyframe at or before the current time, and the first one after it
+  AVFramePtr current;
+  AVFramePtr next;
+  bool eof = false;
+
+  QImage image;
+  int64_t image_ts = AV_NOPTS_VALUE;
+
+  for (const rational &time : times) {
+    if (cancelled && cancelled->IsCancelled()) {
+      break;
+    }
+
+    int64_t target_ts = Timecode::time_to_timestamp(time, avstream->time_base) + start_ts;
+
+    if (!current
+        || target_ts < current->best_effort_timestamp
+        || (target_ts - current->best_effort_timestamp > max_read_ahead && !(next && next->best_effort_timestamp > target_ts))) {
+      instance.Seek(target_ts);
+      current = nullptr;
+      next = nullptr;
+      eof = false;
+    }
+
+    // With AVDISCARD_NONKEY set, every frame that comes out of the decoder is a keyframe
+    while (!eof && (!next || next->best_effort_timestamp <= target_ts)) {
+      if (next) {
+        current = next;
+      }
+
+      next = CreateAVFramePtr();
+      if (instance.GetFrame(pkt, next.get()) < 0) {
+        next = nullptr;
+        eof = true;
+      }
+    }
+
+    if (!current) {
+      // Seeking landed after the target, the next keyframe is as close as we can get
+      current = next;
+      next = nullptr;
+    }
+
+    if (!current) {
+      break;
+    }
+
+    if (current->best_effort_timestamp != image_ts || image.isNull()) {
+      AVFrame *f = current.get();
+
+      AVRational sar = av_guess_sample_aspect_ratio(instance.fmt_ctx(), avstream, f);
+      double par = (sar.num > 0 && sar.den > 0) ? av_q2d(sar) : 1.0;
+
+      QSize dst_size = QSize(qRound(f->width * par), f->height).scaled(size, Qt::KeepAspectRatio);
+      dst_size = dst_size.expandedTo(QSize(1, 1));
+
+      scaler = sws_getCachedContext(scaler,
+                                    f->width,
+                                    f->height,
+                                    static_cast<AVPixelFormat>(f->format),
+                                    dst_size.width(),
+                                    dst_size.height(),
+                                    AV_PIX_FMT_RGB24,
+                                    SWS_BILINEAR,
+                                    nullptr,
+                                    nullptr,
+                                    nullptr);
+      if (!scaler) {
+        break;
+      }
+
+      int full_range = (f->color_range == AVCOL_RANGE_JPEG) ? 1 : 0;
+      sws_setColorspaceDetails(scaler,
+                               sws_getCoefficients(FFmpegUtils::GetSwsColorspaceFromAVColorSpace(f->colorspace)),
+                               full_range,
+                               sws_getCoefficients(FFmpegUtils::GetSwsColorspaceFromAVColorSpace(f->colorspace)),
+                               1,
+                               0, 0x10000, 0x10000);
+
+      image = QImage(dst_size, QImage::Format_RGB888);
+      uint8_t *dst_data[4] = {image.bits(), nullptr, nullptr, nullptr};
+      int dst_linesize[4] = {int(image.bytesPerLine()), 0, 0, 0};
+      sws_scale(scaler, f->data, f->linesize, 0, f->height, dst_data, dst_linesize);
+
+      image_ts = current->best_effort_timestamp;
+    }
+
+    callback(time, image);
+  }
+
+  sws_freeContext(scaler);
+  av_packet_free(&pkt);
+
+  return !image.isNull();
+}
+
 QString FFmpegDecoder::FFmpegError(int error_code)
 {
   char err[1024];
@@ -733,6 +865,8 @@ void FFmpegDecoder::ClearFrameCache()
 {
   if (!cached_frames_.empty()) {
     cached_frames_.clear();
+    MemoryManager::Released(MemoryManager::kDecoderFrames, cached_frames_bytes_);
+    cached_frames_bytes_ = 0;
     cache_at_eof_ = false;
     cache_at_zero_ = false;
   }
@@ -936,6 +1070,10 @@ AVFramePtr FFmpegDecoder::RetrieveFrame(const rational& time, CancelAtom *cancel
       // Append this frame and signal to other threads that a new frame has arrived
       cached_frames_.push_back(filtered);
 
+      qint64 filtered_sz = GetFrameMemoryUsage(filtered.get());
+      cached_frames_bytes_ += filtered_sz;
+      MemoryManager::Allocated(MemoryManager::kDecoderFrames, filtered_sz);
+
       // If this is a valid frame, see if this or the frame before it are the one we need
       if (filtered->pts == target_ts || time == kAnyTimecode) {
         return_frame = filtered;
@@ -1004,10 +1142,25 @@ AVFramePtr FFmpegDecoder::GetFrameFromCache(const int64_t &t) const
 
 void FFmpegDecoder::RemoveFirstFrame()
 {
+  qint64 sz = GetFrameMemoryUsage(cached_frames_.front().get());
+  cached_frames_bytes_ -= sz;
+  MemoryManager::Released(MemoryManager::kDecoderFrames, sz);
+
   cached_frames_.pop_front();
   cache_at_zero_ = false;
 }
 
+qint64 FFmpegDecoder::GetFrameMemoryUsage(const AVFrame *f)
+{
+  qint64 sz = 0;
+
+  for (int i=0; i<AV_NUM_DATA_POINTERS && f->buf[i]; i++) {
+    sz += f->buf[i]->size;
+  }
+
+  return sz;
+}
+
 int FFmpegDecoder::MaximumQueueSize()
 {
   // Fairly arbitrary size. This used to need to be the number of current threads to ensure any
@@ -1076,6 +1229,24 @@ bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index)
     return false;
   }
 
+  if (!preview_size_.isEmpty()) {
+    codec_ctx_->skip_frame = AVDISCARD_NONKEY;
+    codec_ctx_->skip_loop_filter = AVDISCARD_ALL;
+
+    // Have codecs that support it decode at 1/2, 1/4 or 1/8 size
+    int lowres = 0;
+    while (lowres < codec->max_lowres
+           && (codec_ctx_->width >> (lowres + 1)) >= preview_size_.width()
+           && (codec_ctx_->height >> (lowres + 1)) >= preview_size_.height()) {
+      lowres++;
+    }
+    codec_ctx_->lowres = lowres;
+
+    // Frame threading holds frames back until every thread has one, which only adds latency when
+    // we want one keyframe at a time
+    codec_ctx_->thread_type = FF_THREAD_SLICE;
+  }
+
   // Set multithreading setting
   error_code = av_dict_set(&opts_, "threads", "auto", 0);
 
@@ -1116,6 +1287,8 @@ void FFmpegDecoder::Instance::Close()
 
 int FFmpegDecoder::Instance::GetFrame(AVPacket *pkt, AVFrame *frame)
 {
+  RenderTraceSpan span("Decoder", "Decode Frame");
+
   bool eof = false;
 
   int ret;
@@ -1188,6 +1361,8 @@ int FFmpegDecoder::Instance::GetPacket(AVPacket *pkt)
 
 void FFmpegDecoder::Instance::Seek(int64_t timestamp)
 {
+  RenderTraceSpan span("Decoder", "Seek");
+
   avcodec_flush_buffers(codec_ctx_);
   av_seek_frame(fmt_ctx_, avstream_->index, timestamp, AVSEEK_FLAG_BACKWARD);
 }
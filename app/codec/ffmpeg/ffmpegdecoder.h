@@ -38,6 +38,7 @@ extern "C" {
 
 #include "codec/decoder.h"
 #include "common/ffmpegutils.h"
+#include "render/textureuploadring.h"
 
 namespace olive {
 
@@ -61,6 +62,8 @@ public:
 
   virtual FootageDescription Probe(const QString &filename, CancelAtom *cancelled) const override;
 
+  virtual bool ExtractThumbnails(const QString &filename, int stream_index, const QVector<rational> &times, const QSize &size, CancelAtom *cancelled, const ThumbnailCallback &callback) const override;
+
 protected:
   virtual bool OpenInternal() override;
   virtual TexturePtr RetrieveVideoInternal(const RetrieveVideoParams& p) override;
@@ -82,6 +85,16 @@ private:
 
     bool Open(const char* filename, int stream_index);
 
+    /**
+     * @brief Only decode keyframes, at the lowest resolution that's still at least this size
+     *
+     * Must be set before Open().
+     */
+    void SetPreviewSize(const QSize &size)
+    {
+      preview_size_ = size;
+    }
+
     bool IsOpen() const
     {
       return fmt_ctx_;
@@ -121,6 +134,7 @@ private:
     AVCodecContext* codec_ctx_;
     AVStream* avstream_;
     AVDictionary* opts_;
+    QSize preview_size_;
 
   };
 
@@ -157,6 +171,8 @@ private:
 
   void RemoveFirstFrame();
 
+  static qint64 GetFrameMemoryUsage(const AVFrame *f);
+
   static int MaximumQueueSize();
 
   SwsContext *sws_ctx_;
@@ -174,12 +190,15 @@ private:
   int64_t second_ts_;
 
   std::list<AVFramePtr> cached_frames_;
+  qint64 cached_frames_bytes_;
 
   bool cache_at_zero_;
   bool cache_at_eof_;
 
   Instance instance_;
 
+  TextureUploadRing upload_ring_;
+
 };
 
 }
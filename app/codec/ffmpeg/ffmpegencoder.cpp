@@ -29,6 +29,7 @@ extern "C" {
 #include <QFile>
 
 #include "common/ffmpegutils.h"
+#include "render/rendertrace.h"
 
 namespace olive {
 
@@ -240,6 +241,8 @@ bool FFmpegEncoder::Open()
 
 bool FFmpegEncoder::WriteFrame(FramePtr frame, rational time)
 {
+  RenderTraceSpan span("Encode", "Encode Frame", time);
+
   // We may need to convert this frame to a frame that swscale will understand
   if (frame->format() != video_conversion_fmt_) {
     frame = frame->convert(video_conversion_fmt_);
@@ -20,6 +20,8 @@
 
 #include "xmlutils.h"
 
+#include <QXmlStreamWriter>
+
 #include "node/block/block.h"
 #include "node/factory.h"
 
@@ -42,4 +44,24 @@ bool XMLReadNextStartElement(QXmlStreamReader *reader, CancelAtom *cancel_atom)
   return false;
 }
 
+QString XMLCopyCurrentElement(QXmlStreamReader *reader)
+{
+  QString copy;
+  QXmlStreamWriter writer(&copy);
+
+  int depth = 0;
+
+  do {
+    if (reader->isStartElement()) {
+      depth++;
+    } else if (reader->isEndElement()) {
+      depth--;
+    }
+
+    writer.writeCurrentToken(*reader);
+  } while (depth > 0 && reader->readNext() != QXmlStreamReader::Invalid);
+
+  return copy;
+}
+
 }
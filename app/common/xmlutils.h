@@ -48,6 +48,14 @@ class NodeGroup;
  */
 bool XMLReadNextStartElement(QXmlStreamReader* reader, CancelAtom *cancel_atom = nullptr);
 
+/**
+ * @brief Copy the element the reader is on, including everything inside it, into a new document
+ *
+ * Leaves the reader at the end of the element as skipCurrentElement() would, so the copy can be
+ * parsed later or on another thread with its own QXmlStreamReader.
+ */
+QString XMLCopyCurrentElement(QXmlStreamReader* reader);
+
 }
 
 #endif // XMLREADLOOP_H
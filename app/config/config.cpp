@@ -90,6 +90,7 @@ void Config::SetDefaults()
   SetEntryInternal(QStringLiteral("AutoscaleByDefault"), NodeValue::kBoolean, false);
   SetEntryInternal(QStringLiteral("Autoscroll"), NodeValue::kInt, AutoScroll::kPage);
   SetEntryInternal(QStringLiteral("AutoSelectDivider"), NodeValue::kBoolean, true);
+  SetEntryInternal(QStringLiteral("AutoPlaybackResolution"), NodeValue::kBoolean, true);
   SetEntryInternal(QStringLiteral("SetNameWithMarker"), NodeValue::kBoolean, false);
   SetEntryInternal(QStringLiteral("RectifiedWaveforms"), NodeValue::kBoolean, true);
   SetEntryInternal(QStringLiteral("DropWithoutSequenceBehavior"), NodeValue::kInt, ImportTool::kDWSAsk);
@@ -105,6 +106,11 @@ void Config::SetDefaults()
   SetEntryInternal(QStringLiteral("ReassocLinToNonLin"), NodeValue::kBoolean, false);
   SetEntryInternal(QStringLiteral("PreviewNonFloatDontAskAgain"), NodeValue::kBoolean, false);
   SetEntryInternal(QStringLiteral("UseGLFinish"), NodeValue::kBoolean, false);
+  SetEntryInternal(QStringLiteral("TexturePoolMaximumSize"), NodeValue::kInt, 2048);
+  SetEntryInternal(QStringLiteral("StillImageCacheSize"), NodeValue::kInt, 512);
+  SetEntryInternal(QStringLiteral("ThumbnailMemoryCacheSize"), NodeValue::kInt, 128);
+  SetEntryInternal(QStringLiteral("MemoryBudget"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("FrameHugePages"), NodeValue::kBoolean, true);
 
   SetEntryInternal(QStringLiteral("TimelineThumbnailMode"), NodeValue::kInt, Timeline::kThumbnailInOut);
   SetEntryInternal(QStringLiteral("TimelineWaveformMode"), NodeValue::kInt, Timeline::kWaveformsEnabled);
@@ -29,6 +29,7 @@
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QStyleFactory>
+#include <QtConcurrent/QtConcurrent>
 #include "window/mainwindow/mainwindowundo.h"
 #ifdef Q_OS_WINDOWS
 #include <QtPlatformHeaders/QWindowsWindowFunctions>
@@ -60,7 +61,9 @@
 #include "panel/viewer/viewer.h"
 #include "render/diskmanager.h"
 #include "render/framemanager.h"
+#include "render/memorymanager.h"
 #include "render/rendermanager.h"
+#include "render/thumbnailservice.h"
 #ifdef USE_OTIO
 #include "task/project/loadotio/loadotio.h"
 #include "task/project/saveotio/saveotio.h"
@@ -90,6 +93,8 @@ Core::Core(const CoreParams& params) :
   snapping_(true),
   core_params_(params),
   magic_(false),
+  autorecovery_snapshot_(nullptr),
+  autorecovery_project_modified_(false),
   pixel_sampling_users_(0),
   shown_cache_full_warning_(false)
 {
@@ -148,12 +153,18 @@ void Core::Start()
   // Initialize ConformManager
   ConformManager::CreateInstance();
 
+  // Initialize MemoryManager before anything that registers with it
+  MemoryManager::CreateInstance();
+
   // Initialize RenderManager
   RenderManager::CreateInstance();
 
   // Initialize FrameManager
   FrameManager::CreateInstance();
 
+  // Initialize ThumbnailService
+  ThumbnailService::CreateInstance();
+
   // Initialize project serializers
   ProjectSerializer::Initialize();
 
@@ -194,6 +205,11 @@ void Core::Start()
 
 void Core::Stop()
 {
+  // Make sure an auto-recovery still being written in the background makes it to disk
+  autorecovery_watcher_.waitForFinished();
+  delete autorecovery_snapshot_;
+  autorecovery_snapshot_ = nullptr;
+
   // Assume all projects have closed gracefully and no auto-recovery is necessary
   autorecovered_projects_.clear();
   SaveUnrecoveredList();
@@ -207,8 +223,12 @@ void Core::Stop()
 
   FrameManager::DestroyInstance();
 
+  ThumbnailService::DestroyInstance();
+
   RenderManager::DestroyInstance();
 
+  MemoryManager::DestroyInstance();
+
   MenuShared::DestroyInstance();
 
   TaskManager::DestroyInstance();
@@ -780,6 +800,7 @@ void Core::StartGUI(bool full_screen)
   // Start autorecovery timer using the config value as its interval
   SetAutorecoveryInterval(OLIVE_CONFIG("AutorecoveryInterval").toInt());
   connect(&autorecovery_timer_, &QTimer::timeout, this, &Core::SaveAutorecovery);
+  connect(&autorecovery_watcher_, &QFutureWatcher<bool>::finished, this, &Core::AutorecoveryFinished);
   autorecovery_timer_.start();
 
   // Load recently opened projects list
@@ -813,8 +834,15 @@ void Core::SaveProjectInternal(const QString& override_filename)
     return;
 #endif
   } else {
-    bool use_compression = !open_project_->filename().endsWith(QStringLiteral(".ovexml"), Qt::CaseInsensitive);
-    psm = new ProjectSaveTask(open_project_, use_compression);
+    ProjectSerializer::Format format;
+    if (open_project_->filename().endsWith(QStringLiteral(".ovexml"), Qt::CaseInsensitive)) {
+      format = ProjectSerializer::kXml;
+    } else if (open_project_->filename().endsWith(QStringLiteral(".ovebin"), Qt::CaseInsensitive)) {
+      format = ProjectSerializer::kBinary;
+    } else {
+      format = ProjectSerializer::kCompressedXml;
+    }
+    psm = new ProjectSaveTask(open_project_, format);
     static_cast<ProjectSaveTask*>(psm)->SetLayout(main_window_->SaveLayout());
 
     if (!override_filename.isEmpty()) {
@@ -954,20 +982,22 @@ void Core::SaveAutorecovery()
 {
   if (OLIVE_CONFIG("AutorecoveryEnabled").toBool()) {
     if (open_project_ && !open_project_->has_autorecovery_been_saved()) {
+      if (autorecovery_watcher_.isRunning()) {
+        // Previous auto-recovery is still being written, try again next time
+        return;
+      }
+
       QDir project_autorecovery_dir(QDir(FileFunctions::GetAutoRecoveryRoot()).filePath(open_project_->GetUuid().toString()));
       if (FileFunctions::DirectoryIsValid(project_autorecovery_dir)) {
         QString this_autorecovery_path = project_autorecovery_dir.filePath(QStringLiteral("%1.ove").arg(QString::number(QDateTime::currentSecsSinceEpoch())));
 
-        SaveProjectInternal(this_autorecovery_path);
-
-        open_project_->set_autorecovery_saved(true);
-
-        // Keep track of projects that where the "newest" save is the recovery project
-        if (!autorecovered_projects_.contains(open_project_->GetUuid())) {
-          autorecovered_projects_.append(open_project_->GetUuid());
-        }
-
-        qDebug() << "Saved auto-recovery to:" << this_autorecovery_path;
+        // The project can only be read from this thread, so take a copy of it that the background
+        // thread can serialize, encode and write to disk without stalling the UI
+        QHash<Node*, Node*> copies;
+        autorecovery_snapshot_ = open_project_->CreateSnapshot(&copies);
+        autorecovery_project_ = open_project_;
+        autorecovery_project_modified_ = false;
+        connect(open_project_, &Project::ModifiedChanged, this, &Core::AutorecoveryProjectModified);
 
         // Write human-readable real name so it's not just a UUID
         {
@@ -982,29 +1012,9 @@ void Core::SaveAutorecovery()
         // Since we write an extra file, increment total allowed files by 1
         max_recoveries_per_file++;
 
-        // Delete old entries
-        QStringList recovery_files = project_autorecovery_dir.entryList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
-        while (recovery_files.size() > max_recoveries_per_file) {
-          bool deleted = false;
-          for (int i=0; i<recovery_files.size(); i++) {
-            const QString& f = recovery_files.at(i);
-
-            if (f.endsWith(QStringLiteral(".ove"), Qt::CaseInsensitive)) {
-              QString delete_full_path = project_autorecovery_dir.filePath(f);
-              qDebug() << "Deleted old recovery:" << delete_full_path;
-              QFile::remove(delete_full_path);
-              recovery_files.removeAt(i);
-              deleted = true;
-              break;
-            }
-          }
-
-          if (!deleted) {
-            // For some reason none of the files were deletable. Break so we don't end up in
-            // an infinite loop.
-            break;
-          }
-        }
+        autorecovery_watcher_.setFuture(QtConcurrent::run(&Core::WriteAutorecovery, autorecovery_snapshot_,
+                                                          main_window_->SaveLayout().MapNodes(copies),
+                                                          this_autorecovery_path, max_recoveries_per_file));
       } else {
         QMessageBox::critical(main_window_, tr("Auto-Recovery Error"),
                               tr("Failed to save auto-recovery to \"%1\". "
@@ -1012,10 +1022,87 @@ void Core::SaveAutorecovery()
                               .arg(project_autorecovery_dir.absolutePath()));
       }
     }
+  }
+}
+
+void Core::AutorecoveryFinished()
+{
+  if (!autorecovery_snapshot_) {
+    // Already cleaned up by Stop()
+    return;
+  }
+
+  if (autorecovery_project_) {
+    disconnect(autorecovery_project_, &Project::ModifiedChanged, this, &Core::AutorecoveryProjectModified);
+  }
+
+  if (autorecovery_watcher_.result()) {
+    // Only mark the project as recovered if what was written is still what the project looks like
+    if (autorecovery_project_ && !autorecovery_project_modified_) {
+      autorecovery_project_->set_autorecovery_saved(true);
+    }
+
+    // Keep track of projects that where the "newest" save is the recovery project
+    const QUuid &uuid = autorecovery_snapshot_->GetUuid();
+    if ((!autorecovery_project_ || autorecovery_project_->is_modified()) && !autorecovered_projects_.contains(uuid)) {
+      autorecovered_projects_.append(uuid);
+    }
 
     // Save index
     SaveUnrecoveredList();
   }
+
+  delete autorecovery_snapshot_;
+  autorecovery_snapshot_ = nullptr;
+  autorecovery_project_ = nullptr;
+}
+
+void Core::AutorecoveryProjectModified()
+{
+  autorecovery_project_modified_ = true;
+}
+
+bool Core::WriteAutorecovery(Project *snapshot, const MainWindowLayoutInfo &layout, const QString &filename, int64_t max_recoveries_per_file)
+{
+  ProjectSerializer::SaveData data(ProjectSerializer::kProject, snapshot, filename);
+  data.SetLayout(layout);
+
+  // Binary projects are still loaded through XML, so they aren't any quicker to recover from than
+  // the default format
+  ProjectSerializer::Result r = ProjectSerializer::Save(data, ProjectSerializer::kCompressedXml);
+  if (r != ProjectSerializer::kSuccess) {
+    qWarning() << "Failed to save auto-recovery to:" << filename << r.GetDetails();
+    return false;
+  }
+
+  qDebug() << "Saved auto-recovery to:" << filename;
+
+  // Delete old entries
+  QDir project_autorecovery_dir = QFileInfo(filename).dir();
+  QStringList recovery_files = project_autorecovery_dir.entryList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+  while (recovery_files.size() > max_recoveries_per_file) {
+    bool deleted = false;
+    for (int i=0; i<recovery_files.size(); i++) {
+      const QString& f = recovery_files.at(i);
+
+      if (f.endsWith(QStringLiteral(".ove"), Qt::CaseInsensitive)) {
+        QString delete_full_path = project_autorecovery_dir.filePath(f);
+        qDebug() << "Deleted old recovery:" << delete_full_path;
+        QFile::remove(delete_full_path);
+        recovery_files.removeAt(i);
+        deleted = true;
+        break;
+      }
+    }
+
+    if (!deleted) {
+      // For some reason none of the files were deletable. Break so we don't end up in
+      // an infinite loop.
+      break;
+    }
+  }
+
+  return true;
 }
 
 void Core::ProjectSaveSucceeded(Task* task)
@@ -1085,6 +1172,9 @@ QString Core::GetProjectFilter(bool include_any_filter)
     // Uncompressed XML Olive project
     {tr("Olive Project (Uncompressed XML)"), QStringLiteral("ovexml")},
 
+    // Binary Olive project, quicker to open and save than XML
+    {tr("Olive Project (Binary)"), QStringLiteral("ovebin")},
+
     // OpenTimelineIO project, if available
 #ifdef USE_OTIO
     {tr("OpenTimelineIO"), QStringLiteral("otio")}
@@ -23,7 +23,9 @@
 
 #include <olive/core/core.h>
 #include <QFileInfoList>
+#include <QFutureWatcher>
 #include <QList>
+#include <QPointer>
 #include <QTimer>
 #include <QTranslator>
 
@@ -495,6 +497,14 @@ private:
 
   void SaveUnrecoveredList();
 
+  /**
+   * @brief Serialize and write a project snapshot taken by SaveAutorecovery(), then delete the
+   * oldest auto-recoveries over the limit
+   *
+   * Runs in a background thread, so must only touch the snapshot, never the open project.
+   */
+  static bool WriteAutorecovery(Project *snapshot, const MainWindowLayoutInfo &layout, const QString &filename, int64_t max_recoveries_per_file);
+
   bool RevertProjectInternal(bool by_opening_existing);
 
   void SaveRecentProjectsList();
@@ -543,6 +553,22 @@ private:
    */
   QTimer autorecovery_timer_;
 
+  /**
+   * @brief Auto-recovery currently being written in the background, if any
+   */
+  QFutureWatcher<bool> autorecovery_watcher_;
+
+  /**
+   * @brief Project the running auto-recovery was taken from, and the snapshot being written
+   */
+  QPointer<Project> autorecovery_project_;
+  Project *autorecovery_snapshot_;
+
+  /**
+   * @brief Set if the project changed while its auto-recovery was being written
+   */
+  bool autorecovery_project_modified_;
+
   /**
    * @brief Application-wide undo stack instance
    */
@@ -586,8 +612,15 @@ private:
   bool shown_cache_full_warning_;
 
 private slots:
+  /**
+   * @brief Snapshot the open project and write it as an auto-recovery in the background
+   */
   void SaveAutorecovery();
 
+  void AutorecoveryFinished();
+
+  void AutorecoveryProjectModified();
+
   void ProjectSaveSucceeded(Task *task);
 
   bool AddOpenProjectFromTaskAndAddToRecents(Task* task)
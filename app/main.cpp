@@ -41,6 +41,7 @@ extern "C" {
 #include "core.h"
 #include "common/commandlineparser.h"
 #include "common/debug.h"
+#include "node/project/serializer/binaryformat.h"
 #include "node/project/serializer/serializer.h"
 #include "version.h"
 
@@ -70,17 +71,21 @@ int decompress_project(const QString &project)
 
   printf("%s\n", QCoreApplication::translate("main", "Decompressing project...").toUtf8().constData());
 
-  if (!olive::ProjectSerializer::CheckCompressedID(&project_file)) {
+  QByteArray decompressed;
+
+  if (olive::ProjectSerializer::CheckCompressedID(&project_file)) {
+    decompressed = qUncompress(project_file.readAll());
+  } else if (project_file.seek(0) && olive::ProjectSerializer::CheckBinaryID(&project_file)) {
+    project_file.seek(0);
+    QByteArray b = project_file.readAll();
+    olive::ProjectBinaryFormat::ToXml(reinterpret_cast<const uchar*>(b.constData()), b.size(), &decompressed);
+  } else {
     printf("%s\n", QCoreApplication::translate("main", "Failed to decompress, project may be corrupt").toUtf8().constData());
     return 1;
   }
 
-  QByteArray b = project_file.readAll();
-
   project_file.close();
 
-  QByteArray decompressed = qUncompress(b);
-
   if (decompressed.isEmpty()) {
     printf("%s\n", QCoreApplication::translate("main", "Failed to decompress, project may be corrupt").toUtf8().constData());
     return 1;
@@ -174,7 +179,7 @@ int main(int argc, char *argv[])
 
   auto decompress_option =
       parser.AddOption({QStringLiteral("d"), QStringLiteral("-decompress")},
-                       QCoreApplication::translate("main", "Decompress project file (No GUI)"));
+                       QCoreApplication::translate("main", "Decompress or convert a binary project file to XML (No GUI)"));
 
 #ifdef _WIN32
   auto console_option =
@@ -420,6 +420,7 @@ void ClipBlock::InputConnectedEvent(const QString &input, int element, Node *out
     connect(output->waveform_cache(), &AudioPlaybackCache::Validated, this, &Block::PreviewChanged);
     connect(output->video_frame_cache(), &FrameHashCache::Validated, this, &Block::PreviewChanged);
     connect(output->audio_playback_cache(), &AudioPlaybackCache::Validated, this, &Block::PreviewChanged);
+    connect(output->waveform_cache(), &AudioWaveformCache::TilesReady, this, &Block::PreviewChanged);
   }
 }
 
@@ -436,6 +437,7 @@ void ClipBlock::InputDisconnectedEvent(const QString &input, int element, Node *
     disconnect(output->waveform_cache(), &AudioPlaybackCache::Validated, this, &Block::PreviewChanged);
     disconnect(output->video_frame_cache(), &FrameHashCache::Validated, this, &Block::PreviewChanged);
     disconnect(output->audio_playback_cache(), &AudioPlaybackCache::Validated, this, &Block::PreviewChanged);
+    disconnect(output->waveform_cache(), &AudioWaveformCache::TilesReady, this, &Block::PreviewChanged);
   }
 }
 
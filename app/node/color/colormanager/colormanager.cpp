@@ -27,6 +27,7 @@
 #include "common/filefunctions.h"
 #include "config/config.h"
 #include "core.h"
+#include "render/colorprocessorcache.h"
 
 namespace olive {
 
@@ -244,9 +245,16 @@ void ColorManager::UpdateConfigFromFilename()
   try {
     QString config_filename = GetConfigFilename();
     QString old_default_cs = GetDefaultInputColorSpace();
+    OCIO::ConstConfigRcPtr old_config = config_;
 
     config_ = OCIO::Config::CreateFromFile(config_filename.toUtf8());
 
+    // The default config is shared with every other ColorManager, so its processors stay cached
+    if (old_config && old_config != default_config_
+        && qstrcmp(old_config->getCacheID(), config_->getCacheID()) != 0) {
+      ColorProcessorCache::RemoveConfig(old_config);
+    }
+
     // Set new default colorspace appropriately
     QString new_default = old_default_cs;
     QStringList available_cs = ListAvailableColorspaces();
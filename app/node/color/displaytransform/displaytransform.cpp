@@ -21,6 +21,7 @@
 #include "displaytransform.h"
 
 #include "node/color/colormanager/colormanager.h"
+#include "render/colorprocessorcache.h"
 
 namespace olive {
 
@@ -137,7 +138,7 @@ void DisplayTransformNode::GenerateProcessor()
 {
   if (manager()) {
     ColorTransform transform(GetDisplay(), GetView(), QString());
-    set_processor(ColorProcessor::Create(manager(), manager()->GetReferenceColorSpace(), transform, GetDirection()));
+    set_processor(ColorProcessorCache::Get(manager(), manager()->GetReferenceColorSpace(), transform, GetDirection()));
   }
 }
 
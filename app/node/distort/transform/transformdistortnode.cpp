@@ -126,6 +126,27 @@ ShaderCode TransformDistortNode::GetShaderCode(const ShaderRequest &request) con
   return ShaderCode();
 }
 
+QRectF TransformDistortNode::GetInputRegionOfInterest(const QString &input, const QRectF &output_region, const AcceleratedJob *job) const
+{
+  if (input == QStringLiteral("ove_maintex")) {
+    bool invertible;
+    QMatrix4x4 inverse = job->Get(QStringLiteral("ove_mvpmat")).toMatrix().inverted(&invertible);
+
+    if (invertible) {
+      // Output texture coordinates -> output clip space -> input quad -> input texture coordinates
+      QRectF clip(output_region.x() * 2.0 - 1.0, output_region.y() * 2.0 - 1.0,
+                  output_region.width() * 2.0, output_region.height() * 2.0);
+
+      QRectF quad = inverse.mapRect(clip);
+
+      return QRectF((quad.x() + 1.0) * 0.5, (quad.y() + 1.0) * 0.5,
+                    quad.width() * 0.5, quad.height() * 0.5);
+    }
+  }
+
+  return super::GetInputRegionOfInterest(input, output_region, job);
+}
+
 void TransformDistortNode::GizmoDragStart(const NodeValueRow &row, double x, double y, const rational &time)
 {
   DraggableGizmo *gizmo = static_cast<DraggableGizmo*>(sender());
@@ -68,6 +68,8 @@ public:
 
   virtual ShaderCode GetShaderCode(const ShaderRequest &request) const override;
 
+  virtual QRectF GetInputRegionOfInterest(const QString &input, const QRectF &output_region, const AcceleratedJob *job) const override;
+
   enum AutoScaleType {
     kAutoScaleNone,
     kAutoScaleFit,
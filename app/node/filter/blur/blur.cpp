@@ -20,6 +20,8 @@
 
 #include "blur.h"
 
+#include <cmath>
+
 namespace olive {
 
 const QString BlurFilterNode::kTextureInput = QStringLiteral("tex_in");
@@ -117,6 +119,32 @@ ShaderCode BlurFilterNode::GetShaderCode(const ShaderRequest &request) const
   return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/blur.frag"));
 }
 
+QRectF BlurFilterNode::GetInputRegionOfInterest(const QString &input, const QRectF &output_region, const AcceleratedJob *job) const
+{
+  if (input == kTextureInput) {
+    Method method = static_cast<Method>(job->Get(kMethodInput).toInt());
+
+    if (method != kRadial) {
+      // Furthest pixel the shader samples from, see blur.frag
+      double extent = std::ceil(job->Get(kRadiusInput).toDouble());
+      if (method == kGaussian) {
+        extent *= 3.0;
+      } else if (method == kDirectional) {
+        extent *= 2.0;
+      }
+
+      QVector2D resolution = job->Get(QStringLiteral("resolution_in")).toVec2();
+      if (resolution.x() > 0 && resolution.y() > 0) {
+        double x = extent / resolution.x();
+        double y = extent / resolution.y();
+        return output_region.adjusted(-x, -y, x, y);
+      }
+    }
+  }
+
+  return super::GetInputRegionOfInterest(input, output_region, job);
+}
+
 void BlurFilterNode::Value(const NodeValueRow &value, const NodeGlobals &globals, NodeValueTable *table) const
 {
   // If there's no texture, no need to run an operation
@@ -51,6 +51,8 @@ public:
   virtual ShaderCode GetShaderCode(const ShaderRequest &request) const override;
   virtual void Value(const NodeValueRow& value, const NodeGlobals &globals, NodeValueTable *table) const override;
 
+  virtual QRectF GetInputRegionOfInterest(const QString &input, const QRectF &output_region, const AcceleratedJob *job) const override;
+
   Method GetMethod() const
   {
     return static_cast<Method>(GetStandardValue(kMethodInput).toInt());
@@ -61,6 +61,8 @@ public:
 
   bool ShaderCodeInvalidateFlag() const override;
 
+  bool ShaderCodeDependsOnlyOnID() const override { return false; }
+
   void getMetadata( QString & name, QString & description, QString & version) const;
 
   static const QString kTextureInput;
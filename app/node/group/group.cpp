@@ -208,6 +208,42 @@ void NodeGroup::PostLoadEvent(SerializedData *data)
   }
 }
 
+void NodeGroup::CopyCustomFrom(const Node *source, const QHash<Node *, Node *> &copies)
+{
+  super::CopyCustomFrom(source, copies);
+
+  const NodeGroup *src = static_cast<const NodeGroup*>(source);
+
+  foreach (const InputPassthrough &ip, src->GetInputPassthroughs()) {
+    Node *inner = copies.value(ip.second.node());
+    if (!inner) {
+      continue;
+    }
+
+    const QString &id = ip.first;
+
+    AddInputPassthrough(NodeInput(inner, ip.second.input(), ip.second.element()), id);
+
+    SetInputFlag(id, InputFlag((src->GetInputFlags(id) & ~ip.second.GetFlags()).value()));
+
+    QString custom_name = src->Node::GetInputName(id);
+    if (!custom_name.isEmpty()) {
+      SetInputName(id, custom_name);
+    }
+
+    SetInputDataType(id, src->GetInputDataType(id));
+
+    SetDefaultValue(id, src->GetDefaultValue(id));
+
+    auto p = src->GetInputProperties(id);
+    for (auto it=p.cbegin(); it!=p.cend(); it++) {
+      SetInputProperty(id, it.key(), it.value());
+    }
+  }
+
+  SetOutputPassthrough(copies.value(src->GetOutputPassthrough()));
+}
+
 QString NodeGroup::AddInputPassthrough(const NodeInput &input, const QString &force_id)
 {
   Q_ASSERT(ContextContainsNode(input.node()));
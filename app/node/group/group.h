@@ -43,6 +43,7 @@ public:
   virtual bool LoadCustom(QXmlStreamReader *reader, SerializedData *data) override;
   virtual void SaveCustom(QXmlStreamWriter *writer) const override;
   virtual void PostLoadEvent(SerializedData *data) override;
+  virtual void CopyCustomFrom(const Node *source, const QHash<Node*, Node*> &copies) override;
 
   QString AddInputPassthrough(const NodeInput &input, const QString &force_id = QString());
 
@@ -16,7 +16,7 @@
 #include "chromakey.h"
 
 #include "node/color/colormanager/colormanager.h"
-#include "render/colorprocessor.h"
+#include "render/colorprocessorcache.h"
 
 namespace olive {
 
@@ -123,7 +123,7 @@ void ChromaKeyNode::GenerateProcessor()
   if (manager()){
     try {
       ColorTransform transform("cie_xyz_d65_interchange");
-      set_processor(ColorProcessor::Create(manager(), manager()->GetReferenceColorSpace(), transform));
+      set_processor(ColorProcessorCache::Get(manager(), manager()->GetReferenceColorSpace(), transform));
     } catch (const OCIO::Exception &e) {
       std::cerr << std::endl << e.what() << std::endl;
     }
@@ -97,6 +97,7 @@ void ColorDifferenceKeyNode::Value(const NodeValueRow &value, const NodeGlobals
   if (TexturePtr tex = value[kTextureInput].toTexture()) {
     ShaderJob job;
     job.Insert(value);
+    job.SetPointwiseInput(kTextureInput);
     table->Push(NodeValue::kTexture, tex->toJob(job), this);
   }
 }
@@ -83,6 +83,7 @@ ShaderCode DespillNode::GetShaderCode(const ShaderRequest &request) const {
 void DespillNode::Value(const NodeValueRow &value, const NodeGlobals &globals, NodeValueTable *table) const {
   ShaderJob job;
   job.Insert(value);
+  job.SetPointwiseInput(kTextureInput);
 
   // Set luma coefficients
   double luma_coeffs[3] = {0.0f, 0.0f, 0.0f};
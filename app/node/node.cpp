@@ -42,11 +42,14 @@ namespace olive {
 
 const QString Node::kEnabledInput = QStringLiteral("enabled_in");
 
+std::atomic_uint64_t Node::render_revision_counter_(0);
+
 Node::Node() :
   override_color_(-1),
   folder_(nullptr),
   flags_(kNone),
-  caches_enabled_(true)
+  caches_enabled_(true),
+  render_revision_(++render_revision_counter_)
 {
   AddInput(kEnabledInput, NodeValue::kBoolean, true);
 
@@ -196,6 +199,8 @@ void Node::ConnectEdge(Node *output, const NodeInput &input)
   input.node()->input_connections_[input] = output;
   output->output_connections_.push_back(std::pair<Node*, NodeInput>({output, input}));
 
+  input.node()->BumpRenderRevision();
+
   // Call internal events
   input.node()->InputConnectedEvent(input.input(), input.element(), output);
   output->OutputConnectedEvent(input);
@@ -225,6 +230,8 @@ void Node::DisconnectEdge(Node *output, const NodeInput &input)
   OutputConnections& outputs = output->output_connections_;
   outputs.erase(std::find(outputs.begin(), outputs.end(), std::pair<Node*, NodeInput>({output, input})));
 
+  input.node()->BumpRenderRevision();
+
   // Call internal events
   input.node()->InputDisconnectedEvent(input.input(), input.element(), output);
   output->OutputDisconnectedEvent(input);
@@ -296,6 +303,8 @@ void Node::SetInputIsKeyframing(const QString &input, bool e, int element)
   if (imm) {
     imm->set_is_keyframing(e);
 
+    BumpRenderRevision();
+
     emit KeyframeEnableChanged(NodeInput(this, input, element), e);
   } else {
     ReportInvalidInput("set keyframing state of", input, element);
@@ -354,6 +363,8 @@ void Node::SetInputDataType(const QString &id, const NodeValue::Type &type)
       GetImmediate(id, i)->set_data_type(type);
     }
 
+    BumpRenderRevision();
+
     emit InputDataTypeChanged(id, type);
   } else {
     ReportInvalidInput("set data type of", id, -1);
@@ -1695,6 +1706,8 @@ void Node::InsertInput(const QString &id, NodeValue::Type type, const QVariant &
     standard_immediates_.insert(id, CreateImmediate(id));
   }
 
+  BumpRenderRevision();
+
   emit InputAdded(id);
 }
 
@@ -1710,6 +1723,8 @@ void Node::RemoveInput(const QString &id)
   input_ids_.removeAt(index);
   input_data_.removeAt(index);
 
+  BumpRenderRevision();
+
   emit InputRemoved(id);
 }
 
@@ -2019,6 +2034,16 @@ ShaderCode Node::GetShaderCode(const ShaderRequest &request) const
   return ShaderCode(QString(), QString());
 }
 
+QRectF Node::GetInputRegionOfInterest(const QString &input, const QRectF &output_region, const AcceleratedJob *job) const
+{
+  if (job->GetJobType() == AcceleratedJob::kJobShader
+      && static_cast<const ShaderJob*>(job)->GetPointwiseInput() == input) {
+    return output_region;
+  }
+
+  return QRectF(0, 0, 1, 1);
+}
+
 void Node::ProcessSamples(const NodeValueRow &, const SampleBuffer &, SampleBuffer &, int) const
 {
 }
@@ -2137,6 +2162,8 @@ TimeRange Node::TransformTimeTo(TimeRange time, Node *target, TransformTimeDirec
 
 void Node::ParameterValueChanged(const QString& input, int element, const TimeRange& range)
 {
+  BumpRenderRevision();
+
   InputValueChangedEvent(input, element);
 
   emit ValueChanged(NodeInput(this, input, element), range);
@@ -2197,6 +2224,11 @@ void Node::ClearElement(const QString& input, int index)
   SetSplitStandardValue(input, GetSplitDefaultValue(input), index);
 }
 
+void Node::BumpRenderRevision()
+{
+  render_revision_ = ++render_revision_counter_;
+}
+
 void Node::InputValueChangedEvent(const QString &input, int element)
 {
   Q_UNUSED(input)
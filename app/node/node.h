@@ -21,6 +21,7 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <atomic>
 #include <map>
 #include <QMutex>
 #include <QObject>
@@ -647,6 +648,20 @@ public:
     return effect_input_;
   }
 
+  /**
+   * @brief Value that changes whenever anything about how this node's inputs are retrieved changes
+   *
+   * Covers connections, values, keyframes, data types and the inputs themselves. Revisions are
+   * unique across all nodes, so a node never shares a revision with one that previously existed at
+   * the same address. Used by NodeTraverserPlan to know when a compiled step is out of date.
+   *
+   * This function is thread-safe.
+   */
+  uint64_t GetRenderRevision() const
+  {
+    return render_revision_;
+  }
+
   class ValueHint {
   public:
     explicit ValueHint(const QVector<NodeValue::Type> &types = QVector<NodeValue::Type>(), int index = -1, const QString &tag = QString()) :
@@ -780,6 +795,25 @@ public:
     return false;
   }
 
+  /**
+   * @brief Whether GetShaderCode() only depends on the node type and the requested shader ID
+   *
+   * Only shaders from nodes that return true are recorded for compiling ahead of time in later
+   * sessions. Nodes that build their code from user input must return false.
+   */
+  virtual bool ShaderCodeDependsOnlyOnID() const {
+    return true;
+  }
+
+  /**
+   * @brief Map a region of a job's output to the region of one of its inputs needed to render it
+   *
+   * Regions are in normalized texture coordinates. The default implementation passes the region
+   * through unchanged for a ShaderJob's pointwise input and requires the entire frame of any other
+   * input. Nodes that move or sample neighboring pixels can override this to narrow it down.
+   */
+  virtual QRectF GetInputRegionOfInterest(const QString &input, const QRectF &output_region, const AcceleratedJob *job) const;
+
   /**
    * @brief If Value() pushes a ShaderJob, this is the function that will process them.
    */
@@ -958,6 +992,15 @@ public:
   virtual void SaveCustom(QXmlStreamWriter *writer) const {}
   virtual void PostLoadEvent(SerializedData *data);
 
+  /**
+   * @brief Copy whatever SaveCustom() writes from another node of the same type
+   *
+   * Used by Project::CreateSnapshot(). Called after context positions have been copied but before
+   * any inputs, so groups can re-create their passthroughs first. `copies` maps every node in the
+   * source project to its copy.
+   */
+  virtual void CopyCustomFrom(const Node *source, const QHash<Node*, Node*> &copies) {}
+
   bool LoadInput(QXmlStreamReader *reader, SerializedData *data);
   void SaveInput(QXmlStreamWriter *writer, const QString &id) const;
 
@@ -1281,6 +1324,12 @@ private:
 
   bool caches_enabled_;
 
+  void BumpRenderRevision();
+
+  std::atomic_uint64_t render_revision_;
+
+  static std::atomic_uint64_t render_revision_counter_;
+
 private slots:
   /**
    * @brief Slot when a keyframe's time changes to keep the keyframes correctly sorted by time
@@ -216,6 +216,13 @@ void Track::SaveCustom(QXmlStreamWriter *writer) const
   writer->writeTextElement(QStringLiteral("height"), QString::number(this->GetTrackHeight()));
 }
 
+void Track::CopyCustomFrom(const Node *source, const QHash<Node *, Node *> &copies)
+{
+  super::CopyCustomFrom(source, copies);
+
+  this->SetTrackHeight(static_cast<const Track*>(source)->GetTrackHeight());
+}
+
 void Track::PostLoadEvent(SerializedData *data)
 {
   ignore_arraymap_set_ = false;
@@ -256,12 +263,10 @@ void Track::SetIndex(const int &index)
 
 Block *Track::BlockContainingTime(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    if (block->in() < time && block->out() > time) {
-      return block;
-    } else if (block->out() == time) {
-      break;
-    }
+  Block *b = FirstBlockWhere([&time](Block *block){ return block->out() > time; });
+
+  if (b && b->in() < time) {
+    return b;
   }
 
   return nullptr;
@@ -269,54 +274,29 @@ Block *Track::BlockContainingTime(const rational &time) const
 
 Block *Track::NearestBlockBefore(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
-    if (block->in() == time) {
-      break;
-    }
+  Block *b = FirstBlockWhere([&time](Block *block){ return block->out() >= time; });
 
-    if (block->out() >= time) {
-      return block;
-    }
+  // A Block starting exactly at this time isn't before it
+  if (b && b->in() == time) {
+    return nullptr;
   }
 
-  return nullptr;
+  return b;
 }
 
 Block *Track::NearestBlockBeforeOrAt(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
-    if (block->out() > time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  return FirstBlockWhere([&time](Block *block){ return block->out() > time; });
 }
 
 Block *Track::NearestBlockAfterOrAt(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    // Blocks are sorted by time, so the first Block after this time is the correct Block
-    if (block->in() >= time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  return FirstBlockWhere([&time](Block *block){ return block->in() >= time; });
 }
 
 Block *Track::NearestBlockAfter(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    // Blocks are sorted by time, so the first Block after this time is the correct Block
-    if (block->in() > time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  return FirstBlockWhere([&time](Block *block){ return block->in() > time; });
 }
 
 bool Track::IsRangeFree(const TimeRange &range) const
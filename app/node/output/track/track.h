@@ -21,6 +21,8 @@
 #ifndef TRACK_H
 #define TRACK_H
 
+#include <algorithm>
+
 #include "node/block/block.h"
 
 namespace olive {
@@ -105,6 +107,7 @@ public:
   virtual bool LoadCustom(QXmlStreamReader *reader, SerializedData *data) override;
   virtual void SaveCustom(QXmlStreamWriter *writer) const override;
   virtual void PostLoadEvent(SerializedData *data) override;
+  virtual void CopyCustomFrom(const Node *source, const QHash<Node*, Node*> &copies) override;
 
   static int InternalHeightToPixelHeight(double h)
   {
@@ -460,6 +463,20 @@ private:
 
   int GetBlockIndexAtTime(const rational &time) const;
 
+  /**
+   * @brief Binary search for the first block matching a predicate, nullptr if none does
+   *
+   * Blocks are contiguous and sorted, so their in and out points only ever increase. Any
+   * predicate that's false for a leading run of blocks and true for the rest, such as
+   * `out > time`, can be found in O(log n) rather than by scanning every block.
+   */
+  template <typename Predicate>
+  Block *FirstBlockWhere(Predicate p) const
+  {
+    auto it = std::partition_point(blocks_.cbegin(), blocks_.cend(), [&p](Block *b){ return !p(b); });
+    return (it == blocks_.cend()) ? nullptr : *it;
+  }
+
   void ProcessAudioTrack(const NodeValueRow &value, const NodeGlobals &globals, NodeValueTable *table) const;
 
   int ConnectBlock(Block *b);
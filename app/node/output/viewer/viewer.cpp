@@ -460,6 +460,21 @@ void ViewerOutput::SaveCustom(QXmlStreamWriter *writer) const
   writer->writeEndElement(); // markers
 }
 
+void ViewerOutput::CopyCustomFrom(const Node *source, const QHash<Node *, Node *> &copies)
+{
+  super::CopyCustomFrom(source, copies);
+
+  const ViewerOutput *src = static_cast<const ViewerOutput*>(source);
+
+  this->GetWorkArea()->set_enabled(src->GetWorkArea()->enabled());
+  this->GetWorkArea()->set_range(src->GetWorkArea()->range());
+
+  for (auto it=src->GetMarkers()->cbegin(); it!=src->GetMarkers()->cend(); it++) {
+    TimelineMarker *marker = *it;
+    new TimelineMarker(marker->color(), marker->time(), marker->name(), this->GetMarkers());
+  }
+}
+
 void ViewerOutput::InputValueChangedEvent(const QString &input, int element)
 {
   if (element == 0) {
@@ -193,6 +193,7 @@ public:
 
   virtual bool LoadCustom(QXmlStreamReader *reader, SerializedData *data) override;
   virtual void SaveCustom(QXmlStreamWriter *writer) const override;
+  virtual void CopyCustomFrom(const Node *source, const QHash<Node*, Node*> &copies) override;
 
   static const QString kVideoParamsInput;
   static const QString kAudioParamsInput;
@@ -22,6 +22,7 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/qtutils.h"
 #include "common/xmlutils.h"
@@ -46,10 +47,77 @@ const QString Project::kRootKey = QStringLiteral("root");
 
 const QString Project::kItemMimeType = QStringLiteral("application/x-oliveprojectitemdata");
 
+namespace {
+
+const int kNodeLoadBatchSize = 64;
+
+struct NodeLoadBatch
+{
+  struct Entry
+  {
+    QString id;
+    QString xml;
+    Node *node;
+  };
+
+  QVector<Entry> nodes;
+
+  SerializedData data;
+};
+
+void LoadNodeBatch(NodeLoadBatch *batch, QThread *project_thread)
+{
+  for (NodeLoadBatch::Entry &e : batch->nodes) {
+    Node* node = NodeFactory::CreateFromID(e.id);
+
+    if (!node) {
+      qWarning() << "Failed to find node with ID" << e.id;
+    } else {
+      // Disable cache while node is being loaded (we'll re-enable it later)
+      node->SetCachesEnabled(false);
+
+      QXmlStreamReader reader(e.xml);
+      if (XMLReadNextStartElement(&reader)) {
+        node->Load(&reader, &batch->data);
+      }
+
+      // The node and anything it created while loading belong to this worker thread, so they have
+      // to be pushed over to the project's thread before they can be parented to it
+      node->moveToThread(project_thread);
+
+      e.node = node;
+    }
+
+    e.xml.clear();
+  }
+}
+
+void MergeSerializedData(SerializedData *dst, const SerializedData &src)
+{
+  for (auto it=src.positions.cbegin(); it!=src.positions.cend(); it++) {
+    dst->positions.insert(it.key(), it.value());
+  }
+
+  for (auto it=src.node_ptrs.cbegin(); it!=src.node_ptrs.cend(); it++) {
+    dst->node_ptrs.insert(it.key(), it.value());
+  }
+
+  dst->desired_connections.append(src.desired_connections);
+  dst->block_links.append(src.block_links);
+  dst->group_input_links.append(src.group_input_links);
+
+  for (auto it=src.group_output_links.cbegin(); it!=src.group_output_links.cend(); it++) {
+    dst->group_output_links.insert(it.key(), it.value());
+  }
+}
+
+}
+
 Project::Project() :
   root_(nullptr),
   is_modified_(false),
-  autorecovery_saved_(true)
+  autorecovery_saved_(true),
+  is_snapshot_(false)
 {
   // Generate UUID for this project
   RegenerateUuid();
@@ -98,6 +166,19 @@ SerializedData Project::Load(QXmlStreamReader *reader)
 
     } else if (reader->name() == QStringLiteral("nodes")) {
 
+      // Constructing and loading nodes is what takes most of the time, so nodes are handed out in
+      // batches to worker threads while we carry on reading the rest of the file. They're added to
+      // the project once they're all done, in their original order.
+      std::vector< std::unique_ptr<NodeLoadBatch> > batches;
+      QVector< QFuture<void> > futures;
+      std::unique_ptr<NodeLoadBatch> batch(new NodeLoadBatch);
+
+      auto dispatch = [&]{
+        futures.append(QtConcurrent::run(LoadNodeBatch, batch.get(), this->thread()));
+        batches.push_back(std::move(batch));
+        batch.reset(new NodeLoadBatch);
+      };
+
       while (XMLReadNextStartElement(reader)) {
         if (reader->name() == QStringLiteral("node")) {
           QString id;
@@ -114,18 +195,10 @@ SerializedData Project::Load(QXmlStreamReader *reader)
             qWarning() << "Failed to load node with empty ID";
             reader->skipCurrentElement();
           } else {
-            Node* node = NodeFactory::CreateFromID(id);
-
-            if (!node) {
-              qWarning() << "Failed to find node with ID" << id;
-              reader->skipCurrentElement();
-            } else {
-              // Disable cache while node is being loaded (we'll re-enable it later)
-              node->SetCachesEnabled(false);
-
-              node->Load(reader, &data);
+            batch->nodes.append({id, XMLCopyCurrentElement(reader), nullptr});
 
-              node->setParent(this);
+            if (batch->nodes.size() == kNodeLoadBatchSize) {
+              dispatch();
             }
           }
         } else {
@@ -133,6 +206,24 @@ SerializedData Project::Load(QXmlStreamReader *reader)
         }
       }
 
+      if (!batch->nodes.isEmpty()) {
+        dispatch();
+      }
+
+      for (QFuture<void> &f : futures) {
+        f.waitForFinished();
+      }
+
+      for (const std::unique_ptr<NodeLoadBatch> &b : batches) {
+        MergeSerializedData(&data, b->data);
+
+        for (const NodeLoadBatch::Entry &e : qAsConst(b->nodes)) {
+          if (e.node) {
+            e.node->setParent(this);
+          }
+        }
+      }
+
     } else if (reader->name() == QStringLiteral("settings")) {
       while (XMLReadNextStartElement(reader)) {
         QString key = reader->name().toString();
@@ -192,6 +283,82 @@ void Project::Save(QXmlStreamWriter *writer) const
   }
 }
 
+Project *Project::CreateSnapshot(QHash<Node*, Node*> *copies_out) const
+{
+  Project *snapshot = new Project();
+  snapshot->is_snapshot_ = true;
+  snapshot->SetUuid(this->GetUuid());
+
+  QHash<Node*, Node*> copies;
+  copies.reserve(this->nodes().size());
+
+  foreach (Node *node, this->nodes()) {
+    Node *copy = node->copy();
+
+    copy->SetCachesEnabled(false);
+    copy->CopyCacheUuidsFrom(node);
+    copy->setParent(snapshot);
+
+    copies.insert(node, copy);
+  }
+
+  // Groups need their contexts before they can pass through inputs, and everything else needs
+  // those passthroughs to exist before inputs can be copied
+  foreach (Node *node, this->nodes()) {
+    Node *copy = copies.value(node);
+
+    const Node::PositionMap &map = node->GetContextPositions();
+    for (auto it=map.cbegin(); it!=map.cend(); it++) {
+      copy->SetNodePositionInContext(copies.value(it.key()), it.value());
+    }
+  }
+
+  foreach (Node *node, this->nodes()) {
+    copies.value(node)->CopyCustomFrom(node, copies);
+  }
+
+  foreach (Node *node, this->nodes()) {
+    Node *copy = copies.value(node);
+
+    Node::CopyInputs(node, copy, false);
+
+    // Color management is stored as input properties, which CopyInputs() leaves alone
+    foreach (const QString &input, node->inputs()) {
+      if (node->GetInputDataType(input) == NodeValue::kColor) {
+        auto p = node->GetInputProperties(input);
+        for (auto it=p.cbegin(); it!=p.cend(); it++) {
+          copy->SetInputProperty(input, it.key(), it.value());
+        }
+      }
+    }
+  }
+
+  foreach (Node *node, this->nodes()) {
+    Node *copy = copies.value(node);
+
+    for (auto it=node->input_connections().cbegin(); it!=node->input_connections().cend(); it++) {
+      Node::ConnectEdge(copies.value(it->second), NodeInput(copy, it->first.input(), it->first.element()));
+    }
+
+    foreach (Node *link, node->links()) {
+      Node::Link(copy, copies.value(link));
+    }
+  }
+
+  CopySettings(this, snapshot);
+
+  if (root_) {
+    snapshot->root_ = static_cast<Folder*>(copies.value(root_));
+    snapshot->settings_.insert(kRootKey, QString::number(reinterpret_cast<quintptr>(snapshot->root_)));
+  }
+
+  if (copies_out) {
+    *copies_out = copies;
+  }
+
+  return snapshot;
+}
+
 int Project::GetNumberOfContextsNodeIsIn(Node *node, bool except_itself) const
 {
   int count = 0;
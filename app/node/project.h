@@ -75,6 +75,19 @@ public:
   SerializedData Load(QXmlStreamReader *reader);
   void Save(QXmlStreamWriter *writer) const;
 
+  /**
+   * @brief Create a detached copy of this project's nodes and settings that can be saved from
+   * another thread
+   *
+   * Must be called from the project's thread. Nodes in the copy don't probe or watch files, so
+   * nothing changes them behind the back of whoever is saving them. The caller takes ownership.
+   *
+   * If `copies` is set, it receives a map of every node in this project to its copy.
+   */
+  Project *CreateSnapshot(QHash<Node*, Node*> *copies = nullptr) const;
+
+  bool is_snapshot() const { return is_snapshot_; }
+
   int GetNumberOfContextsNodeIsIn(Node *node, bool except_itself = false) const;
 
   QString name() const;
@@ -132,7 +145,7 @@ public:
    */
   static Project *GetProjectFromObject(const QObject *o);
 
-  static void CopySettings(Project *from, Project *to) { to->settings_ = from->settings_; }
+  static void CopySettings(const Project *from, Project *to) { to->settings_ = from->settings_; }
 
   static const QString kItemMimeType;
 
@@ -208,6 +221,8 @@ private:
 
   bool autorecovery_saved_;
 
+  bool is_snapshot_;
+
   ColorManager *color_manager_;
 
   QVector<Node*> node_children_;
@@ -74,6 +74,11 @@ void Footage::Retranslate()
 void Footage::InputValueChangedEvent(const QString &input, int element)
 {
   if (input == kFilenameInput) {
+    if (parent() && parent()->is_snapshot()) {
+      // Snapshots copy their streams and timestamp from the original rather than probing
+      return;
+    }
+
     // Reset internal stream cache
     Clear();
 
@@ -465,6 +470,13 @@ void Footage::SaveCustom(QXmlStreamWriter *writer) const
   writer->writeEndElement(); // viewer
 }
 
+void Footage::CopyCustomFrom(const Node *source, const QHash<Node *, Node *> &copies)
+{
+  super::CopyCustomFrom(source, copies);
+
+  set_timestamp(static_cast<const Footage*>(source)->timestamp());
+}
+
 void Footage::AddedToGraphEvent(Project *p)
 {
   connect(p->color_manager(), &ColorManager::DefaultInputChanged, this, &Footage::DefaultColorSpaceChanged);
@@ -576,8 +588,9 @@ VideoParams Footage::MergeVideoStream(const VideoParams &base, const VideoParams
 
 void Footage::CheckFootage()
 {
-  // Don't check files if not the active window
-  if (qApp->activeWindow()) {
+  // Don't check files if not the active window, or if this is a snapshot that may be being saved
+  // from another thread
+  if (qApp->activeWindow() && !(parent() && parent()->is_snapshot())) {
     QString fn = filename();
 
     if (!fn.isEmpty()) {
@@ -0,0 +1,461 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "binaryformat.h"
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QtEndian>
+#include <cstring>
+#include <vector>
+
+namespace olive {
+
+namespace {
+
+const char kMagic[4] = {'O', 'V', 'E', 'B'};
+
+const quint32 kHeaderSize = 16;
+const quint32 kSectionRecordSize = 16;
+const quint32 kStringRecordSize = 8;
+const quint32 kElementRecordSize = 24;
+const quint32 kAttributeRecordSize = 8;
+
+inline quint32 ReadU32(const uchar *p)
+{
+  return qFromLittleEndian<quint32>(p);
+}
+
+inline void AppendU32(QByteArray *b, quint32 v)
+{
+  uchar le[4];
+  qToLittleEndian<quint32>(v, le);
+  b->append(reinterpret_cast<const char*>(le), 4);
+}
+
+inline void PadTo8(QByteArray *b)
+{
+  while (b->size() % 8) {
+    b->append('\0');
+  }
+}
+
+QString Tr(const char *s)
+{
+  return QCoreApplication::translate("ProjectBinaryFormat", s);
+}
+
+}
+
+ProjectBinaryFormat::Reader::Reader(const uchar *data, qint64 size) :
+  data_(data),
+  size_(size),
+  string_count_(0),
+  element_count_(0),
+  attribute_count_(0)
+{
+  memset(sections_, 0, sizeof(sections_));
+
+  Validate();
+}
+
+ProjectBinaryFormat::ElementRecord ProjectBinaryFormat::Reader::GetElement(quint32 index) const
+{
+  const uchar *p = SectionData(kElements) + index * kElementRecordSize;
+
+  ElementRecord e;
+  e.name = ReadU32(p);
+  e.parent = ReadU32(p + 4);
+  e.end = ReadU32(p + 8);
+  e.first_attribute = ReadU32(p + 12);
+  e.attribute_count = ReadU32(p + 16);
+  e.text = ReadU32(p + 20);
+  return e;
+}
+
+ProjectBinaryFormat::AttributeRecord ProjectBinaryFormat::Reader::GetAttribute(quint32 index) const
+{
+  const uchar *p = SectionData(kAttributes) + index * kAttributeRecordSize;
+
+  AttributeRecord a;
+  a.name = ReadU32(p);
+  a.value = ReadU32(p + 4);
+  return a;
+}
+
+QString ProjectBinaryFormat::Reader::GetString(quint32 index) const
+{
+  if (index == kNone) {
+    return QString();
+  }
+
+  const uchar *p = SectionData(kStringIndex) + index * kStringRecordSize;
+
+  return QString::fromUtf8(reinterpret_cast<const char*>(SectionData(kStringData) + ReadU32(p)), ReadU32(p + 4));
+}
+
+void ProjectBinaryFormat::Reader::WriteXml(QXmlStreamWriter *writer) const
+{
+  // Names and attribute values repeat constantly, so only decode each string once
+  std::vector<QString> strings(string_count_);
+  std::vector<bool> decoded(string_count_, false);
+  auto string = [&](quint32 index) -> const QString & {
+    if (!decoded[index]) {
+      strings[index] = GetString(index);
+      decoded[index] = true;
+    }
+    return strings[index];
+  };
+
+  writer->writeStartDocument();
+
+  std::vector<quint32> open;
+
+  for (quint32 i=0; i<element_count_; i++) {
+    while (!open.empty() && open.back() <= i) {
+      writer->writeEndElement();
+      open.pop_back();
+    }
+
+    ElementRecord e = GetElement(i);
+
+    writer->writeStartElement(string(e.name));
+
+    for (quint32 j=0; j<e.attribute_count; j++) {
+      AttributeRecord a = GetAttribute(e.first_attribute + j);
+      writer->writeAttribute(string(a.name), string(a.value));
+    }
+
+    if (e.text != kNone) {
+      writer->writeCharacters(string(e.text));
+    }
+
+    open.push_back(e.end);
+  }
+
+  while (!open.empty()) {
+    writer->writeEndElement();
+    open.pop_back();
+  }
+
+  writer->writeEndDocument();
+}
+
+bool ProjectBinaryFormat::Reader::Validate()
+{
+  if (size_ < kHeaderSize || !HasID(QByteArray::fromRawData(reinterpret_cast<const char*>(data_), 4))) {
+    error_ = Tr("Not a binary project");
+    return false;
+  }
+
+  if (ReadU32(data_ + 4) != kVersion) {
+    error_ = Tr("Unsupported binary project version %1").arg(ReadU32(data_ + 4));
+    return false;
+  }
+
+  quint32 section_count = ReadU32(data_ + 8);
+  if (kHeaderSize + qint64(section_count) * kSectionRecordSize > size_) {
+    error_ = Tr("Section table is truncated");
+    return false;
+  }
+
+  // Unknown sections are skipped so later versions can add more without breaking older readers
+  quint32 found = 0;
+  for (quint32 i=0; i<section_count; i++) {
+    const uchar *p = data_ + kHeaderSize + i * kSectionRecordSize;
+
+    Section s;
+    s.id = ReadU32(p);
+    s.reserved = ReadU32(p + 4);
+    s.offset = ReadU32(p + 8);
+    s.size = ReadU32(p + 12);
+
+    if (qint64(s.offset) + s.size > size_) {
+      error_ = Tr("Section %1 is truncated").arg(s.id);
+      return false;
+    }
+
+    if (s.id < kSectionCount) {
+      sections_[s.id] = s;
+      found |= 1 << s.id;
+    }
+  }
+
+  if (found != (1u << kSectionCount) - 1) {
+    error_ = Tr("Missing sections");
+    return false;
+  }
+
+  if (sections_[kStringIndex].size % kStringRecordSize
+      || sections_[kElements].size % kElementRecordSize
+      || sections_[kAttributes].size % kAttributeRecordSize) {
+    error_ = Tr("Section size mismatch");
+    return false;
+  }
+
+  string_count_ = sections_[kStringIndex].size / kStringRecordSize;
+  element_count_ = sections_[kElements].size / kElementRecordSize;
+  attribute_count_ = sections_[kAttributes].size / kAttributeRecordSize;
+
+  for (quint32 i=0; i<string_count_; i++) {
+    const uchar *p = SectionData(kStringIndex) + i * kStringRecordSize;
+    if (qint64(ReadU32(p)) + ReadU32(p + 4) > sections_[kStringData].size) {
+      error_ = Tr("String %1 is out of bounds").arg(i);
+      return false;
+    }
+  }
+
+  for (quint32 i=0; i<attribute_count_; i++) {
+    AttributeRecord a = GetAttribute(i);
+    if (a.name >= string_count_ || a.value >= string_count_) {
+      error_ = Tr("Attribute %1 is out of bounds").arg(i);
+      return false;
+    }
+  }
+
+  if (element_count_ == 0) {
+    error_ = Tr("Project contains no data");
+    return false;
+  }
+
+  // Elements must describe a single tree in document order, check that against a stack of the
+  // elements that are currently open
+  std::vector< std::pair<quint32, quint32> > open;
+  for (quint32 i=0; i<element_count_; i++) {
+    ElementRecord e = GetElement(i);
+
+    while (!open.empty() && open.back().second <= i) {
+      open.pop_back();
+    }
+
+    if (open.empty() && i > 0) {
+      error_ = Tr("Project has more than one root element");
+      return false;
+    }
+
+    if (e.name >= string_count_
+        || e.parent != (open.empty() ? kNone : open.back().first)
+        || e.end <= i || e.end > element_count_
+        || (!open.empty() && e.end > open.back().second)
+        || qint64(e.first_attribute) + e.attribute_count > attribute_count_
+        || (e.text != kNone && e.text >= string_count_)) {
+      error_ = Tr("Element %1 is invalid").arg(i);
+      return false;
+    }
+
+    open.push_back({i, e.end});
+  }
+
+  return true;
+}
+
+bool ProjectBinaryFormat::HasID(const QByteArray &b)
+{
+  return b.size() >= 4 && !memcmp(b.constData(), kMagic, 4);
+}
+
+bool ProjectBinaryFormat::FromXml(QXmlStreamReader *reader, QByteArray *out, QString *error)
+{
+  QHash<QString, quint32> string_map;
+  QVector<StringRecord> strings;
+  QByteArray string_data;
+  QVector<ElementRecord> elements;
+  QVector<AttributeRecord> attributes;
+
+  auto intern = [&](const QString &s) {
+    auto it = string_map.constFind(s);
+    if (it != string_map.constEnd()) {
+      return it.value();
+    }
+
+    QByteArray utf8 = s.toUtf8();
+    quint32 index = strings.size();
+    strings.append({quint32(string_data.size()), quint32(utf8.size())});
+    string_data.append(utf8);
+    string_map.insert(s, index);
+    return index;
+  };
+
+  auto fail = [error](const QString &s) {
+    if (error) {
+      *error = s;
+    }
+    return false;
+  };
+
+  // Keep xmlns declarations as regular attributes so they survive the round trip
+  reader->setNamespaceProcessing(false);
+
+  struct OpenElement
+  {
+    quint32 index;
+    QString name;
+    QString text;
+  };
+
+  QVector<OpenElement> open;
+
+  while (!reader->atEnd()) {
+    switch (reader->readNext()) {
+    case QXmlStreamReader::StartElement:
+    {
+      QString name = reader->qualifiedName().toString();
+      quint32 index = elements.size();
+
+      ElementRecord e;
+      e.name = intern(name);
+      e.parent = open.isEmpty() ? kNone : open.last().index;
+      e.end = kNone;
+      e.first_attribute = attributes.size();
+      e.text = kNone;
+
+      const QXmlStreamAttributes attrs = reader->attributes();
+      e.attribute_count = attrs.size();
+      for (const QXmlStreamAttribute &a : attrs) {
+        attributes.append({intern(a.qualifiedName().toString()), intern(a.value().toString())});
+      }
+
+      elements.append(e);
+      open.append({index, name, QString()});
+      break;
+    }
+    case QXmlStreamReader::Characters:
+      if (!open.isEmpty()) {
+        OpenElement &o = open.last();
+        if (quint32(elements.size()) > o.index + 1) {
+          // Already has children, only whitespace is allowed here
+          if (!reader->isWhitespace()) {
+            return fail(Tr("Mixed content in element \"%1\" is not supported").arg(o.name));
+          }
+        } else {
+          o.text.append(reader->text());
+        }
+      }
+      break;
+    case QXmlStreamReader::EndElement:
+    {
+      OpenElement o = open.takeLast();
+      ElementRecord &e = elements[o.index];
+      e.end = elements.size();
+
+      if (e.end == o.index + 1) {
+        // Leaf elements keep their text exactly, even if it's only whitespace
+        if (!o.text.isEmpty()) {
+          e.text = intern(o.text);
+        }
+      } else if (!o.text.trimmed().isEmpty()) {
+        return fail(Tr("Mixed content in element \"%1\" is not supported").arg(o.name));
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  if (reader->hasError()) {
+    return fail(reader->errorString());
+  }
+
+  if (elements.isEmpty()) {
+    return fail(Tr("Project contains no data"));
+  }
+
+  // Serialize each section, then lay them out after the header and section table
+  QByteArray sections[kSectionCount];
+
+  sections[kStringIndex].reserve(strings.size() * kStringRecordSize);
+  for (const StringRecord &s : qAsConst(strings)) {
+    AppendU32(&sections[kStringIndex], s.offset);
+    AppendU32(&sections[kStringIndex], s.length);
+  }
+
+  sections[kStringData] = string_data;
+
+  sections[kElements].reserve(elements.size() * kElementRecordSize);
+  for (const ElementRecord &e : qAsConst(elements)) {
+    AppendU32(&sections[kElements], e.name);
+    AppendU32(&sections[kElements], e.parent);
+    AppendU32(&sections[kElements], e.end);
+    AppendU32(&sections[kElements], e.first_attribute);
+    AppendU32(&sections[kElements], e.attribute_count);
+    AppendU32(&sections[kElements], e.text);
+  }
+
+  sections[kAttributes].reserve(attributes.size() * kAttributeRecordSize);
+  for (const AttributeRecord &a : qAsConst(attributes)) {
+    AppendU32(&sections[kAttributes], a.name);
+    AppendU32(&sections[kAttributes], a.value);
+  }
+
+  qint64 total = kHeaderSize + kSectionCount * kSectionRecordSize;
+  for (const QByteArray &s : sections) {
+    total += s.size() + 8;
+  }
+  if (total > 0xFFFFFFFF) {
+    return fail(Tr("Project is too large for the binary format"));
+  }
+
+  out->clear();
+  out->reserve(total);
+
+  out->append(kMagic, 4);
+  AppendU32(out, kVersion);
+  AppendU32(out, kSectionCount);
+  AppendU32(out, 0);
+
+  quint32 offset = kHeaderSize + kSectionCount * kSectionRecordSize;
+  for (int i=0; i<kSectionCount; i++) {
+    offset = (offset + 7) & ~7u;
+    AppendU32(out, i);
+    AppendU32(out, 0);
+    AppendU32(out, offset);
+    AppendU32(out, sections[i].size());
+    offset += sections[i].size();
+  }
+
+  for (const QByteArray &s : sections) {
+    PadTo8(out);
+    out->append(s);
+  }
+
+  return true;
+}
+
+bool ProjectBinaryFormat::ToXml(const uchar *data, qint64 size, QByteArray *out, QString *error)
+{
+  Reader reader(data, size);
+
+  if (!reader.IsValid()) {
+    if (error) {
+      *error = reader.GetError();
+    }
+    return false;
+  }
+
+  out->clear();
+
+  QXmlStreamWriter writer(out);
+  reader.WriteXml(&writer);
+
+  return !writer.hasError();
+}
+
+}
@@ -0,0 +1,176 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTBINARYFORMAT_H
+#define PROJECTBINARYFORMAT_H
+
+#include <QByteArray>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+namespace olive {
+
+/**
+ * @brief Binary container for project files
+ *
+ * Holds exactly the element tree that the XML format does, so the versioned serializers keep
+ * working unchanged and any binary project can be converted to XML and back without loss. It's
+ * still read through the XML serializers, so it isn't faster to load than plain XML. Compared to
+ * the default compressed XML, it skips zlib and stores every repeated name and value once.
+ *
+ * All values are little-endian quint32s at fixed offsets so a file can be mapped into memory and
+ * read in place. After the header and section table come these sections, each 8-byte aligned:
+ *
+ * - kStringIndex: StringRecord per unique string (names, attribute values and text)
+ * - kStringData: UTF-8 data the string records point into
+ * - kElements: ElementRecord per element in document order
+ * - kAttributes: AttributeRecord per attribute, referenced by element records
+ *
+ * Whitespace between elements is formatting and isn't stored. Mixed content (text alongside child
+ * elements) is never written by the serializers and is rejected.
+ */
+class ProjectBinaryFormat
+{
+public:
+  static const quint32 kVersion = 1;
+
+  static const quint32 kNone = 0xFFFFFFFF;
+
+  enum SectionID {
+    kStringIndex,
+    kStringData,
+    kElements,
+    kAttributes,
+
+    kSectionCount
+  };
+
+  struct Header
+  {
+    char magic[4];
+    quint32 version;
+    quint32 section_count;
+    quint32 reserved;
+  };
+
+  struct Section
+  {
+    quint32 id;
+    quint32 reserved;
+    quint32 offset;
+    quint32 size;
+  };
+
+  struct StringRecord
+  {
+    quint32 offset;
+    quint32 length;
+  };
+
+  struct ElementRecord
+  {
+    quint32 name;
+    quint32 parent;
+
+    // One past the last descendant, so a whole subtree can be skipped
+    quint32 end;
+
+    quint32 first_attribute;
+    quint32 attribute_count;
+    quint32 text;
+  };
+
+  struct AttributeRecord
+  {
+    quint32 name;
+    quint32 value;
+  };
+
+  /**
+   * @brief Read-only view of a binary project in memory, usually a mapped file
+   *
+   * All references are bounds checked on construction, so once IsValid() returns true the
+   * accessors are safe to call on anything up to the counts reported. The memory must outlive the
+   * reader.
+   */
+  class Reader
+  {
+  public:
+    Reader(const uchar *data, qint64 size);
+
+    bool IsValid() const { return error_.isEmpty(); }
+    const QString &GetError() const { return error_; }
+
+    quint32 GetElementCount() const { return element_count_; }
+    ElementRecord GetElement(quint32 index) const;
+
+    AttributeRecord GetAttribute(quint32 index) const;
+
+    /**
+     * @brief Decode a string, returns a null string for kNone
+     */
+    QString GetString(quint32 index) const;
+
+    /**
+     * @brief Write the element tree as XML, ready for QXmlStreamReader
+     */
+    void WriteXml(QXmlStreamWriter *writer) const;
+
+  private:
+    const uchar *SectionData(SectionID id) const { return data_ + sections_[id].offset; }
+
+    bool Validate();
+
+    const uchar *data_;
+    qint64 size_;
+
+    Section sections_[kSectionCount];
+
+    quint32 string_count_;
+    quint32 element_count_;
+    quint32 attribute_count_;
+
+    QString error_;
+
+  };
+
+  /**
+   * @brief Returns true if these are the first bytes of a binary project
+   */
+  static bool HasID(const QByteArray &b);
+
+  /**
+   * @brief Convert an XML project to the binary format
+   *
+   * Reads the document from `reader` until the end. Returns false and sets `error` if the XML is
+   * malformed or can't be represented.
+   */
+  static bool FromXml(QXmlStreamReader *reader, QByteArray *out, QString *error = nullptr);
+
+  /**
+   * @brief Convert a binary project back to XML
+   */
+  static bool ToXml(const uchar *data, qint64 size, QByteArray *out, QString *error = nullptr);
+
+};
+
+}
+
+#endif // PROJECTBINARYFORMAT_H
@@ -27,6 +27,7 @@
 #include "common/xmlutils.h"
 #include "core.h"
 #include "node/group/group.h"
+#include "binaryformat.h"
 #include "serializer190219.h"
 #include "serializer210528.h"
 #include "serializer210907.h"
@@ -63,13 +64,37 @@ ProjectSerializer::Result ProjectSerializer::Load(Project *project, const QStrin
   QFile project_file(filename);
 
   if (project_file.open(QFile::ReadOnly)) {
-    // Some project files are compressed, marked with "OVEC" at the beginning of the file. Check for
-    // that signature now.
+    // Some project files are compressed, marked with "OVEC" at the beginning of the file, or binary,
+    // marked with "OVEB". Check for those signatures now.
     std::unique_ptr<QXmlStreamReader> reader;
+    QByteArray b;
     if (CheckCompressedID(&project_file)) {
       // File is compressed, decompress into memory
-      QByteArray b;
       b = qUncompress(project_file.readAll());
+      reader.reset(new QXmlStreamReader(b));
+    } else if (project_file.seek(0) && CheckBinaryID(&project_file)) {
+      // Read binary projects straight out of a mapping of the file if we can
+      qint64 size = project_file.size();
+      uchar *map = project_file.map(0, size);
+      QByteArray copy;
+      if (!map) {
+        project_file.seek(0);
+        copy = project_file.readAll();
+      }
+
+      QString error;
+      bool converted = ProjectBinaryFormat::ToXml(map ? map : reinterpret_cast<const uchar*>(copy.constData()), size, &b, &error);
+
+      if (map) {
+        project_file.unmap(map);
+      }
+
+      if (!converted) {
+        Result r(kXmlError);
+        r.SetDetails(error);
+        return r;
+      }
+
       reader.reset(new QXmlStreamReader(b));
     } else {
       project_file.seek(0);
@@ -148,38 +173,53 @@ ProjectSerializer::Result ProjectSerializer::Paste(LoadType load_type, Project *
   return ProjectSerializer::Load(project, &reader, load_type);
 }
 
-ProjectSerializer::Result ProjectSerializer::Save(const SaveData &data, bool compress)
+ProjectSerializer::Result ProjectSerializer::Save(const SaveData &data, Format format)
 {
-  QString temp_save = FileFunctions::GetSafeTemporaryFilename(data.GetFilename());
+  QByteArray b;
+  QXmlStreamWriter writer(&b);
 
-  QFile project_file(temp_save);
+  Result inner_result = Save(&writer, data);
 
-  if (project_file.open(QFile::WriteOnly)) {
-    QByteArray b;
-    QXmlStreamWriter writer(&b);
+  if (writer.hasError()) {
+    Result r(kXmlError);
+    return r;
+  }
 
-    Result inner_result = Save(&writer, data);
+  if (inner_result != kSuccess) {
+    return inner_result;
+  }
 
-    if (writer.hasError()) {
-      Result r(kXmlError);
-      return r;
-    }
+  return Write(data.GetFilename(), b, format);
+}
+
+ProjectSerializer::Result ProjectSerializer::Write(const QString &filename, const QByteArray &xml, Format format)
+{
+  QString temp_save = FileFunctions::GetSafeTemporaryFilename(filename);
+
+  QFile project_file(temp_save);
 
-    if (compress) {
+  if (project_file.open(QFile::WriteOnly)) {
+    if (format == kBinary) {
+      QXmlStreamReader reader(xml);
+      QByteArray binary;
+      QString error;
+      if (!ProjectBinaryFormat::FromXml(&reader, &binary, &error)) {
+        Result r(kXmlError);
+        r.SetDetails(error);
+        return r;
+      }
+      project_file.write(binary);
+    } else if (format == kCompressedXml) {
       project_file.write("OVEC");
-      project_file.write(qCompress(b));
+      project_file.write(qCompress(xml));
     } else {
-      project_file.write(b);
+      project_file.write(xml);
     }
 
     project_file.close();
 
-    if (inner_result != kSuccess) {
-      return inner_result;
-    }
-
     // Save was successful, we can now rewrite the original file
-    if (FileFunctions::RenameFileAllowOverwrite(temp_save, data.GetFilename())) {
+    if (FileFunctions::RenameFileAllowOverwrite(temp_save, filename)) {
       return kSuccess;
     } else {
       Result r(kOverwriteError);
@@ -246,6 +286,11 @@ bool ProjectSerializer::CheckCompressedID(QFile *file)
   return !memcmp(b.data(), "OVEC", 4);
 }
 
+bool ProjectSerializer::CheckBinaryID(QFile *file)
+{
+  return ProjectBinaryFormat::HasID(file->read(4));
+}
+
 bool ProjectSerializer::IsCancelled() const
 {
   return false;
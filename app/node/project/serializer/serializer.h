@@ -64,6 +64,12 @@ public:
     kNoData
   };
 
+  enum Format {
+    kXml,
+    kCompressedXml,
+    kBinary
+  };
+
   using SerializedProperties = QHash<Node*, QMap<QString, QString> >;
   using SerializedKeyframes = QHash<QString, QVector<NodeKeyframe*> >;
 
@@ -176,11 +182,21 @@ public:
   static Result Load(Project *project, QXmlStreamReader *read_device, LoadType load_type);
   static Result Paste(LoadType load_type, Project *project = nullptr);
 
-  static Result Save(const SaveData &data, bool compress);
+  static Result Save(const SaveData &data, Format format);
+
+  /**
+   * @brief Write a project already serialized with Save(QXmlStreamWriter*, ...) to a file
+   *
+   * Doesn't touch the project, so unlike the other functions here it's safe to call from any
+   * thread.
+   */
+  static Result Write(const QString &filename, const QByteArray &xml, Format format);
+
   static Result Save(QXmlStreamWriter *write_device, const SaveData &data);
   static Result Copy(const SaveData &data);
 
   static bool CheckCompressedID(QFile *file);
+  static bool CheckBinaryID(QFile *file);
 
 protected:
   virtual LoadData Load(Project *project, QXmlStreamReader *reader, LoadType load_type, void *reserved) const = 0;
@@ -20,10 +20,13 @@
 
 #include "traverser.h"
 
+#include <algorithm>
+
 #include "node.h"
 #include "node/block/clip/clip.h"
 #include "render/job/footagejob.h"
 #include "render/rendermanager.h"
+#include "render/rendertrace.h"
 
 namespace olive {
 
@@ -31,24 +34,49 @@ NodeValueDatabase NodeTraverser::GenerateDatabase(const Node* node, const TimeRa
 {
   NodeValueDatabase database;
 
-  // HACK: Pick up loop mode from clips
   LoopMode old_loop_mode = loop_mode_;
-  if (const ClipBlock *clip = dynamic_cast<const ClipBlock*>(node)) {
-    loop_mode_ = clip->loop_mode();
-  }
 
-  // We need to insert tables into the database for each input
-  auto ignore = node->IgnoreInputsForRendering();
-  foreach (const QString& input, node->inputs()) {
-    if (IsCancelled()) {
-      return NodeValueDatabase();
+  if (plan_) {
+    const NodeTraverserPlan::Step &step = plan_->Get(node);
+
+    // HACK: Pick up loop mode from clips
+    if (step.clip) {
+      loop_mode_ = step.clip->loop_mode();
     }
 
-    if (ignore.contains(input)) {
-      continue;
+    for (const NodeTraverserPlan::Input &input : step.inputs) {
+      if (IsCancelled()) {
+        return NodeValueDatabase();
+      }
+
+      if (input.is_static) {
+        database.Insert(input.id, input.static_table);
+      } else if (input.connected) {
+        TimeRange adjusted_range = node->InputTimeAdjustment(input.id, -1, range, true);
+        database.Insert(input.id, GenerateTable(input.connected, adjusted_range, node));
+      } else {
+        database.Insert(input.id, ProcessInput(node, input.id, range));
+      }
     }
+  } else {
+    // HACK: Pick up loop mode from clips
+    if (const ClipBlock *clip = dynamic_cast<const ClipBlock*>(node)) {
+      loop_mode_ = clip->loop_mode();
+    }
+
+    // We need to insert tables into the database for each input
+    auto ignore = node->IgnoreInputsForRendering();
+    foreach (const QString& input, node->inputs()) {
+      if (IsCancelled()) {
+        return NodeValueDatabase();
+      }
 
-    database.Insert(input, ProcessInput(node, input, range));
+      if (ignore.contains(input)) {
+        continue;
+      }
+
+      database.Insert(input, ProcessInput(node, input, range));
+    }
   }
 
   loop_mode_ = old_loop_mode;
@@ -254,27 +282,13 @@ void NodeTraverser::ProcessInputElement(NodeValueTableArray &array_tbl, const No
 NodeTraverser::NodeTraverser() :
   cancel_(nullptr),
   transform_(nullptr),
-  loop_mode_(LoopMode::kLoopModeOff)
+  loop_mode_(LoopMode::kLoopModeOff),
+  plan_(nullptr)
 {
 }
 
-class GTTTime
-{
-public:
-  GTTTime(const Node *n) { t = QDateTime::currentMSecsSinceEpoch(); node = n; }
-
-  ~GTTTime() { qDebug() << "GT for" << node << "took" << (QDateTime::currentMSecsSinceEpoch() - t); }
-
-  qint64 t;
-  const Node *node;
-
-};
-
 NodeValueTable NodeTraverser::GenerateTable(const Node *n, const TimeRange& range, const Node *next_node)
 {
-  // NOTE: Times how long a node takes to process, useful for profiling.
-  //GTTTime gtt(n);Q_UNUSED(gtt);
-
   // Use table cache to skip processing where available
   if (value_cache_.contains(n)) {
     QHash<TimeRange, NodeValueTable> &node_value_map = value_cache_[n];
@@ -283,6 +297,9 @@ NodeValueTable NodeTraverser::GenerateTable(const Node *n, const TimeRange& rang
     }
   }
 
+  // Includes the time spent on everything upstream of this node
+  RenderTraceSpan span("Node", n, range.in());
+
   // Generate row for node
   NodeValueDatabase database = GenerateDatabase(n, range);
 
@@ -338,6 +355,49 @@ NodeValueTable NodeTraverser::GenerateTable(const Node *n, const TimeRange& rang
   return table;
 }
 
+void NodeTraverser::PruneCachesBefore(const rational &time)
+{
+  for (auto it=value_cache_.begin(); it!=value_cache_.end(); ) {
+    QHash<TimeRange, NodeValueTable> &node_value_map = it.value();
+
+    for (auto jt=node_value_map.begin(); jt!=node_value_map.end(); ) {
+      if (jt.key().out() <= time) {
+        jt = node_value_map.erase(jt);
+      } else {
+        jt++;
+      }
+    }
+
+    if (node_value_map.isEmpty()) {
+      it = value_cache_.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  // Resolved textures are keyed by the job textures of the tables above, so they can't outlive them
+  resolved_texture_cache_.clear();
+  job_regions_.clear();
+}
+
+void NodeTraverser::StashCaches()
+{
+  stashed_value_cache_.swap(value_cache_);
+  stashed_resolved_texture_cache_.swap(resolved_texture_cache_);
+  stashed_job_regions_.swap(job_regions_);
+}
+
+void NodeTraverser::RestoreCaches()
+{
+  value_cache_.swap(stashed_value_cache_);
+  resolved_texture_cache_.swap(stashed_resolved_texture_cache_);
+  job_regions_.swap(stashed_job_regions_);
+
+  stashed_value_cache_.clear();
+  stashed_resolved_texture_cache_.clear();
+  stashed_job_regions_.clear();
+}
+
 TexturePtr NodeTraverser::ProcessVideoCacheJob(const CacheJob *val)
 {
   return nullptr;
@@ -355,8 +415,12 @@ void NodeTraverser::ResolveJobs(NodeValue &val)
     if (TexturePtr job_tex = val.toTexture()) {
       if (AcceleratedJob *base_job = job_tex->job()) {
 
+        base_job->SetRegionOfInterest(job_regions_.value(job_tex.get()));
+
         if (resolved_texture_cache_.contains(job_tex.get())) {
           val.set_value(resolved_texture_cache_.value(job_tex.get()));
+        } else if (base_job->GetJobType() == AcceleratedJob::kJobShader && ResolveFusedShaders(val)) {
+          resolved_texture_cache_.insert(job_tex.get(), val.toTexture());
         } else {
           // Resolve any sub-jobs
           for (auto it=base_job->GetValues().begin(); it!=base_job->GetValues().end(); it++) {
@@ -365,15 +429,22 @@ void NodeTraverser::ResolveJobs(NodeValue &val)
             ResolveJobs(subval);
           }
 
-          if (CacheJob *cj = dynamic_cast<CacheJob*>(base_job)) {
+          switch (base_job->GetJobType()) {
+          case AcceleratedJob::kJobCache:
+          {
+            CacheJob *cj = static_cast<CacheJob*>(base_job);
+
             TexturePtr tex = ProcessVideoCacheJob(cj);
             if (tex) {
               val.set_value(tex);
             } else {
               val.set_value(cj->GetFallback());
             }
-
-          } else if (ColorTransformJob *ctj = dynamic_cast<ColorTransformJob*>(base_job)) {
+            break;
+          }
+          case AcceleratedJob::kJobColorTransform:
+          {
+            ColorTransformJob *ctj = static_cast<ColorTransformJob*>(base_job);
 
             VideoParams ctj_params = job_tex->params();
 
@@ -389,8 +460,11 @@ void NodeTraverser::ResolveJobs(NodeValue &val)
             ProcessColorTransform(dest, val.source(), ctj);
 
             val.set_value(dest);
-
-          } else if (ShaderJob *sj = dynamic_cast<ShaderJob*>(base_job)) {
+            break;
+          }
+          case AcceleratedJob::kJobShader:
+          {
+            ShaderJob *sj = static_cast<ShaderJob*>(base_job);
 
             VideoParams tex_params = job_tex->params();
 
@@ -399,8 +473,11 @@ void NodeTraverser::ResolveJobs(NodeValue &val)
             ProcessShader(tex, val.source(), sj);
 
             val.set_value(tex);
-
-          } else if (GenerateJob *gj = dynamic_cast<GenerateJob*>(base_job)) {
+            break;
+          }
+          case AcceleratedJob::kJobGenerate:
+          {
+            GenerateJob *gj = static_cast<GenerateJob*>(base_job);
 
             VideoParams tex_params = job_tex->params();
 
@@ -422,8 +499,11 @@ void NodeTraverser::ResolveJobs(NodeValue &val)
             }
 
             val.set_value(tex);
-
-          } else if (FootageJob *fj = dynamic_cast<FootageJob*>(base_job)) {
+            break;
+          }
+          case AcceleratedJob::kJobFootage:
+          {
+            FootageJob *fj = static_cast<FootageJob*>(base_job);
 
             rational footage_time = Footage::AdjustTimeByLoopMode(fj->time().in(), fj->loop_mode(), fj->length(), fj->video_params().video_type(), fj->video_params().frame_rate_as_time_base());
 
@@ -433,15 +513,23 @@ void NodeTraverser::ResolveJobs(NodeValue &val)
               // Push dummy texture
               tex = CreateDummyTexture(fj->video_params());
             } else {
-              VideoParams managed_params = fj->video_params();
-              managed_params.set_format(GetCacheVideoParams().format());
+              tex = GetCachedVideoFootage(fj, footage_time);
+
+              if (!tex) {
+                VideoParams managed_params = fj->video_params();
+                managed_params.set_format(GetCacheVideoParams().format());
 
-              tex = CreateTexture(managed_params);
-              ProcessVideoFootage(tex, fj, footage_time);
+                tex = CreateTexture(managed_params);
+                ProcessVideoFootage(tex, fj, footage_time);
+              }
             }
 
             val.set_value(tex);
-
+            break;
+          }
+          case AcceleratedJob::kJobSample:
+            // Sample jobs are never attached to textures
+            break;
           }
 
           // Cache resolved value
@@ -471,6 +559,131 @@ void NodeTraverser::ResolveJobs(NodeValue &val)
   }
 }
 
+void NodeTraverser::PropagateRegionOfInterest(const NodeValue &value, QRectF region)
+{
+  if (value.type() != NodeValue::kTexture) {
+    return;
+  }
+
+  TexturePtr tex = value.toTexture();
+  if (!tex || !tex->job()) {
+    return;
+  }
+
+  AcceleratedJob *job = tex->job();
+  const Node *node = value.source();
+  const QRectF full_frame(0, 0, 1, 1);
+
+  region = region.intersected(full_frame);
+  if (region.isEmpty()) {
+    return;
+  }
+
+  // Jobs used by several consumers need the union of what they all need
+  auto existing = job_regions_.constFind(tex.get());
+  if (existing != job_regions_.constEnd()) {
+    if (existing->contains(region)) {
+      return;
+    }
+    region = region.united(*existing);
+  }
+
+  if (job->GetJobType() == AcceleratedJob::kJobShader && node) {
+    const ShaderJob *sj = static_cast<const ShaderJob*>(job);
+    if (sj->GetIterationCount() > 1 && !sj->GetIterativeInput().isEmpty()) {
+      // Every iteration is shaded over the region the last one samples from
+      region = node->GetInputRegionOfInterest(sj->GetIterativeInput(), region, job).intersected(full_frame);
+    }
+  }
+
+  job_regions_.insert(tex.get(), region);
+
+  if (job->GetJobType() == AcceleratedJob::kJobColorTransform) {
+    // Color transforms are pointwise
+    PropagateRegionOfInterest(static_cast<ColorTransformJob*>(job)->GetInputTexture(), region);
+  }
+
+  for (auto it=job->GetValues().cbegin(); it!=job->GetValues().cend(); it++) {
+    if (it->type() == NodeValue::kTexture) {
+      QRectF input_region = node ? node->GetInputRegionOfInterest(it.key(), region, job) : full_frame;
+      PropagateRegionOfInterest(it.value(), input_region);
+    }
+  }
+}
+
+bool NodeTraverser::ResolveFusedShaders(NodeValue &val)
+{
+  TexturePtr job_tex = val.toTexture();
+  const VideoParams &job_params = job_tex->params();
+
+  // Walk upstream through pointwise shaders, collecting every job that can run in the same pass
+  QVector<FusedShaderStage> stages;
+  ShaderJob *current = static_cast<ShaderJob*>(job_tex->job());
+  if (!current->IsFusable()) {
+    return false;
+  }
+  stages.append({val.source(), current});
+
+  while (!current->GetPointwiseInput().isEmpty()) {
+    auto upstream = current->GetValues().constFind(current->GetPointwiseInput());
+    if (upstream == current->GetValues().constEnd()) {
+      break;
+    }
+
+    TexturePtr upstream_tex = upstream->toTexture();
+    if (!upstream_tex
+        || !upstream_tex->job()
+        || upstream_tex->job()->GetJobType() != AcceleratedJob::kJobShader
+        || resolved_texture_cache_.contains(upstream_tex.get())) {
+      break;
+    }
+
+    // Stages must all render at the same resolution for their fragments to line up
+    const VideoParams &upstream_params = upstream_tex->params();
+    if (upstream_params.effective_width() != job_params.effective_width()
+        || upstream_params.effective_height() != job_params.effective_height()
+        || upstream_params.channel_count() != job_params.channel_count()
+        || upstream_params.is_3d() || job_params.is_3d()) {
+      break;
+    }
+
+    ShaderJob *upstream_job = static_cast<ShaderJob*>(upstream_tex->job());
+    if (!upstream_job->IsFusable()) {
+      break;
+    }
+
+    stages.append({upstream->source(), upstream_job});
+    current = upstream_job;
+  }
+
+  if (stages.size() < 2) {
+    return false;
+  }
+
+  std::reverse(stages.begin(), stages.end());
+
+  // Resolve everything the stages need except the intermediate results being fused away
+  for (int i=0; i<stages.size(); i++) {
+    ShaderJob *job = stages.at(i).job;
+    for (auto it=job->GetValues().begin(); it!=job->GetValues().end(); it++) {
+      if (i > 0 && it.key() == job->GetPointwiseInput()) {
+        continue;
+      }
+
+      ResolveJobs(it.value());
+    }
+  }
+
+  TexturePtr tex = CreateTexture(job_params);
+
+  if (!ProcessFusedShaders(tex, stages)) {
+    return false;
+  }
+
+  val.set_value(tex);
+  return true;
+}
+
 TexturePtr NodeTraverser::CreateDummyTexture(const VideoParams &p)
 {
   return std::make_shared<Texture>(p);
@@ -31,6 +31,7 @@
 #include "render/job/footagejob.h"
 #include "render/job/colortransformjob.h"
 #include "render/job/footagejob.h"
+#include "traverserplan.h"
 #include "value.h"
 
 namespace olive {
@@ -74,6 +75,17 @@ public:
     audio_params_ = params;
   }
 
+  /**
+   * @brief Use a compiled plan to skip per-frame work that doesn't depend on time
+   *
+   * The plan is not owned by the traverser and can be shared across traversals on the same thread.
+   * If no plan is set, every input is resolved from scratch.
+   */
+  void SetPlan(NodeTraverserPlan *plan)
+  {
+    plan_ = plan;
+  }
+
 protected:
   NodeValueTable ProcessInput(const Node *node, const QString &input, const TimeRange &range);
 
@@ -81,6 +93,11 @@ protected:
 
   virtual void ProcessVideoFootage(TexturePtr destination, const FootageJob *stream, const rational &input_time){}
 
+  /**
+   * @brief Return a texture already processed for this footage to skip ProcessVideoFootage(), or nullptr
+   */
+  virtual TexturePtr GetCachedVideoFootage(const FootageJob *stream, const rational &input_time){return nullptr;}
+
   virtual void ProcessAudioFootage(SampleBuffer &destination, const FootageJob *stream, const TimeRange &input_time){}
 
   virtual void ProcessShader(TexturePtr destination, const Node *node, const ShaderJob *job){}
@@ -93,6 +110,19 @@ protected:
 
   virtual void ConvertToReferenceSpace(TexturePtr destination, TexturePtr source, const QString &input_cs){}
 
+  struct FusedShaderStage
+  {
+    const Node *node;
+    ShaderJob *job;
+  };
+
+  /**
+   * @brief Render a chain of shader jobs (ordered upstream to downstream) in a single pass
+   *
+   * Returns false if the chain couldn't be fused, in which case each job is processed separately.
+   */
+  virtual bool ProcessFusedShaders(TexturePtr destination, const QVector<FusedShaderStage> &stages){return false;}
+
   virtual TexturePtr ProcessVideoCacheJob(const CacheJob *val);
 
   virtual TexturePtr CreateTexture(const VideoParams &p)
@@ -133,6 +163,15 @@ protected:
   void ResolveJobs(NodeValue &value);
   void ResolveAudioJobs(NodeValue &value);
 
+  /**
+   * @brief Limit the jobs behind a value to the region of it that will actually be used
+   *
+   * `region` is in normalized texture coordinates. It's mapped through every node's
+   * Node::GetInputRegionOfInterest() so each job only shades what its consumers sample. Must be
+   * called before ResolveJobs().
+   */
+  void PropagateRegionOfInterest(const NodeValue &value, QRectF region);
+
   Block *GetCurrentBlock() const
   {
     return block_stack_.empty() ? nullptr : block_stack_.back();
@@ -140,11 +179,31 @@ protected:
 
   LoopMode loop_mode() const { return loop_mode_; }
 
+  /**
+   * @brief Drop cached tables that end at or before `time`
+   *
+   * Used when one traverser renders several consecutive frames so tables that later frames can
+   * still use (e.g. the second field of an interlaced frame) survive while memory stays bounded.
+   */
+  void PruneCachesBefore(const rational &time);
+
+  /**
+   * @brief Set cached values aside so tables generated with different video parameters don't mix
+   * with them
+   *
+   * Every call must be followed by RestoreCaches(), which discards anything cached in between.
+   */
+  void StashCaches();
+
+  void RestoreCaches();
+
   virtual bool UseCache() const { return false; }
 
 private:
   TexturePtr CreateDummyTexture(const VideoParams &p);
 
+  bool ResolveFusedShaders(NodeValue &val);
+
   VideoParams video_params_;
 
   AudioParams audio_params_;
@@ -159,8 +218,15 @@ private:
 
   LoopMode loop_mode_;
 
+  NodeTraverserPlan *plan_;
+
   QHash<const Node*, QHash<TimeRange, NodeValueTable> > value_cache_;
   QHash<Texture*, TexturePtr> resolved_texture_cache_;
+  QHash<Texture*, QRectF> job_regions_;
+
+  QHash<const Node*, QHash<TimeRange, NodeValueTable> > stashed_value_cache_;
+  QHash<Texture*, TexturePtr> stashed_resolved_texture_cache_;
+  QHash<Texture*, QRectF> stashed_job_regions_;
 
 };
 
@@ -0,0 +1,81 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "traverserplan.h"
+
+#include "node/block/clip/clip.h"
+
+namespace olive {
+
+const size_t NodeTraverserPlan::kMaximumSteps = 8192;
+
+const NodeTraverserPlan::Step &NodeTraverserPlan::Get(const Node *node)
+{
+  // Node revisions start at 1, so a newly inserted step always compiles
+  Step &step = steps_[node];
+
+  if (step.revision != node->GetRenderRevision()) {
+    Compile(node, &step);
+  }
+
+  return step;
+}
+
+void NodeTraverserPlan::Prune()
+{
+  // Steps for deleted nodes are never looked up again, so occasionally start over
+  if (steps_.size() > kMaximumSteps) {
+    steps_.clear();
+  }
+}
+
+void NodeTraverserPlan::Compile(const Node *node, Step *step)
+{
+  step->revision = node->GetRenderRevision();
+  step->clip = dynamic_cast<const ClipBlock*>(node);
+  step->inputs.clear();
+
+  auto ignore = node->IgnoreInputsForRendering();
+
+  foreach (const QString& input, node->inputs()) {
+    if (ignore.contains(input)) {
+      continue;
+    }
+
+    Input i;
+
+    i.id = input;
+    i.array = node->InputIsArray(input);
+    i.connected = nullptr;
+    i.is_static = false;
+
+    if (node->IsInputConnectedForRender(input)) {
+      i.connected = node->GetConnectedRenderOutput(input);
+    } else if (!i.array && !node->IsInputKeyframing(input)) {
+      // Value is the same at any time, so resolve it now
+      i.is_static = true;
+      i.static_table.Push(node->GetInputDataType(input), node->GetValueAtTime(input, 0), node, false);
+    }
+
+    step->inputs.push_back(i);
+  }
+}
+
+}
@@ -0,0 +1,111 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODETRAVERSERPLAN_H
+#define NODETRAVERSERPLAN_H
+
+#include <unordered_map>
+
+#include "node/node.h"
+#include "node/value.h"
+
+namespace olive {
+
+class ClipBlock;
+
+/**
+ * @brief Compiled, time-independent description of how NodeTraverser retrieves each node's inputs
+ *
+ * Finding which inputs a node renders, which of them are connected and to what, and retrieving the
+ * values of inputs that can't change over time is the same work for every frame as long as the
+ * node doesn't change. A plan compiles this once per node into a Step and reuses it for every
+ * subsequent frame, so only time-varying inputs are evaluated per frame. Steps are validated
+ * against Node::GetRenderRevision() and recompiled automatically when a node changes.
+ *
+ * Plans are meant to outlive a single traversal (e.g. one per render thread). They are NOT
+ * thread-safe.
+ */
+class NodeTraverserPlan
+{
+public:
+  NodeTraverserPlan() = default;
+
+  struct Input
+  {
+    QString id;
+
+    bool array;
+
+    // Node connected to this input for rendering, or nullptr if not connected or an array
+    Node *connected;
+
+    // Inputs that are not connected, not an array and not keyframing always produce the same
+    // table, so it is resolved at compile time
+    bool is_static;
+    NodeValueTable static_table;
+  };
+
+  struct Step
+  {
+    uint64_t revision = 0;
+
+    const ClipBlock *clip = nullptr;
+
+    std::vector<Input> inputs;
+  };
+
+  /**
+   * @brief Get step for a node, compiling it if it doesn't exist or is out of date
+   *
+   * The returned reference stays valid until Prune() or Clear() are called, even if other steps
+   * are compiled in the meantime.
+   */
+  const Step &Get(const Node *node);
+
+  /**
+   * @brief Free steps if the plan has grown beyond kMaximumSteps
+   *
+   * Must not be called during a traversal.
+   */
+  void Prune();
+
+  void Clear()
+  {
+    steps_.clear();
+  }
+
+  size_t size() const
+  {
+    return steps_.size();
+  }
+
+  static const size_t kMaximumSteps;
+
+private:
+  static void Compile(const Node *node, Step *step);
+
+  // Node-based container so references to steps survive rehashing during recursive traversal
+  std::unordered_map<const Node*, Step> steps_;
+
+};
+
+}
+
+#endif // NODETRAVERSERPLAN_H
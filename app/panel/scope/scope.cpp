@@ -61,6 +61,10 @@ ScopePanel::ScopePanel() :
   histogram_ = new HistogramScope();
   stack_->addWidget(histogram_);
 
+  // Create vectorscope
+  vectorscope_ = new VectorScope();
+  stack_->addWidget(vectorscope_);
+
   connect(scope_type_combobox_, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), stack_, &QStackedWidget::setCurrentIndex);
 
   Retranslate();
@@ -78,6 +82,8 @@ QString ScopePanel::TypeToName(ScopePanel::Type t)
     return tr("Waveform");
   case kTypeHistogram:
     return tr("Histogram");
+  case kTypeVectorscope:
+    return tr("Vectorscope");
   case kTypeCount:
     break;
   }
@@ -94,6 +100,8 @@ void ScopePanel::SetViewerPanel(ViewerPanelBase *vp)
   if (viewer_) {
     disconnect(viewer_, &ViewerPanelBase::TextureChanged, this, &ScopePanel::SetReferenceBuffer);
     disconnect(viewer_, &ViewerPanelBase::ColorManagerChanged, this, &ScopePanel::SetColorManager);
+
+    viewer_->SetFullFrameRequired(false);
   }
 
   viewer_ = vp;
@@ -103,6 +111,9 @@ void ScopePanel::SetViewerPanel(ViewerPanelBase *vp)
     connect(viewer_, &ViewerPanelBase::TextureChanged, this, &ScopePanel::SetReferenceBuffer);
     connect(viewer_, &ViewerPanelBase::ColorManagerChanged, this, &ScopePanel::SetColorManager);
 
+    // Scopes analyze the entire frame, not just what's visible in the viewer
+    viewer_->SetFullFrameRequired(true);
+
     SetColorManager(viewer_->GetColorManager());
 
     viewer_->UpdateTextureFromNode();
@@ -116,12 +127,14 @@ void ScopePanel::SetReferenceBuffer(TexturePtr frame)
 {
   histogram_->SetBuffer(frame);
   waveform_view_->SetBuffer(frame);
+  vectorscope_->SetBuffer(frame);
 }
 
 void ScopePanel::SetColorManager(ColorManager *manager)
 {
   histogram_->ConnectColorManager(manager);
   waveform_view_->ConnectColorManager(manager);
+  vectorscope_->ConnectColorManager(manager);
 }
 
 void ScopePanel::Retranslate()
@@ -27,6 +27,7 @@
 #include "panel/panel.h"
 #include "panel/viewer/viewerbase.h"
 #include "widget/scope/histogram/histogram.h"
+#include "widget/scope/vectorscope/vectorscope.h"
 #include "widget/scope/waveform/waveform.h"
 
 namespace olive {
@@ -38,6 +39,7 @@ public:
   enum Type {
     kTypeWaveform,
     kTypeHistogram,
+    kTypeVectorscope,
 
     kTypeCount
   };
@@ -74,6 +76,8 @@ private:
 
   HistogramScope* histogram_;
 
+  VectorScope* vectorscope_;
+
   ViewerPanelBase *viewer_;
 
 };
@@ -67,6 +67,11 @@ public:
     GetViewerWidget()->UpdateTextureFromNode();
   }
 
+  void SetFullFrameRequired(bool e)
+  {
+    GetViewerWidget()->SetFullFrameRequired(e);
+  }
+
   void AddPlaybackDevice(ViewerDisplayWidget *vw)
   {
     GetViewerWidget()->AddPlaybackDevice(vw);
@@ -20,14 +20,31 @@
 
 #include "audiowaveformcache.h"
 
+#include <QCoreApplication>
+#include <QPainter>
+#include <QPointer>
+#include <QtConcurrent/QtConcurrent>
+#include <QtMath>
+
+#include "config/config.h"
+#include "render/memorymanager.h"
+
 namespace olive {
 
 #define super PlaybackCache
 
 AudioWaveformCache::AudioWaveformCache(QObject *parent) :
-  super{parent}
+  super{parent},
+  reported_memory_usage_(0),
+  tile_counter_(0),
+  tile_bytes_(0)
+{
+  waveforms_ = std::make_shared<WaveformData>();
+}
+
+AudioWaveformCache::~AudioWaveformCache()
 {
-  waveforms_ = std::make_shared<AudioVisualWaveform>();
+  MemoryManager::Released(MemoryManager::kWaveforms, reported_memory_usage_);
 }
 
 void AudioWaveformCache::WriteWaveform(const TimeRange &range, const TimeRangeList &valid_ranges, const AudioVisualWaveform *waveform)
@@ -35,14 +52,33 @@ void AudioWaveformCache::WriteWaveform(const TimeRange &range, const TimeRangeLi
   // Write each valid range to the segments
   foreach (const TimeRange& r, valid_ranges) {
     if (waveform) {
-      waveforms_->OverwriteSums(*waveform, r.in(), r.in() - range.in(), r.length());
+      QWriteLocker locker(&waveforms_->lock);
+      waveforms_->waveform.OverwriteSums(*waveform, r.in(), r.in() - range.in(), r.length());
     }
 
+    RemoveTiles(r);
+
     Validate(r);
   }
+
+  UpdateMemoryUsage();
+}
+
+void AudioWaveformCache::SetParameters(const AudioParams &p)
+{
+  params_ = p;
+
+  if (waveforms_->waveform.channel_count() != p.channel_count()) {
+    {
+      QWriteLocker locker(&waveforms_->lock);
+      waveforms_->waveform.set_channel_count(p.channel_count());
+    }
+
+    ClearTiles();
+  }
 }
 
-void DrawSubRect(QPainter *painter, const QRect &rect, const double &scale, const TimeRange &wave_range, const AudioVisualWaveform &waveform, const TimeRange &subrange)
+void DrawSubRect(QPainter *painter, const QRect &rect, const double &scale, const TimeRange &wave_range, const AudioVisualWaveform &waveform, const TimeRange &subrange, bool rectified)
 {
   // Find start time of passthrough
   TimeRange intersect = wave_range.Intersected(subrange);
@@ -55,17 +91,17 @@ void DrawSubRect(QPainter *painter, const QRect &rect, const double &scale, cons
                   rect.height());
 
   // Draw waveform with this info
-  AudioVisualWaveform::DrawWaveform(painter, pass_rect, scale, waveform, intersect.in());
+  AudioVisualWaveform::DrawWaveform(painter, pass_rect, scale, waveform, intersect.in(), rectified);
 }
 
-void AudioWaveformCache::Draw(QPainter *painter, const QRect &rect, const double &scale, const rational &start_time) const
+void AudioWaveformCache::DrawWaveforms(QPainter *painter, const QRect &rect, const double &scale, const rational &start_time, const WaveformPtr &waveform, const std::vector<WaveformPassthrough> &passthroughs, bool rectified)
 {
-  if (!passthroughs_.empty()) {
+  if (!passthroughs.empty()) {
     TimeRange wave_range(start_time, start_time + rational::fromDouble(rect.width() / scale));
     TimeRangeList draw_range = {wave_range};
-    for (const WaveformPassthrough &p : passthroughs_) {
+    for (const WaveformPassthrough &p : passthroughs) {
       if (draw_range.OverlapsWith(p, true, false)) {
-        DrawSubRect(painter, rect, scale, wave_range, *p.waveform, p);
+        DrawSubRect(painter, rect, scale, wave_range, p.waveform->waveform, p, rectified);
 
         // Remove this range
         draw_range.remove(p);
@@ -73,21 +109,83 @@ void AudioWaveformCache::Draw(QPainter *painter, const QRect &rect, const double
     }
 
     for (const TimeRange &r : draw_range) {
-      DrawSubRect(painter, rect, scale, wave_range, *waveforms_, r);
+      DrawSubRect(painter, rect, scale, wave_range, waveform->waveform, r, rectified);
     }
   } else {
-    AudioVisualWaveform::DrawWaveform(painter, rect, scale, *waveforms_, start_time);
+    AudioVisualWaveform::DrawWaveform(painter, rect, scale, waveform->waveform, start_time, rectified);
+  }
+}
+
+void AudioWaveformCache::Draw(QPainter *painter, const QRect &rect, const double &scale, const rational &start_time) const
+{
+  if (scale <= 0 || rect.height() <= 0) {
+    return;
+  }
+
+  // Only handle the tiles that are on screen
+  const QRect& viewport = painter->viewport();
+  QPoint top_left = painter->transform().map(viewport.topLeft());
+
+  int left = qMax(rect.x(), -top_left.x());
+  int right = qMin(rect.x() + rect.width(), -top_left.x() + viewport.width());
+  if (left >= right) {
+    return;
+  }
+
+  bool rectified = OLIVE_CONFIG("RectifiedWaveforms").toBool();
+
+  TileKey key;
+  key.zoom = qRound(std::log2(scale) * kZoomLevelsPerOctave);
+  key.height = rect.height();
+  key.color = painter->pen().color().rgba();
+  key.rectified = rectified;
+
+  double tile_length = kTileWidth / GetZoomScale(key.zoom);
+  double start = start_time.toDouble();
+
+  qint64 first = qFloor((start + (left - rect.x()) / scale) / tile_length);
+  qint64 last = qFloor((start + (right - rect.x()) / scale) / tile_length);
+
+  painter->save();
+  painter->setClipRect(rect, painter->hasClipping() ? Qt::IntersectClip : Qt::ReplaceClip);
+  painter->setRenderHint(QPainter::SmoothPixmapTransform);
+
+  QRegion missing;
+
+  for (qint64 i=first; i<=last; i++) {
+    key.index = i;
+
+    QRectF dst(rect.x() + (i * tile_length - start) * scale, rect.y(), tile_length * scale, rect.height());
+
+    auto it = tiles_.find(key);
+    if (it == tiles_.end()) {
+      RequestTile(key);
+      missing += dst.toAlignedRect();
+    } else if (it->image.isNull()) {
+      missing += dst.toAlignedRect();
+    } else {
+      it->accessed = tile_counter_++;
+      painter->drawImage(dst, it->image);
+    }
+  }
+
+  if (!missing.isEmpty()) {
+    // Draw areas whose tiles are still rendering directly
+    painter->setClipRegion(missing, Qt::IntersectClip);
+    DrawWaveforms(painter, rect, scale, start_time, waveforms_, passthroughs_, rectified);
   }
+
+  painter->restore();
 }
 
 AudioVisualWaveform::Sample AudioWaveformCache::GetSummaryFromTime(const rational &start, const rational &length) const
 {
-  return waveforms_->GetSummaryFromTime(start, length);
+  return waveforms_->waveform.GetSummaryFromTime(start, length);
 }
 
 rational AudioWaveformCache::length() const
 {
-  return waveforms_->length();
+  return waveforms_->waveform.length();
 }
 
 void AudioWaveformCache::SetPassthrough(PlaybackCache *cache)
@@ -103,13 +201,143 @@ void AudioWaveformCache::SetPassthrough(PlaybackCache *cache)
 
   SetParameters(c->GetParameters());
   SetSavingEnabled(c->IsSavingEnabled());
+
+  ClearTiles();
 }
 
 void AudioWaveformCache::InvalidateEvent(const TimeRange& range)
 {
   TimeRangeList::util_remove(&passthroughs_, range);
 
+  RemoveTiles(range);
+
   super::InvalidateEvent(range);
 }
 
+void AudioWaveformCache::UpdateMemoryUsage()
+{
+  // Waveforms can't be regenerated without a re-render, so they're reported but never trimmed.
+  // Tiles are capped at kMaximumTiles instead.
+  qint64 usage = waveforms_->waveform.memory_usage() + tile_bytes_;
+
+  if (usage > reported_memory_usage_) {
+    MemoryManager::Allocated(MemoryManager::kWaveforms, usage - reported_memory_usage_);
+  } else if (usage < reported_memory_usage_) {
+    MemoryManager::Released(MemoryManager::kWaveforms, reported_memory_usage_ - usage);
+  }
+
+  reported_memory_usage_ = usage;
+}
+
+double AudioWaveformCache::GetZoomScale(int zoom)
+{
+  return std::exp2(double(zoom) / kZoomLevelsPerOctave);
+}
+
+TimeRange AudioWaveformCache::GetTileRange(const TileKey &key)
+{
+  double tile_length = kTileWidth / GetZoomScale(key.zoom);
+  return TimeRange(rational::fromDouble(key.index * tile_length),
+                   rational::fromDouble((key.index + 1) * tile_length));
+}
+
+void AudioWaveformCache::RequestTile(const TileKey &key) const
+{
+  Tile &t = tiles_[key];
+  t.job = tile_counter_++;
+  t.accessed = t.job;
+
+  quint64 job = t.job;
+  WaveformPtr waveform = waveforms_;
+  std::vector<WaveformPassthrough> passthroughs = passthroughs_;
+  QPointer<AudioWaveformCache> self(const_cast<AudioWaveformCache*>(this));
+
+  QtConcurrent::run([key, job, waveform, passthroughs, self]{
+    // Lock each waveform once, in a consistent order
+    std::vector<WaveformData*> sources = {waveform.get()};
+    for (const WaveformPassthrough &p : passthroughs) {
+      sources.push_back(p.waveform.get());
+    }
+    std::sort(sources.begin(), sources.end());
+    sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+    QImage image(kTileWidth, key.height, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    for (WaveformData *d : sources) {
+      d->lock.lockForRead();
+    }
+
+    QPainter p(&image);
+    p.setPen(QColor::fromRgba(key.color));
+    DrawWaveforms(&p, image.rect(), GetZoomScale(key.zoom), GetTileRange(key).in(), waveform, passthroughs, key.rectified);
+    p.end();
+
+    for (WaveformData *d : sources) {
+      d->lock.unlock();
+    }
+
+    // The cache may be deleted by the time this runs, so don't use it as the context object
+    QMetaObject::invokeMethod(QCoreApplication::instance(), [key, job, image, self]{
+      if (self) {
+        self->TileRendered(key, job, image);
+      }
+    }, Qt::QueuedConnection);
+  });
+}
+
+void AudioWaveformCache::TileRendered(const TileKey &key, quint64 job, const QImage &image)
+{
+  auto it = tiles_.find(key);
+  if (it == tiles_.end() || it->job != job) {
+    // Invalidated while rendering
+    return;
+  }
+
+  it->image = image;
+  tile_bytes_ += image.sizeInBytes();
+
+  // Drop the least recently drawn tiles
+  while (tiles_.size() > kMaximumTiles) {
+    auto oldest = tiles_.end();
+    for (auto jt=tiles_.begin(); jt!=tiles_.end(); jt++) {
+      if (!jt->image.isNull() && (oldest == tiles_.end() || jt->accessed < oldest->accessed)) {
+        oldest = jt;
+      }
+    }
+
+    if (oldest == tiles_.end()) {
+      break;
+    }
+
+    tile_bytes_ -= oldest->image.sizeInBytes();
+    tiles_.erase(oldest);
+  }
+
+  UpdateMemoryUsage();
+
+  emit TilesReady();
+}
+
+void AudioWaveformCache::RemoveTiles(const TimeRange &range)
+{
+  for (auto it=tiles_.begin(); it!=tiles_.end(); ) {
+    if (GetTileRange(it.key()).OverlapsWith(range)) {
+      tile_bytes_ -= it->image.sizeInBytes();
+      it = tiles_.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  UpdateMemoryUsage();
+}
+
+void AudioWaveformCache::ClearTiles()
+{
+  tiles_.clear();
+  tile_bytes_ = 0;
+  UpdateMemoryUsage();
+}
+
 }
@@ -21,6 +21,10 @@
 #ifndef AUDIOWAVEFORMCACHE_H
 #define AUDIOWAVEFORMCACHE_H
 
+#include <QHash>
+#include <QImage>
+#include <QReadWriteLock>
+
 #include "audio/audiovisualwaveform.h"
 #include "playbackcache.h"
 
@@ -32,15 +36,20 @@ class AudioWaveformCache : public PlaybackCache
 public:
   AudioWaveformCache(QObject *parent = nullptr);
 
+  virtual ~AudioWaveformCache() override;
+
   void WriteWaveform(const TimeRange &range, const TimeRangeList &valid_ranges, const AudioVisualWaveform *waveform);
 
   const AudioParams &GetParameters() const { return params_; }
-  void SetParameters(const AudioParams &p)
-  {
-    params_ = p;
-    waveforms_->set_channel_count(p.channel_count());
-  }
-
+  void SetParameters(const AudioParams &p);
+
+  /**
+   * @brief Draw the waveform from cached image tiles
+   *
+   * Tiles are rendered in the background for a handful of zoom levels per octave and stretched to
+   * the exact scale. Until a tile is ready, its area is drawn directly from the waveform and
+   * TilesReady() is emitted once it has been rendered.
+   */
   void Draw(QPainter* painter, const QRect &rect, const double &scale, const rational &start_time) const;
 
   AudioVisualWaveform::Sample GetSummaryFromTime(const rational &start, const rational &length) const;
@@ -49,16 +58,31 @@ public:
 
   virtual void SetPassthrough(PlaybackCache *cache) override;
 
+signals:
+  void TilesReady();
+
 protected:
   virtual void InvalidateEvent(const TimeRange& range) override;
 
 private:
-  using WaveformPtr = std::shared_ptr<AudioVisualWaveform>;
+  void UpdateMemoryUsage();
+
+  struct WaveformData
+  {
+    AudioVisualWaveform waveform;
+
+    // Tiles are rendered in other threads, so writes to the waveform are locked
+    QReadWriteLock lock;
+  };
+
+  using WaveformPtr = std::shared_ptr<WaveformData>;
 
   WaveformPtr waveforms_;
 
   AudioParams params_;
 
+  qint64 reported_memory_usage_;
+
   class WaveformPassthrough : public TimeRange
   {
   public:
@@ -71,6 +95,58 @@ private:
 
   std::vector<WaveformPassthrough> passthroughs_;
 
+  static void DrawWaveforms(QPainter *painter, const QRect &rect, const double &scale, const rational &start_time, const WaveformPtr &waveform, const std::vector<WaveformPassthrough> &passthroughs, bool rectified);
+
+  struct TileKey
+  {
+    int zoom;
+    qint64 index;
+    int height;
+    QRgb color;
+    bool rectified;
+
+    bool operator==(const TileKey &rhs) const
+    {
+      return zoom == rhs.zoom && index == rhs.index && height == rhs.height
+          && color == rhs.color && rectified == rhs.rectified;
+    }
+
+    friend uint qHash(const TileKey &k, uint seed = 0)
+    {
+      return ::qHash(k.index, seed) ^ ::qHash((qint64(k.zoom) << 32) | (k.height << 1) | int(k.rectified)) ^ ::qHash(k.color);
+    }
+  };
+
+  struct Tile
+  {
+    QImage image;
+
+    // Identifies the render that will fill this tile, results from older renders are discarded
+    quint64 job;
+
+    quint64 accessed;
+  };
+
+  static double GetZoomScale(int zoom);
+
+  static TimeRange GetTileRange(const TileKey &key);
+
+  void RequestTile(const TileKey &key) const;
+
+  void TileRendered(const TileKey &key, quint64 job, const QImage &image);
+
+  void RemoveTiles(const TimeRange &range);
+
+  void ClearTiles();
+
+  static const int kTileWidth = 256;
+  static const int kZoomLevelsPerOctave = 4;
+  static const int kMaximumTiles = 256;
+
+  mutable QHash<TileKey, Tile> tiles_;
+  mutable quint64 tile_counter_;
+  qint64 tile_bytes_;
+
 };
 
 }
@@ -78,12 +78,14 @@ ColorProcessor::ColorProcessor(ColorManager *config, const QString &input, const
   }
 
   cpu_processor_ = processor_->getDefaultCPUProcessor();
+  id_ = QString::fromUtf8(processor_->getCacheID());
 }
 
 ColorProcessor::ColorProcessor(OCIO::ConstProcessorRcPtr processor)
 {
   processor_ = processor;
   cpu_processor_ = processor_->getDefaultCPUProcessor();
+  id_ = QString::fromUtf8(processor_->getCacheID());
 }
 
 void ColorProcessor::ConvertFrame(Frame *f)
@@ -55,14 +55,16 @@ public:
 
   Color ConvertColor(const Color &in);
 
-  const char *id() const
+  const QString &id() const
   {
-    return processor_->getCacheID();
+    return id_;
   }
 
 private:
   OCIO::ConstProcessorRcPtr processor_;
 
+  QString id_;
+
   OCIO::ConstCPUProcessorRcPtr cpu_processor_;
 
 };
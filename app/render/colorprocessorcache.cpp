@@ -0,0 +1,79 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "colorprocessorcache.h"
+
+#include "node/color/colormanager/colormanager.h"
+
+namespace olive {
+
+QHash<ColorProcessorCache::Key, ColorProcessorPtr> ColorProcessorCache::cache_;
+QMutex ColorProcessorCache::lock_;
+
+ColorProcessorPtr ColorProcessorCache::Get(ColorManager *config, const QString &input, const ColorTransform &dest_space, ColorProcessor::Direction direction)
+{
+  Key key = {QString::fromUtf8(config->GetConfig()->getCacheID()),
+             input,
+             dest_space.output(),
+             dest_space.view(),
+             dest_space.look(),
+             dest_space.is_display(),
+             direction};
+
+  QMutexLocker locker(&lock_);
+
+  ColorProcessorPtr processor = cache_.value(key);
+
+  if (!processor) {
+    // Built under the lock so two threads asking for the same conversion don't both build it
+    processor = ColorProcessor::Create(config, input, dest_space, direction);
+
+    if (cache_.size() >= kMaximumEntries) {
+      for (auto it=cache_.begin(); it!=cache_.end(); ) {
+        if (it.key().config_id == key.config_id) {
+          it++;
+        } else {
+          it = cache_.erase(it);
+        }
+      }
+    }
+
+    cache_.insert(key, processor);
+  }
+
+  return processor;
+}
+
+void ColorProcessorCache::RemoveConfig(OCIO::ConstConfigRcPtr config)
+{
+  QString config_id = QString::fromUtf8(config->getCacheID());
+
+  QMutexLocker locker(&lock_);
+
+  for (auto it=cache_.begin(); it!=cache_.end(); ) {
+    if (it.key().config_id == config_id) {
+      it = cache_.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+}
@@ -21,11 +21,73 @@
 #ifndef COLORPROCESSORCACHE_H
 #define COLORPROCESSORCACHE_H
 
+#include <QHash>
+#include <QMutex>
+
 #include "render/colorprocessor.h"
 
 namespace olive {
 
-using ColorProcessorCache = QHash<QString, ColorProcessorPtr>;
+/**
+ * @brief Process-wide cache of color processors
+ *
+ * Building an OCIO processor and its CPU processor is expensive, and the same handful of
+ * conversions are requested for every frame. Processors are keyed by the config they were built
+ * from plus the source, destination, look and direction, so a reloaded config never returns a
+ * stale processor. The replaced config's processors are dropped when a ColorManager reloads its
+ * config file (see RemoveConfig()). Because the same ColorProcessor object is returned each time, renderers can
+ * key their compiled shaders and LUT textures on it too.
+ *
+ * All functions are thread-safe.
+ */
+class ColorProcessorCache
+{
+public:
+  static ColorProcessorPtr Get(ColorManager *config, const QString &input, const ColorTransform &dest_space,
+                               ColorProcessor::Direction direction = ColorProcessor::kNormal);
+
+  /**
+   * @brief Drop every processor built from `config`
+   *
+   * Called when a ColorManager replaces its config, since nothing will request those processors
+   * again. Processors built from other configs are left alone.
+   */
+  static void RemoveConfig(OCIO::ConstConfigRcPtr config);
+
+private:
+  struct Key
+  {
+    QString config_id;
+    QString input;
+    QString output;
+    QString view;
+    QString look;
+    bool is_display;
+    ColorProcessor::Direction direction;
+
+    bool operator==(const Key &rhs) const
+    {
+      return config_id == rhs.config_id && input == rhs.input && output == rhs.output
+          && view == rhs.view && look == rhs.look && is_display == rhs.is_display
+          && direction == rhs.direction;
+    }
+
+    friend uint qHash(const Key &k, uint seed = 0)
+    {
+      return ::qHash(k.config_id, seed) ^ ::qHash(k.input, seed) ^ ::qHash(k.output, seed)
+          ^ ::qHash(k.view, seed) ^ ::qHash(k.look, seed) ^ uint(k.is_display) ^ (uint(k.direction) << 1);
+    }
+  };
+
+  // Once the cache gets this large, processors from configs other than the requesting one are
+  // dropped. The current config's processors are kept, as they're the ones still in use.
+  static const int kMaximumEntries = 256;
+
+  static QHash<Key, ColorProcessorPtr> cache_;
+
+  static QMutex lock_;
+
+};
 
 }
 
@@ -34,6 +34,7 @@
 #include "common/filefunctions.h"
 #include "common/oiioutils.h"
 #include "render/diskmanager.h"
+#include "render/rendertrace.h"
 
 namespace olive {
 
@@ -105,6 +106,8 @@ bool FrameHashCache::SaveCacheFrame(const QString &cache_path, const QUuid &uuid
 
 bool FrameHashCache::SaveCacheFrame(const QString &cache_path, const QUuid &uuid, const rational &time, const rational &tb, FramePtr frame)
 {
+  RenderTraceSpan span("Cache", "Save Cache Frame", time);
+
   if (cache_path.isEmpty()) {
     qWarning() << "Failed to save cache frame with empty path";
     return false;
@@ -122,6 +125,30 @@ bool FrameHashCache::SaveCacheFrame(const QString &cache_path, const QUuid &uuid
   return ret;
 }
 
+bool FrameHashCache::SaveCacheImage(const QString &cache_path, const QUuid &uuid, const int64_t &time, const QImage &image)
+{
+  if (cache_path.isEmpty()) {
+    qWarning() << "Failed to save cache frame with empty path";
+    return false;
+  }
+
+  QString fn = CachePathName(cache_path, uuid, time);
+
+  // Ensure directory is created
+  if (!FileFunctions::DirectoryIsValid(QFileInfo(fn).dir())) {
+    return false;
+  }
+
+  bool ret = image.save(fn, "jpg");
+
+  // Register frame with the disk manager
+  if (ret) {
+    QMetaObject::invokeMethod(DiskManager::instance(), "CreatedFile", Q_ARG(QString, cache_path), Q_ARG(QString, fn));
+  }
+
+  return ret;
+}
+
 FramePtr FrameHashCache::LoadCacheFrame(const QString &cache_path, const QUuid &uuid, const int64_t &time)
 {
   // Minor optimization, we store frames currently being saved just in case something tries to load
@@ -21,6 +21,8 @@
 #ifndef VIDEORENDERFRAMECACHE_H
 #define VIDEORENDERFRAMECACHE_H
 
+#include <QImage>
+
 #include "codec/frame.h"
 #include "render/playbackcache.h"
 #include "render/videoparams.h"
@@ -51,6 +53,7 @@ public:
   bool SaveCacheFrame(const int64_t &time, FramePtr frame) const;
   static bool SaveCacheFrame(const QString& cache_path, const QUuid &uuid, const int64_t &time, FramePtr frame);
   static bool SaveCacheFrame(const QString& cache_path, const QUuid &uuid, const rational &time, const rational &tb, FramePtr frame);
+  static bool SaveCacheImage(const QString& cache_path, const QUuid &uuid, const int64_t &time, const QImage &image);
   static FramePtr LoadCacheFrame(const QString& cache_path, const QUuid &uuid, const int64_t &time);
   FramePtr LoadCacheFrame(const int64_t &time) const;
   static FramePtr LoadCacheFrame(const QString& fn);
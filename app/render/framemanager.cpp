@@ -20,13 +20,31 @@
 
 #include "framemanager.h"
 
+#include <cstdlib>
+#include <new>
 #include <QDateTime>
 #include <QDebug>
+#include <QThread>
+
+#if defined(Q_OS_WINDOWS)
+#include <malloc.h>
+#elif defined(Q_OS_LINUX)
+#include <sys/mman.h>
+#endif
+
+#include "config/config.h"
 
 namespace olive {
 
-FrameManager* FrameManager::instance_ = nullptr;
+std::atomic<FrameManager*> FrameManager::instance_(nullptr);
+std::atomic<int> FrameManager::users_(0);
 const int FrameManager::kFrameLifetime = 5000;
+thread_local FrameManager::ThreadCache FrameManager::thread_cache_;
+std::atomic<quint64> FrameManager::hits_(0);
+std::atomic<quint64> FrameManager::misses_(0);
+std::atomic<qint64> FrameManager::bytes_held_(0);
+std::atomic<quint64> FrameManager::thread_cache_flush_generation_(0);
+bool FrameManager::use_huge_pages_ = false;
 
 void FrameManager::CreateInstance()
 {
@@ -35,8 +53,14 @@ void FrameManager::CreateInstance()
 
 void FrameManager::DestroyInstance()
 {
-  delete instance_;
-  instance_ = nullptr;
+  FrameManager *m = instance_.exchange(nullptr);
+
+  // Threads that got hold of the instance before it was cleared may still be using its pool
+  while (users_ > 0) {
+    QThread::yieldCurrentThread();
+  }
+
+  delete m;
 }
 
 FrameManager *FrameManager::instance()
@@ -46,54 +70,242 @@ FrameManager *FrameManager::instance()
 
 char *FrameManager::Allocate(int size)
 {
-  if (instance()) {
-    return instance()->AllocateFromPool(size);
+  int size_class = GetSizeClass(size);
+
+  thread_cache_.FlushIfRequested();
+
+  // Try this thread's own buffers first, no locking required
+  std::vector<char*> &local = thread_cache_.buffers[size_class];
+  if (!local.empty()) {
+    char *buf = local.back();
+    local.pop_back();
+
+    hits_++;
+    AddHeldBytes(-GetClassSize(size_class));
+
+    return buf;
+  }
+
+  InstanceReference ref;
+  if (ref.get()) {
+    return ref.get()->AllocateFromPool(size_class);
   } else {
-    return new char[size];
+    misses_++;
+    return AllocateBuffer(GetClassSize(size_class));
   }
 }
 
 void FrameManager::Deallocate(int size, char *buffer)
 {
-  if (instance()) {
-    instance()->DeallocateToPool(size, buffer);
-  } else {
-    delete [] buffer;
+  InstanceReference ref;
+  if (!ref.get()) {
+    FreeBuffer(buffer);
+    return;
+  }
+
+  int size_class = GetSizeClass(size);
+  qint64 class_size = GetClassSize(size_class);
+
+  AddHeldBytes(class_size);
+
+  thread_cache_.FlushIfRequested();
+
+  if (class_size > kThreadCacheMaximumSize) {
+    // Too big to leave sitting in a thread that may not need it again
+    ref.get()->DeallocateToPool(size_class, &buffer, 1);
+    return;
+  }
+
+  std::vector<char*> &local = thread_cache_.buffers[size_class];
+  local.push_back(buffer);
+
+  if (local.size() >= kThreadCacheBatch * 2) {
+    // Hand the older half back to the shared pool in one go
+    ref.get()->DeallocateToPool(size_class, local.data(), kThreadCacheBatch);
+    local.erase(local.begin(), local.begin() + kThreadCacheBatch);
+  }
+}
+
+FrameManager::Statistics FrameManager::GetStatistics()
+{
+  Statistics s;
+
+  s.hits = hits_;
+  s.misses = misses_;
+  s.bytes_held = bytes_held_;
+
+  return s;
+}
+
+qint64 FrameManager::TrimMemory(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  qint64 freed = 0;
+
+  while (freed < bytes) {
+    // Find the class whose oldest buffer has been sitting in the pool the longest
+    auto oldest = pool_.end();
+    for (auto it=pool_.begin(); it!=pool_.end(); it++) {
+      if (!it->second.empty() && (oldest == pool_.end() || it->second.front().time < oldest->second.front().time)) {
+        oldest = it;
+      }
+    }
+
+    if (oldest == pool_.end()) {
+      break;
+    }
+
+    FreeBuffer(oldest->second.front().data);
+    oldest->second.pop_front();
+    freed += GetClassSize(oldest->first);
   }
+
+  AddHeldBytes(-freed);
+
+  if (freed < bytes) {
+    // The rest is in thread caches, which only their own threads can touch
+    thread_cache_flush_generation_++;
+  }
+
+  return freed;
 }
 
 FrameManager::FrameManager()
 {
+  use_huge_pages_ = OLIVE_CONFIG("FrameHugePages").toBool();
+
   clear_timer_.setInterval(kFrameLifetime);
   connect(&clear_timer_, &QTimer::timeout, this, &FrameManager::GarbageCollection);
   clear_timer_.start();
+
+  if (MemoryManager::instance()) {
+    MemoryManager::instance()->RegisterClient(MemoryManager::kFramePool, this);
+  }
 }
 
-char *FrameManager::AllocateFromPool(int size)
+char *FrameManager::AllocateFromPool(int size_class)
 {
   QMutexLocker locker(&mutex_);
 
-  std::list<Buffer>& buffer_list = pool_[size];
-  char* buf = nullptr;
+  std::list<Buffer>& buffer_list = pool_[size_class];
 
-  if (buffer_list.empty()) {
-    buf = new char[size];
-  } else {
-    // Take this buffer from the list
-    buf = buffer_list.front().data;
-    buffer_list.pop_front();
+  if (!buffer_list.empty()) {
+    // Take the most recently returned buffer, leaving older ones to expire
+    char *buf = buffer_list.back().data;
+    buffer_list.pop_back();
+
+    locker.unlock();
+
+    hits_++;
+    AddHeldBytes(-GetClassSize(size_class));
+
+    return buf;
   }
 
-  return buf;
+  locker.unlock();
+
+  misses_++;
+  return AllocateBuffer(GetClassSize(size_class));
 }
 
-void FrameManager::DeallocateToPool(int size, char *buffer)
+void FrameManager::DeallocateToPool(int size_class, char* const* buffers, size_t count)
 {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+
   QMutexLocker locker(&mutex_);
 
-  std::list<Buffer>& buffer_list = pool_[size];
+  std::list<Buffer>& buffer_list = pool_[size_class];
+
+  for (size_t i=0; i<count; i++) {
+    buffer_list.push_back({now, buffers[i]});
+  }
+}
+
+int FrameManager::GetSizeClass(int size)
+{
+  if (size <= kMinimumClassSize) {
+    return 0;
+  }
+
+  // Find the octave (base, base*2] that this size falls in
+  qint64 base = kMinimumClassSize;
+  int octave = 0;
+  while (base * 2 < size) {
+    base *= 2;
+    octave++;
+  }
+
+  // Then which of the evenly spaced classes within that octave is the first to fit it
+  qint64 step = base / kClassesPerOctave;
+  int sub = int((size - base + step - 1) / step);
+
+  return 1 + octave * kClassesPerOctave + (sub - 1);
+}
+
+qint64 FrameManager::GetClassSize(int size_class)
+{
+  if (size_class == 0) {
+    return kMinimumClassSize;
+  }
+
+  int octave = (size_class - 1) / kClassesPerOctave;
+  int sub = (size_class - 1) % kClassesPerOctave + 1;
+
+  qint64 base = qint64(kMinimumClassSize) << octave;
+
+  return base + sub * (base / kClassesPerOctave);
+}
+
+char *FrameManager::AllocateBuffer(qint64 size)
+{
+  size_t alignment = kAlignment;
+  if (use_huge_pages_ && size >= kLargeBufferSize) {
+    alignment = kLargeBufferSize;
+  }
+
+  void *buf;
+
+#ifdef Q_OS_WINDOWS
+  buf = _aligned_malloc(size, alignment);
+#else
+  if (posix_memalign(&buf, alignment, size) != 0) {
+    buf = nullptr;
+  }
+#endif
+
+  if (!buf) {
+    throw std::bad_alloc();
+  }
+
+#ifdef Q_OS_LINUX
+  if (alignment == size_t(kLargeBufferSize)) {
+    // Only a hint, if transparent huge pages are disabled this does nothing
+    madvise(buf, size, MADV_HUGEPAGE);
+  }
+#endif
+
+  return static_cast<char*>(buf);
+}
+
+void FrameManager::FreeBuffer(char *buffer)
+{
+#ifdef Q_OS_WINDOWS
+  _aligned_free(buffer);
+#else
+  free(buffer);
+#endif
+}
+
+void FrameManager::AddHeldBytes(qint64 bytes)
+{
+  bytes_held_ += bytes;
 
-  buffer_list.push_back({QDateTime::currentMSecsSinceEpoch(), buffer});
+  if (bytes > 0) {
+    MemoryManager::Allocated(MemoryManager::kFramePool, bytes);
+  } else if (bytes < 0) {
+    MemoryManager::Released(MemoryManager::kFramePool, -bytes);
+  }
 }
 
 void FrameManager::GarbageCollection()
@@ -101,29 +313,84 @@ void FrameManager::GarbageCollection()
   QMutexLocker locker(&mutex_);
 
   qint64 min_life = QDateTime::currentMSecsSinceEpoch() - kFrameLifetime;
+  qint64 freed = 0;
 
   for (auto it=pool_.begin(); it!=pool_.end(); it++) {
     std::list<Buffer>& list = it->second;
 
     while (list.size() > 0 && list.front().time < min_life) {
-      delete [] list.front().data;
+      FreeBuffer(list.front().data);
       list.pop_front();
+
+      freed += GetClassSize(it->first);
     }
   }
+
+  AddHeldBytes(-freed);
 }
 
 FrameManager::~FrameManager()
 {
+  if (MemoryManager::instance()) {
+    MemoryManager::instance()->UnregisterClient(this);
+  }
+
   QMutexLocker locker(&mutex_);
 
+  qint64 freed = 0;
+
   for (auto it=pool_.begin(); it!=pool_.end(); it++) {
     std::list<Buffer>& list = it->second;
     for (auto jt=list.begin(); jt!=list.end(); jt++) {
-      delete [] (*jt).data;
+      FreeBuffer((*jt).data);
     }
+
+    freed += GetClassSize(it->first) * qint64(list.size());
   }
 
   pool_.clear();
+
+  AddHeldBytes(-freed);
+}
+
+FrameManager::ThreadCache::~ThreadCache()
+{
+  // Buffers of a thread that's exiting go back to the shared pool, or are freed if there's no
+  // longer a pool to go back to
+  Flush();
+}
+
+void FrameManager::ThreadCache::Flush()
+{
+  InstanceReference ref;
+
+  for (auto it=buffers.begin(); it!=buffers.end(); it++) {
+    std::vector<char*> &list = it->second;
+    if (list.empty()) {
+      continue;
+    }
+
+    if (ref.get()) {
+      ref.get()->DeallocateToPool(it->first, list.data(), list.size());
+    } else {
+      for (char *b : list) {
+        FreeBuffer(b);
+      }
+      AddHeldBytes(-GetClassSize(it->first) * qint64(list.size()));
+    }
+
+    list.clear();
+  }
+}
+
+void FrameManager::ThreadCache::FlushIfRequested()
+{
+  // Relaxed is enough, a late flush only means the memory is given back a little later
+  quint64 requested = thread_cache_flush_generation_.load(std::memory_order_relaxed);
+  if (flush_generation != requested) {
+    flush_generation = requested;
+    Flush();
+  }
 }
 
 }
@@ -21,13 +21,29 @@
 #ifndef FRAMEMANAGER_H
 #define FRAMEMANAGER_H
 
+#include <atomic>
+#include <list>
+#include <map>
 #include <QMutex>
 #include <QObject>
 #include <QTimer>
+#include <vector>
+
+#include "render/memorymanager.h"
 
 namespace olive {
 
-class FrameManager : public QObject
+/**
+ * @brief Pooled allocator for frame buffers
+ *
+ * Sizes are rounded up to one of a set of size classes (four per power of two) so frames of
+ * slightly different sizes can still share buffers. Every buffer is aligned to at least
+ * kAlignment bytes. Each thread keeps up to a few released buffers per size class of its own that
+ * it can reuse without locking, handing them back to the shared pool in batches. With large frames
+ * that can add up to hundreds of megabytes per thread, so TrimMemory() can ask threads to give
+ * them all back.
+ */
+class FrameManager : public QObject, public MemoryManager::Client
 {
   Q_OBJECT
 public:
@@ -41,6 +57,47 @@ public:
 
   static void Deallocate(int size, char* buffer);
 
+  struct Statistics
+  {
+    quint64 hits = 0;
+    quint64 misses = 0;
+    qint64 bytes_held = 0;
+
+    double hit_rate() const
+    {
+      quint64 total = hits + misses;
+      return total ? double(hits) / double(total) : 0.0;
+    }
+  };
+
+  /**
+   * @brief Retrieve usage statistics of the pool
+   *
+   * This function is thread-safe.
+   */
+  static Statistics GetStatistics();
+
+  /**
+   * @brief Free pooled buffers, oldest first
+   *
+   * Only the shared pool can be freed from here. If that isn't enough, every thread is asked to
+   * return its cached buffers to the shared pool the next time it allocates or frees a frame, so
+   * a later trim or garbage collection can free them.
+   */
+  virtual qint64 TrimMemory(qint64 bytes) override;
+
+  /**
+   * @brief Index of the smallest size class that fits `size` bytes
+   */
+  static int GetSizeClass(int size);
+
+  /**
+   * @brief Size in bytes of the buffers in a size class
+   */
+  static qint64 GetClassSize(int size_class);
+
+  static const int kAlignment = 64;
+
 private:
   FrameManager();
 
@@ -49,39 +106,115 @@ private:
   /**
    * @brief Allocate buffer
    *
-   * Caller takes ownership of buffer and can delete it if they want. It can also be returned to
-   * the manager with Deallocate and potentially be re-used later.
+   * Caller takes ownership of buffer and can free it with FreeBuffer() if they want. It can also be
+   * returned to the manager with Deallocate and potentially be re-used later.
    *
    * Thread-safe.
    */
-  char* AllocateFromPool(int size);
+  char* AllocateFromPool(int size_class);
 
   /**
-   * @brief Deallocate buffer
+   * @brief Deallocate buffers
    *
-   * Manager will take ownership and buffer will stay allocated for some time in case it can be
+   * Manager will take ownership and buffers will stay allocated for some time in case it can be
    * re-used.
    *
    * Thread-safe.
    */
-  void DeallocateToPool(int size, char* buffer);
+  void DeallocateToPool(int size_class, char* const* buffers, size_t count);
+
+  static char* AllocateBuffer(qint64 size);
+
+  static void FreeBuffer(char *buffer);
+
+  static void AddHeldBytes(qint64 bytes);
+
+  /**
+   * @brief Keeps the instance alive while a thread takes buffers from or returns them to its pool
+   *
+   * Threads may exit, and so flush their caches, while DestroyInstance() is running. It clears the
+   * instance first so no new references are taken, then waits for existing ones to go away before
+   * deleting it.
+   */
+  class InstanceReference
+  {
+  public:
+    InstanceReference()
+    {
+      users_++;
+      manager_ = instance_;
+    }
+
+    ~InstanceReference()
+    {
+      users_--;
+    }
+
+    FrameManager *get() const { return manager_; }
 
-  static FrameManager* instance_;
+  private:
+    FrameManager *manager_;
+
+  };
+
+  static std::atomic<FrameManager*> instance_;
+
+  // Number of InstanceReference objects alive right now
+  static std::atomic<int> users_;
 
   static const int kFrameLifetime;
 
+  static const int kMinimumClassSize = 4096;
+  static const int kClassesPerOctave = 4;
+
+  // Buffers this large are aligned to huge page boundaries so the kernel can back them with huge
+  // pages, and skip per-thread caches entirely
+  static const qint64 kLargeBufferSize = 2 * 1024 * 1024;
+  static const qint64 kThreadCacheMaximumSize = 64 * 1024 * 1024;
+  static const size_t kThreadCacheBatch = 2;
+
   struct Buffer
   {
     qint64 time;
     char* data;
   };
 
+  struct ThreadCache
+  {
+    ~ThreadCache();
+
+    /**
+     * @brief Return every buffer to the shared pool, or free them if there's no pool
+     */
+    void Flush();
+
+    /**
+     * @brief Flush if TrimMemory() asked threads to since this cache last checked
+     */
+    void FlushIfRequested();
+
+    std::map< int, std::vector<char*> > buffers;
+
+    quint64 flush_generation = 0;
+  };
+
+  static thread_local ThreadCache thread_cache_;
+
+  // Incremented by TrimMemory() to ask every thread to flush its cache
+  static std::atomic<quint64> thread_cache_flush_generation_;
+
   std::map< int, std::list<Buffer> > pool_;
 
   QMutex mutex_;
 
   QTimer clear_timer_;
 
+  static std::atomic<quint64> hits_;
+  static std::atomic<quint64> misses_;
+  static std::atomic<qint64> bytes_held_;
+
+  static bool use_huge_pages_;
+
 private slots:
   void GarbageCollection();
 
@@ -21,6 +21,8 @@
 #ifndef ACCELERATEDJOB_H
 #define ACCELERATEDJOB_H
 
+#include <QRectF>
+
 #include "node/param.h"
 #include "node/valuedatabase.h"
 
@@ -33,6 +35,20 @@ public:
 
   virtual ~AcceleratedJob(){}
 
+  enum JobType {
+    kJobCache,
+    kJobColorTransform,
+    kJobFootage,
+    kJobGenerate,
+    kJobSample,
+    kJobShader
+  };
+
+  /**
+   * @brief Concrete type of this job, allows resolving jobs without a chain of dynamic_casts
+   */
+  virtual JobType GetJobType() const = 0;
+
   NodeValue Get(const QString& input) const
   {
     return value_map_.value(input);
@@ -62,9 +78,19 @@ public:
   const NodeValueRow &GetValues() const { return value_map_; }
   NodeValueRow &GetValues() { return value_map_; }
 
+  /**
+   * @brief Region of the output that is actually needed, in normalized texture coordinates
+   *
+   * Renderers may skip shading pixels outside of it. A null rect means the whole output is needed.
+   */
+  const QRectF &GetRegionOfInterest() const { return region_of_interest_; }
+  void SetRegionOfInterest(const QRectF &r) { region_of_interest_ = r; }
+
 private:
   NodeValueRow value_map_;
 
+  QRectF region_of_interest_;
+
 };
 
 }
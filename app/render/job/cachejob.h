@@ -38,6 +38,11 @@ public:
     filename_ = filename;
   }
 
+  virtual JobType GetJobType() const override
+  {
+    return kJobCache;
+  }
+
   const QString &GetFilename() const { return filename_; }
   void SetFilename(const QString &s) { filename_ = s; }
 
@@ -51,6 +51,11 @@ public:
     Insert(row);
   }
 
+  virtual JobType GetJobType() const override
+  {
+    return kJobColorTransform;
+  }
+
   QString id() const
   {
     if (id_.isEmpty()) {
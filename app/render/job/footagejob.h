@@ -43,6 +43,11 @@ public:
   {
   }
 
+  virtual JobType GetJobType() const override
+  {
+    return kJobFootage;
+  }
+
   const QString& decoder() const
   {
     return decoder_;
@@ -36,6 +36,11 @@ public:
     Insert(row);
   }
 
+  virtual JobType GetJobType() const override
+  {
+    return kJobGenerate;
+  }
+
 };
 
 }
@@ -44,6 +44,11 @@ public:
     time_ = time;
   }
 
+  virtual JobType GetJobType() const override
+  {
+    return kJobSample;
+  }
+
   const SampleBuffer &samples() const
   {
     return samples_;
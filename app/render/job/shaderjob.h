@@ -44,6 +44,11 @@ public:
     Insert(row);
   }
 
+  virtual JobType GetJobType() const override
+  {
+    return kJobShader;
+  }
+
   const QString& GetShaderID() const
   {
     return shader_id_;
@@ -95,6 +100,39 @@ public:
     interpolation_.insert(id, interp);
   }
 
+  /**
+   * @brief Declare that this shader only samples `input` at the fragment's own coordinate
+   *
+   * Pointwise shaders (no neighborhood sampling of their main input) can be fused with the shader
+   * that produces that input into a single pass, saving a full-frame texture write and read.
+   */
+  void SetPointwiseInput(const NodeInput& input)
+  {
+    SetPointwiseInput(input.input());
+  }
+
+  void SetPointwiseInput(const QString& input)
+  {
+    pointwise_input_ = input;
+  }
+
+  const QString& GetPointwiseInput() const
+  {
+    return pointwise_input_;
+  }
+
+  /**
+   * @brief Returns whether this job can be merged with others into one pass
+   *
+   * Iterative jobs and jobs that transform their geometry need a pass of their own.
+   */
+  bool IsFusable() const
+  {
+    return (iterations_ <= 1 || iterative_input_.isEmpty())
+        && vertex_overrides_.isEmpty()
+        && !GetValues().contains(QStringLiteral("ove_mvpmat"));
+  }
+
   void SetVertexCoordinates(const QVector<float> &vertex_coords)
   {
     vertex_overrides_ = vertex_coords;
@@ -116,6 +154,8 @@ private:
 
   QVector<float> vertex_overrides_;
 
+  QString pointwise_input_;
+
 };
 
 }
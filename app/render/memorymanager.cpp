@@ -0,0 +1,204 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "memorymanager.h"
+
+#include <QDebug>
+
+#if defined(Q_OS_WINDOWS)
+#include <Windows.h>
+#elif defined(Q_OS_MAC)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "config/config.h"
+
+namespace olive {
+
+MemoryManager* MemoryManager::instance_ = nullptr;
+std::atomic<qint64> MemoryManager::usage_[kSubsystemCount] = {};
+
+void MemoryManager::CreateInstance()
+{
+  instance_ = new MemoryManager();
+}
+
+void MemoryManager::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+MemoryManager *MemoryManager::instance()
+{
+  return instance_;
+}
+
+void MemoryManager::Allocated(Subsystem s, qint64 bytes)
+{
+  usage_[s].fetch_add(bytes, std::memory_order_relaxed);
+
+  // Trimming calls back into the caches, which may be holding their own locks right now, so it's
+  // always deferred to the main thread
+  if (instance_ && GetTotalUsage() > instance_->budget_ && !instance_->trim_queued_.exchange(true)) {
+    QMetaObject::invokeMethod(instance_, "Trim", Qt::QueuedConnection);
+  }
+}
+
+void MemoryManager::Released(Subsystem s, qint64 bytes)
+{
+  usage_[s].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+qint64 MemoryManager::GetTotalUsage()
+{
+  qint64 total = 0;
+  for (int i=0; i<kSubsystemCount; i++) {
+    total += usage_[i].load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+QString MemoryManager::GetSubsystemName(Subsystem s)
+{
+  switch (s) {
+  case kThumbnails:
+    return tr("Thumbnails");
+  case kFramePool:
+    return tr("Frame Pool");
+  case kTexturePool:
+    return tr("Texture Pool");
+  case kDecoderFrames:
+    return tr("Decoded Frames");
+  case kWaveforms:
+    return tr("Waveforms");
+  case kAudioPrequeue:
+    return tr("Audio Pre-Queue");
+  case kSubsystemCount:
+    break;
+  }
+
+  return QString();
+}
+
+void MemoryManager::UpdateBudget()
+{
+  qint64 budget = OLIVE_CONFIG("MemoryBudget").toLongLong() * 1024 * 1024;
+
+  if (budget <= 0) {
+    budget = GetPhysicalMemory() / 2;
+  }
+
+  budget_ = budget;
+}
+
+void MemoryManager::RegisterClient(Subsystem s, Client *client)
+{
+  QMutexLocker locker(&clients_lock_);
+
+  clients_[s].append(client);
+}
+
+void MemoryManager::UnregisterClient(Client *client)
+{
+  QMutexLocker locker(&clients_lock_);
+
+  for (int i=0; i<clients_.size(); i++) {
+    clients_[i].removeOne(client);
+  }
+}
+
+void MemoryManager::Trim()
+{
+  trim_queued_ = false;
+
+  UpdateBudget();
+
+  // Trim a little further than the budget so we're not called again on the very next allocation
+  qint64 target = budget_ / 10 * 9;
+
+  QMutexLocker locker(&clients_lock_);
+
+  // Clients that free memory later in another thread report what they will free rather than what
+  // they have, so this counts down from what they return rather than re-reading usage
+  qint64 excess = GetTotalUsage() - target;
+
+  for (int i=0; i<kSubsystemCount && excess > 0; i++) {
+    foreach (Client *c, clients_.at(i)) {
+      excess -= c->TrimMemory(excess);
+      if (excess <= 0) {
+        break;
+      }
+    }
+  }
+
+  // Only warn when we first get stuck over budget, since memory that can't be trimmed will keep
+  // us there for every trim after it
+  bool over_budget = (excess > budget_ - target);
+  if (over_budget && !over_budget_warned_) {
+    QStringList report;
+    for (int i=0; i<kSubsystemCount; i++) {
+      report.append(QStringLiteral("%1: %2 MiB").arg(GetSubsystemName(Subsystem(i)),
+                                                     QString::number(GetUsage(Subsystem(i)) / 1024 / 1024)));
+    }
+    qWarning() << "Memory usage is still over budget after trimming -" << report.join(QStringLiteral(", "));
+  }
+  over_budget_warned_ = over_budget;
+}
+
+MemoryManager::MemoryManager() :
+  trim_queued_(false),
+  over_budget_warned_(false),
+  clients_(kSubsystemCount)
+{
+  UpdateBudget();
+}
+
+qint64 MemoryManager::GetPhysicalMemory()
+{
+#if defined(Q_OS_WINDOWS)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (GlobalMemoryStatusEx(&status)) {
+    return qint64(status.ullTotalPhys);
+  }
+#elif defined(Q_OS_MAC)
+  int64_t mem = 0;
+  size_t len = sizeof(mem);
+  int mib[2] = {CTL_HW, HW_MEMSIZE};
+  if (sysctl(mib, 2, &mem, &len, nullptr, 0) == 0) {
+    return mem;
+  }
+#else
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long page_size = sysconf(_SC_PAGE_SIZE);
+  if (pages > 0 && page_size > 0) {
+    return qint64(pages) * page_size;
+  }
+#endif
+
+  // Fall back to something any machine that can run us will have
+  return qint64(4096) * 1024 * 1024;
+}
+
+}
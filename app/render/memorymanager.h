@@ -0,0 +1,148 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MEMORYMANAGER_H
+#define MEMORYMANAGER_H
+
+#include <atomic>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief Accounts for memory held by caches and asks them to trim when over a global budget
+ *
+ * Caches report what they hold with Allocated() and Released(). If the total goes over the budget
+ * set by the "MemoryBudget" config entry, registered clients are asked to trim, starting with the
+ * subsystem that's cheapest to rebuild, until usage is back under the budget.
+ */
+class MemoryManager : public QObject
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief Subsystems that hold memory, in the order they're trimmed under pressure
+   */
+  enum Subsystem {
+    kThumbnails,
+    kFramePool,
+    kTexturePool,
+    kDecoderFrames,
+    kWaveforms,
+    kAudioPrequeue,
+
+    kSubsystemCount
+  };
+
+  class Client
+  {
+  public:
+    virtual ~Client() = default;
+
+    /**
+     * @brief Free up to `bytes` of memory held by this client
+     *
+     * Called from the main thread, so implementations must be thread-safe. Clients that can only
+     * free memory in another thread may do so later, but should still return what they'll free so
+     * more expensive subsystems aren't trimmed in the meantime.
+     *
+     * @return The number of bytes freed, or that will be freed shortly
+     */
+    virtual qint64 TrimMemory(qint64 bytes) = 0;
+  };
+
+  static void CreateInstance();
+
+  static void DestroyInstance();
+
+  static MemoryManager* instance();
+
+  /**
+   * @brief Report memory held by a subsystem
+   *
+   * Thread-safe and cheap enough to call on every allocation. Works without an instance, in which
+   * case nothing is ever trimmed.
+   */
+  static void Allocated(Subsystem s, qint64 bytes);
+
+  static void Released(Subsystem s, qint64 bytes);
+
+  static qint64 GetUsage(Subsystem s)
+  {
+    return usage_[s].load(std::memory_order_relaxed);
+  }
+
+  static qint64 GetTotalUsage();
+
+  static QString GetSubsystemName(Subsystem s);
+
+  /**
+   * @brief Current budget in bytes
+   *
+   * Either the "MemoryBudget" config entry in MiB or, if that's 0, half of physical memory.
+   */
+  qint64 GetBudget() const
+  {
+    return budget_;
+  }
+
+  /**
+   * @brief Re-read the budget from the config
+   */
+  void UpdateBudget();
+
+  void RegisterClient(Subsystem s, Client *client);
+
+  void UnregisterClient(Client *client);
+
+public slots:
+  /**
+   * @brief Ask clients to trim until usage is under the budget
+   *
+   * Called automatically when an allocation goes over the budget.
+   */
+  void Trim();
+
+private:
+  MemoryManager();
+
+  static qint64 GetPhysicalMemory();
+
+  static MemoryManager* instance_;
+
+  static std::atomic<qint64> usage_[kSubsystemCount];
+
+  std::atomic<qint64> budget_;
+
+  std::atomic_bool trim_queued_;
+
+  bool over_budget_warned_;
+
+  QMutex clients_lock_;
+
+  QVector< QVector<Client*> > clients_;
+
+};
+
+}
+
+#endif // MEMORYMANAGER_H
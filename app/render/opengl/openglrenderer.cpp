@@ -20,17 +20,38 @@
 
 #include "openglrenderer.h"
 
+#include <cmath>
 #include <iostream>
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
 #include <QOpenGLExtraFunctions>
+#include <QSaveFile>
 
 #include "config/config.h"
+#include "render/rendertrace.h"
 
 namespace olive {
 
 const int OpenGLRenderer::kTextureCacheMaxSize = 5000;
 
+QHash<OpenGLRenderer::ProgramLayoutKey, OpenGLRenderer::ProgramLayout> OpenGLRenderer::program_layouts_;
+QMutex OpenGLRenderer::program_layouts_lock_;
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
 const QVector<GLfloat> blit_vertices = {
   -1.0f, -1.0f, 0.0f,
   1.0f, -1.0f, 0.0f,
@@ -87,7 +108,8 @@ private:
 OpenGLRenderer::OpenGLRenderer(QObject* parent) :
   Renderer(parent),
   context_(nullptr),
-  framebuffer_(0)
+  framebuffer_(0),
+  program_binaries_supported_(false)
 {
 }
 
@@ -155,6 +177,21 @@ void OpenGLRenderer::PostInit()
 
   // Set up framebuffer used for various things
   functions_->glGenFramebuffers(1, &framebuffer_);
+
+  // Linked programs can be cached on disk if the driver can give them back to us
+  if (context_->format().version() >= qMakePair(4, 1)
+      || context_->hasExtension(QByteArrayLiteral("GL_ARB_get_program_binary"))) {
+    GLint binary_formats = 0;
+    functions_->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+    program_binaries_supported_ = (binary_formats > 0)
+        && QDir().mkpath(GetShaderCacheDirectory());
+  }
+
+  driver_identity_.append(reinterpret_cast<const char*>(functions_->glGetString(GL_VENDOR)));
+  driver_identity_.append('\n');
+  driver_identity_.append(reinterpret_cast<const char*>(functions_->glGetString(GL_RENDERER)));
+  driver_identity_.append('\n');
+  driver_identity_.append(reinterpret_cast<const char*>(functions_->glGetString(GL_VERSION)));
 }
 
 void OpenGLRenderer::DestroyInternal()
@@ -253,12 +290,92 @@ void OpenGLRenderer::DestroyNativeTexture(QVariant texture)
   }
 }
 
+void OpenGLRenderer::DestroyNativePixelBuffer(QVariant buffer)
+{
+  GLuint b = buffer.value<GLuint>();
+
+  if (b > 0) {
+    functions_->glDeleteBuffers(1, &b);
+  }
+}
+
+QVariant OpenGLRenderer::CreateNativeFence()
+{
+  GL_PREAMBLE;
+
+  GLsync sync = context_->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  return QVariant::fromValue(static_cast<void*>(sync));
+}
+
+QVariant OpenGLRenderer::CreateNativeFenceForCurrentThread()
+{
+  GL_PREAMBLE;
+
+  // Sync objects are shared between contexts in a share group, so a fence made in the releasing
+  // thread's context can be polled from ours later
+  QOpenGLContext *ctx = QOpenGLContext::currentContext();
+  if (!ctx) {
+    // No context means this thread can't have GL commands using the texture in flight
+    return QVariant();
+  }
+
+  GLsync sync = ctx->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  // Our polls only flush our own context, so make sure this one reaches the GPU or it may never
+  // be signaled
+  ctx->functions()->glFlush();
+
+  return QVariant::fromValue(static_cast<void*>(sync));
+}
+
+bool OpenGLRenderer::IsNativeFenceSignaled(const QVariant &fence)
+{
+  GL_PREAMBLE;
+
+  GLsync sync = static_cast<GLsync>(fence.value<void*>());
+
+  if (!sync) {
+    return true;
+  }
+
+  // Zero timeout makes this a poll. Flushing ensures the fence eventually gets signaled even if
+  // nothing else flushes this context.
+  GLenum r = context_->extraFunctions()->glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+  return r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED;
+}
+
+void OpenGLRenderer::DestroyNativeFence(QVariant fence)
+{
+  GL_PREAMBLE;
+
+  GLsync sync = static_cast<GLsync>(fence.value<void*>());
+
+  if (sync) {
+    context_->extraFunctions()->glDeleteSync(sync);
+  }
+}
+
 QVariant OpenGLRenderer::CreateNativeShader(ShaderCode code)
 {
   GL_PREAMBLE;
 
   PRINT_GL_ERRORS;
 
+  QString binary_filename;
+  if (program_binaries_supported_) {
+    binary_filename = GetProgramBinaryFilename(code);
+
+    GLuint program = LoadProgramBinary(binary_filename);
+    if (program) {
+      ProgramLayout layout = ReflectProgram(program);
+      QMutexLocker locker(&program_layouts_lock_);
+      program_layouts_.insert({context_->shareGroup(), program}, layout);
+      return program;
+    }
+  }
+
   GLuint vert = CompileShader(GL_VERTEX_SHADER, code.vert_code());
   GLuint frag = CompileShader(GL_FRAGMENT_SHADER, code.frag_code());
 
@@ -268,6 +385,11 @@ QVariant OpenGLRenderer::CreateNativeShader(ShaderCode code)
     program = functions_->glCreateProgram();
     functions_->glAttachShader(program, frag);
     functions_->glAttachShader(program, vert);
+
+    if (program_binaries_supported_) {
+      context_->extraFunctions()->glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     functions_->glLinkProgram(program);
 
     GLint success;
@@ -276,6 +398,15 @@ QVariant OpenGLRenderer::CreateNativeShader(ShaderCode code)
       qWarning() << "Failed to link OpenGL shader program";
       functions_->glDeleteProgram(program);
       program = 0;
+    } else {
+      ProgramLayout layout = ReflectProgram(program);
+      program_layouts_lock_.lock();
+      program_layouts_.insert({context_->shareGroup(), program}, layout);
+      program_layouts_lock_.unlock();
+
+      if (program_binaries_supported_) {
+        SaveProgramBinary(program, binary_filename);
+      }
     }
   }
 
@@ -285,18 +416,91 @@ QVariant OpenGLRenderer::CreateNativeShader(ShaderCode code)
   return program;
 }
 
+QString OpenGLRenderer::GetProgramBinaryFilename(const ShaderCode &code) const
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  hash.addData(driver_identity_);
+  hash.addData(code.vert_code().toUtf8());
+  hash.addData(code.frag_code().toUtf8());
+
+  return QDir(GetShaderCacheDirectory()).filePath(QStringLiteral("%1.bin").arg(QString::fromLatin1(hash.result().toHex())));
+}
+
+GLuint OpenGLRenderer::LoadProgramBinary(const QString &filename)
+{
+  QFile f(filename);
+  if (!f.open(QFile::ReadOnly)) {
+    return 0;
+  }
+
+  // First four bytes are the driver-specific format, the rest is the binary itself
+  QByteArray data = f.readAll();
+  f.close();
+
+  if (data.size() <= int(sizeof(GLenum))) {
+    return 0;
+  }
+
+  GLenum format;
+  memcpy(&format, data.constData(), sizeof(GLenum));
+
+  GLuint program = functions_->glCreateProgram();
+  context_->extraFunctions()->glProgramBinary(program, format, data.constData() + sizeof(GLenum), data.size() - sizeof(GLenum));
+
+  GLint success;
+  functions_->glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    // Drivers may reject binaries after an update even if they report the same version, in which
+    // case we'll just compile from source and replace it
+    functions_->glDeleteProgram(program);
+    QFile::remove(filename);
+    return 0;
+  }
+
+  return program;
+}
+
+void OpenGLRenderer::SaveProgramBinary(GLuint program, const QString &filename)
+{
+  GLint length = 0;
+  functions_->glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  QByteArray data(int(sizeof(GLenum)) + length, Qt::Uninitialized);
+
+  GLenum format;
+  context_->extraFunctions()->glGetProgramBinary(program, length, nullptr, &format, data.data() + sizeof(GLenum));
+  memcpy(data.data(), &format, sizeof(GLenum));
+
+  // Write atomically so another instance never loads a partial binary
+  QSaveFile f(filename);
+  if (f.open(QFile::WriteOnly)) {
+    f.write(data);
+    f.commit();
+  }
+}
+
 void OpenGLRenderer::DestroyNativeShader(QVariant shader)
 {
   GL_PREAMBLE;
 
   GLuint program = shader.value<GLuint>();
+
+  // Hold the lock across both so no renderer can reuse the name and cache its layout in between
+  QMutexLocker locker(&program_layouts_lock_);
   functions_->glDeleteProgram(program);
+  program_layouts_.remove({context_->shareGroup(), program});
 }
 
 void OpenGLRenderer::UploadToTexture(const QVariant &handle, const VideoParams &p, const void *data, int linesize)
 {
   GL_PREAMBLE;
 
+  RenderTraceSpan span("Upload", "Upload Texture");
+
   GLuint t = handle.value<GLuint>();
 
   bool is_3d = p.is_3d();
@@ -333,10 +537,66 @@ void OpenGLRenderer::UploadToTexture(const QVariant &handle, const VideoParams &
   functions_->glBindTexture(tex_type, current_tex);
 }
 
+QVariant OpenGLRenderer::CreateNativePixelBuffer(int size)
+{
+  GL_PREAMBLE;
+
+  GLuint buffer;
+  functions_->glGenBuffers(1, &buffer);
+
+  functions_->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+  functions_->glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  functions_->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  return buffer;
+}
+
+void OpenGLRenderer::UploadToTextureFromPixelBuffer(const QVariant &handle, const VideoParams &p, const QVariant &buffer, int buffer_size, const void *data, int linesize)
+{
+  GL_PREAMBLE;
+
+  RenderTraceSpan span("Upload", "Upload Texture From Pixel Buffer");
+
+  GLuint b = buffer.value<GLuint>();
+
+  int bpp = p.GetBytesPerPixel();
+  int data_size = linesize * bpp * (p.effective_height() - 1) + p.effective_width() * bpp;
+
+  if (!b || data_size > buffer_size) {
+    UploadToTexture(handle, p, data, linesize);
+    return;
+  }
+
+  functions_->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, b);
+
+  // Orphan the buffer's previous storage so that mapping never waits for a transfer that may still
+  // be in flight from the last time this buffer was used
+  functions_->glBufferData(GL_PIXEL_UNPACK_BUFFER, buffer_size, nullptr, GL_STREAM_DRAW);
+
+  QOpenGLExtraFunctions *xf = context_->extraFunctions();
+  void *mapped = xf->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, data_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+  if (mapped) {
+    memcpy(mapped, data, data_size);
+    xf->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // With an unpack buffer bound, a null pointer is an offset into the buffer
+    UploadToTexture(handle, p, nullptr, linesize);
+
+    functions_->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  } else {
+    functions_->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    UploadToTexture(handle, p, data, linesize);
+  }
+}
+
 void OpenGLRenderer::DownloadFromTexture(const QVariant &id, const VideoParams &p, void *data, int linesize)
 {
   GL_PREAMBLE;
 
+  RenderTraceSpan span("Readback", "Download Texture");
+
   GLint current_tex;
   functions_->glGetIntegerv(GL_TEXTURE_BINDING_2D, &current_tex);
 
@@ -402,17 +662,24 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
 {
   GL_PREAMBLE;
 
+  RenderTraceSpan span("Shader", "Blit");
+  if (span.IsRecording() && !job.GetShaderID().isEmpty()) {
+    span.SetName(job.GetShaderID());
+  }
+
   // If this node is iterative, we'll pick up which input here
-  QMap<QString, GLuint> texture_index_map;
+  int iterative_texture_index = 0;
   QVector<TextureToBind> textures_to_bind;
 
   GLuint shader = s.value<GLuint>();
 
+  ProgramLayout layout = GetProgramLayout(shader);
+
   functions_->glUseProgram(shader);
 
   for (auto it=job.GetValues().constBegin(); it!=job.GetValues().constEnd(); it++) {
     // See if the shader has takes this parameter as an input
-    GLint variable_location = functions_->glGetUniformLocation(shader, it.key().toUtf8().constData());
+    GLint variable_location = layout.uniforms.value(it.key(), -1);
 
     if (variable_location == -1) {
       continue;
@@ -476,13 +743,15 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
       // Set value to bound texture
       functions_->glUniform1i(variable_location, textures_to_bind.size());
 
-      texture_index_map.insert(it.key(), textures_to_bind.size());
+      if (it.key() == job.GetIterativeInput()) {
+        iterative_texture_index = textures_to_bind.size();
+      }
 
       textures_to_bind.append({texture, job.GetInterpolation(it.key())});
 
       // Set enable flag if shader wants it
       GLuint tex_id = texture ? texture->id().value<GLuint>() : 0;
-      int enable_param_location = functions_->glGetUniformLocation(shader, QStringLiteral("%1_enabled").arg(it.key()).toUtf8().constData());
+      GLint enable_param_location = layout.texture_enabled.value(it.key(), -1);
       if (enable_param_location > -1) {
         functions_->glUniform1i(enable_param_location, tex_id > 0);
       }
@@ -529,9 +798,8 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
   }
 
   // Ensure matrix is set, at least to identity
-  GLint mvpmat_location = functions_->glGetUniformLocation(shader, "ove_mvpmat");
-  if (mvpmat_location > -1) {
-    functions_->glUniformMatrix4fv(mvpmat_location, 1, false, job.Get(QStringLiteral("ove_mvpmat")).toMatrix().constData());
+  if (layout.mvpmat > -1) {
+    functions_->glUniformMatrix4fv(layout.mvpmat, 1, false, job.Get(QStringLiteral("ove_mvpmat")).toMatrix().constData());
   }
 
   // Set the viewport to the "physical" resolution of the destination
@@ -539,6 +807,23 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
                          destination_params.effective_width(),
                          destination_params.effective_height());
 
+  // Only shade the region of the destination that's going to be used
+  bool use_scissor = false;
+  const QRectF &roi = job.GetRegionOfInterest();
+  if (destination && !roi.isNull() && !roi.contains(QRectF(0, 0, 1, 1))) {
+    // Pad by a couple of pixels so filtered samples at the edge of the region stay valid
+    const int padding = 2;
+    int w = destination_params.effective_width();
+    int h = destination_params.effective_height();
+    int x1 = qBound(0, int(std::floor(roi.left() * w)) - padding, w);
+    int y1 = qBound(0, int(std::floor(roi.top() * h)) - padding, h);
+    int x2 = qBound(0, int(std::ceil(roi.right() * w)) + padding, w);
+    int y2 = qBound(0, int(std::ceil(roi.bottom() * h)) + padding, h);
+
+    functions_->glScissor(x1, y1, x2 - x1, y2 - y1);
+    use_scissor = true;
+  }
+
   // Bind vertex array object
   QOpenGLVertexArrayObject vao_;
   vao_.create();
@@ -563,19 +848,17 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
   frag_vbo_.allocate(blit_texcoords.constData(), blit_texcoords.size() * sizeof(GLfloat));
   frag_vbo_.release();
 
-  GLint vertex_location = functions_->glGetAttribLocation(shader, "a_position");
-  if (vertex_location != -1) {
+  if (layout.position != -1) {
     vert_vbo_.bind();
-    functions_->glEnableVertexAttribArray(vertex_location);
-    functions_->glVertexAttribPointer(vertex_location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    functions_->glEnableVertexAttribArray(layout.position);
+    functions_->glVertexAttribPointer(layout.position, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
     vert_vbo_.release();
   }
 
-  GLint tex_location = functions_->glGetAttribLocation(shader, "a_texcoord");
-  if (tex_location != -1) {
+  if (layout.texcoord != -1) {
     frag_vbo_.bind();
-    functions_->glEnableVertexAttribArray(tex_location);
-    functions_->glVertexAttribPointer(tex_location, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    functions_->glEnableVertexAttribArray(layout.texcoord);
+    functions_->glVertexAttribPointer(layout.texcoord, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
     frag_vbo_.release();
   }
 
@@ -603,11 +886,10 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
     }
   }
 
-  GLint iteration_location = functions_->glGetUniformLocation(shader, "ove_iteration");
   for (int iteration=0; iteration<real_iteration_count; iteration++) {
     // Set iteration number
-    if (iteration_location > -1) {
-      functions_->glUniform1i(iteration_location, iteration);
+    if (layout.iteration > -1) {
+      functions_->glUniform1i(layout.iteration, iteration);
     }
 
     // Replace iterative input
@@ -621,20 +903,29 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
         DetachTextureAsDestination();
       }
 
-      // Clear the destination if the caller requested it
+      // Clear the destination if the caller requested it, including outside the region of
+      // interest so nothing stale is left there
       if (clear_destination) {
         ClearDestinationInternal();
       }
+
+      if (use_scissor) {
+        functions_->glEnable(GL_SCISSOR_TEST);
+      }
     } else {
       // Always draw to output_tex, which gets swapped with input_tex every iteration
       AttachTextureAsDestination(output_tex->id());
+
+      if (use_scissor) {
+        functions_->glEnable(GL_SCISSOR_TEST);
+      }
     }
 
     if (iteration > 0) {
       // If this is not the first iteration, replace the iterative texture with the one we
       // last drew
       const QString &iterative_input = job.GetIterativeInput();
-      functions_->glActiveTexture(GL_TEXTURE0 + texture_index_map.value(iterative_input));
+      functions_->glActiveTexture(GL_TEXTURE0 + iterative_texture_index);
       functions_->glBindTexture(GL_TEXTURE_2D, input_tex->id().value<GLuint>());
 
       // At this time, we only support iterating 2D textures
@@ -649,6 +940,10 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
       PRINT_GL_ERRORS;
       functions_->glDrawArrays(GL_TRIANGLES, 0, blit_vertices.size() / 3);
     }
+
+    if (use_scissor) {
+      functions_->glDisable(GL_SCISSOR_TEST);
+    }
   }
 
   if (destination) {
@@ -674,6 +969,69 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
   vao_.destroy();
 }
 
+OpenGLRenderer::ProgramLayout OpenGLRenderer::ReflectProgram(GLuint program)
+{
+  ProgramLayout layout;
+
+  GLint uniform_count = 0;
+  GLint max_name_length = 0;
+  functions_->glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+  functions_->glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+  QByteArray name_buffer(qMax(max_name_length, 1), Qt::Uninitialized);
+
+  for (GLint i=0; i<uniform_count; i++) {
+    GLsizei name_length = 0;
+    GLint size;
+    GLenum type;
+    functions_->glGetActiveUniform(program, i, name_buffer.size(), &name_length, &size, &type, name_buffer.data());
+
+    GLint location = functions_->glGetUniformLocation(program, name_buffer.constData());
+    if (location == -1) {
+      // Uniform block members don't have a location
+      continue;
+    }
+
+    QString name = QString::fromUtf8(name_buffer.constData(), name_length);
+
+    // Arrays are reported by their first element
+    if (name.endsWith(QStringLiteral("[0]"))) {
+      name.chop(3);
+    }
+
+    layout.uniforms.insert(name, location);
+  }
+
+  static const QString enabled_suffix = QStringLiteral("_enabled");
+  for (auto it=layout.uniforms.cbegin(); it!=layout.uniforms.cend(); it++) {
+    if (it.key().endsWith(enabled_suffix)) {
+      layout.texture_enabled.insert(it.key().left(it.key().size() - enabled_suffix.size()), it.value());
+    }
+  }
+
+  layout.mvpmat = layout.uniforms.value(QStringLiteral("ove_mvpmat"), -1);
+  layout.iteration = layout.uniforms.value(QStringLiteral("ove_iteration"), -1);
+  layout.position = functions_->glGetAttribLocation(program, "a_position");
+  layout.texcoord = functions_->glGetAttribLocation(program, "a_texcoord");
+
+  return layout;
+}
+
+OpenGLRenderer::ProgramLayout OpenGLRenderer::GetProgramLayout(GLuint program)
+{
+  QMutexLocker locker(&program_layouts_lock_);
+
+  ProgramLayoutKey key(context_->shareGroup(), program);
+  auto it = program_layouts_.find(key);
+
+  if (it == program_layouts_.end()) {
+    // Shouldn't normally happen since programs are reflected when linked, but it's cheap to cover
+    it = program_layouts_.insert(key, ReflectProgram(program));
+  }
+
+  return it.value();
+}
+
 GLint OpenGLRenderer::GetInternalFormat(PixelFormat format, int channel_layout)
 {
   switch (format) {
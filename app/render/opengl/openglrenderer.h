@@ -21,8 +21,10 @@
 #ifndef OPENGLCONTEXT_H
 #define OPENGLCONTEXT_H
 
+#include <QMutex>
 #include <QOffscreenSurface>
 #include <QOpenGLBuffer>
+#include <QOpenGLContext>
 #include <QOpenGLFunctions>
 #include <QOpenGLShader>
 #include <QOpenGLVertexArrayObject>
@@ -59,6 +61,10 @@ public:
 
   virtual void DownloadFromTexture(const QVariant &handle, const VideoParams &params, void* data, int linesize) override;
 
+  virtual QVariant CreateNativePixelBuffer(int size) override;
+
+  virtual void UploadToTextureFromPixelBuffer(const QVariant &handle, const VideoParams &params, const QVariant &buffer, int buffer_size, const void* data, int linesize) override;
+
   virtual void Flush() override;
 
   virtual Color GetPixelFromTexture(olive::Texture *texture, const QPointF &pt) override;
@@ -74,6 +80,16 @@ protected:
 
   virtual void DestroyNativeTexture(QVariant texture) override;
 
+  virtual void DestroyNativePixelBuffer(QVariant buffer) override;
+
+  virtual QVariant CreateNativeFence() override;
+
+  virtual QVariant CreateNativeFenceForCurrentThread() override;
+
+  virtual bool IsNativeFenceSignaled(const QVariant &fence) override;
+
+  virtual void DestroyNativeFence(QVariant fence) override;
+
   virtual void DestroyInternal() override;
 
 private:
@@ -93,6 +109,40 @@ private:
 
   GLuint CompileShader(GLenum type, const QString &code);
 
+  /**
+   * @brief Filename a linked program for this code would be stored under in the binary cache
+   *
+   * Includes the driver identity so binaries are never loaded by a driver that didn't create them.
+   */
+  QString GetProgramBinaryFilename(const ShaderCode &code) const;
+
+  GLuint LoadProgramBinary(const QString &filename);
+
+  void SaveProgramBinary(GLuint program, const QString &filename);
+
+  /**
+   * @brief Locations of a linked program's active uniforms and attributes
+   *
+   * Reflected once when the program is linked so that Blit() can map ShaderJob values to
+   * locations without querying the driver (and converting names) on every draw.
+   */
+  struct ProgramLayout
+  {
+    QHash<QString, GLint> uniforms;
+
+    // Location of "<input>_enabled" flags, keyed by <input>
+    QHash<QString, GLint> texture_enabled;
+
+    GLint mvpmat = -1;
+    GLint iteration = -1;
+    GLint position = -1;
+    GLint texcoord = -1;
+  };
+
+  ProgramLayout ReflectProgram(GLuint program);
+
+  ProgramLayout GetProgramLayout(GLuint program);
+
   QOpenGLContext* context_;
 
   QOpenGLFunctions* functions_;
@@ -117,6 +167,17 @@ private:
 
   QMap<GLuint, TextureCacheKey> texture_params_;
 
+  // Program names are shared by every context in a share group, so a name one renderer deleted
+  // can be reused by another. Layouts are therefore shared per share group too, so deleting a
+  // program removes its layout everywhere before the name can come back.
+  using ProgramLayoutKey = QPair<QOpenGLContextGroup*, GLuint>;
+  static QHash<ProgramLayoutKey, ProgramLayout> program_layouts_;
+  static QMutex program_layouts_lock_;
+
+  bool program_binaries_supported_;
+
+  QByteArray driver_identity_;
+
   static const int kTextureCacheMaxSize;
 
 };
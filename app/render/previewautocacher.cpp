@@ -21,14 +21,17 @@
 #include "previewautocacher.h"
 
 #include <QApplication>
+#include <QPointer>
 #include <QtConcurrent/QtConcurrent>
 
 #include "codec/conformmanager.h"
 #include "node/input/multicam/multicamnode.h"
 #include "node/inputdragger.h"
 #include "node/project.h"
+#include "node/project/footage/footage.h"
 #include "render/diskmanager.h"
 #include "render/rendermanager.h"
+#include "render/thumbnailservice.h"
 
 namespace olive {
 
@@ -43,9 +46,7 @@ PreviewAutoCacher::PreviewAutoCacher(QObject *parent) :
   multicam_(nullptr),
   ignore_cache_requests_(false)
 {
-  copier_ = new ProjectCopier(this);
-  connect(copier_, &ProjectCopier::AddedNode, this, &PreviewAutoCacher::ConnectToNodeCache);
-  connect(copier_, &ProjectCopier::RemovedNode, this, &PreviewAutoCacher::DisconnectFromNodeCache);
+  copier_ = CreateCopier();
 
   // Set defaults
   SetPlayhead(0);
@@ -65,12 +66,12 @@ PreviewAutoCacher::~PreviewAutoCacher()
   SetProject(nullptr);
 }
 
-RenderTicketPtr PreviewAutoCacher::GetSingleFrame(ViewerOutput *viewer, const rational &t, bool dry)
+RenderTicketPtr PreviewAutoCacher::GetSingleFrame(ViewerOutput *viewer, const rational &t, bool dry, const QRectF &roi, int divider)
 {
-  return GetSingleFrame(viewer->GetConnectedTextureOutput(), viewer, t, dry);
+  return GetSingleFrame(viewer->GetConnectedTextureOutput(), viewer, t, dry, roi, divider);
 }
 
-RenderTicketPtr PreviewAutoCacher::GetSingleFrame(Node *n, ViewerOutput *viewer, const rational &t, bool dry)
+RenderTicketPtr PreviewAutoCacher::GetSingleFrame(Node *n, ViewerOutput *viewer, const rational &t, bool dry, const QRectF &roi, int divider)
 {
   // If we have a single frame render queued (but not yet sent to the RenderManager), cancel it now
   CancelQueuedSingleFrameRender();
@@ -82,6 +83,8 @@ RenderTicketPtr PreviewAutoCacher::GetSingleFrame(Node *n, ViewerOutput *viewer,
   sfr->setProperty("dry", dry);
   sfr->setProperty("node", QtUtils::PtrToValue(n));
   sfr->setProperty("viewer", QtUtils::PtrToValue(viewer));
+  sfr->setProperty("roi", roi);
+  sfr->setProperty("divider", divider);
 
   // Queue it and try to render
   single_frame_render_ = sfr;
@@ -150,6 +153,8 @@ void PreviewAutoCacher::CancelForCache()
         it++;
       }
     }
+
+    CancelKeyframeThumbnails(cache);
   } else if (dynamic_cast<AudioPlaybackCache*>(cache) || dynamic_cast<AudioWaveformCache*>(cache)) {
     for (auto it=pending_audio_jobs_.begin(); it!=pending_audio_jobs_.end(); ) {
       if ((*it).cache == cache) {
@@ -169,9 +174,11 @@ void PreviewAutoCacher::AudioRendered()
   // If the task list doesn't contain this watcher, presumably it was cleared as a result of a
   // viewer switch, so we'll completely ignore this watcher
   if (running_audio_tasks_.removeOne(watcher)) {
+    ProjectCopier *snapshot = UnpinSnapshot(watcher);
+
     // Assume that a "result" is a fully completed image and a non-result is a cancelled ticket
     TimeRange range = watcher->property("time").value<TimeRange>();
-    Node *node = copier_->GetOriginal(QtUtils::ValueToPtr<Node>(watcher->property("node")));
+    Node *node = snapshot->GetOriginal(QtUtils::ValueToPtr<Node>(watcher->property("node")));
 
     if (watcher->HasResult() && node) {
       if (PlaybackCache *cache = QtUtils::ValueToPtr<PlaybackCache>(watcher->property("cache"))) {
@@ -236,6 +243,7 @@ void PreviewAutoCacher::VideoRendered()
   foreach (RenderTicketPtr t, tickets) {
     if (watcher->HasResult()) {
       t->setProperty("multicam_output", watcher->GetTicket()->property("multicam_output"));
+      t->setProperty("rendertime", watcher->GetTicket()->property("rendertime"));
       t->Finish(watcher->Get());
     } else {
       t->Finish();
@@ -245,6 +253,8 @@ void PreviewAutoCacher::VideoRendered()
   // If the task list doesn't contain this watcher, presumably it was cleared as a result of a
   // viewer switch, so we'll completely ignore this watcher
   if (running_video_tasks_.removeOne(watcher)) {
+    UnpinSnapshot(watcher);
+
     // Assume that a "result" is a fully completed image and a non-result is a cancelled ticket
     if (watcher->HasResult()) {
       if (watcher->GetTicket()->property("cached").toBool()) {
@@ -272,6 +282,13 @@ void PreviewAutoCacher::ConnectToNodeCache(Node *node)
     return;
   }
 
+  // Every copy of the graph reports the same nodes, only connect the first time
+  if (connected_caches_.contains(node)) {
+    return;
+  }
+
+  connected_caches_.insert(node);
+
   connect(node->video_frame_cache(),
           &PlaybackCache::Requested,
           this,
@@ -310,6 +327,10 @@ void PreviewAutoCacher::ConnectToNodeCache(Node *node)
 
 void PreviewAutoCacher::DisconnectFromNodeCache(Node *node)
 {
+  if (!connected_caches_.remove(node)) {
+    return;
+  }
+
   disconnect(node->video_frame_cache(),
              &PlaybackCache::Requested,
              this,
@@ -482,17 +503,9 @@ void PreviewAutoCacher::TryRender()
 {
   delayed_requeue_timer_.stop();
 
-  if (copier_->HasUpdatesInQueue()) {
-    // Check if we have jobs running in other threads that shouldn't be interrupted right now
-    // NOTE: We don't check for downloads because, while they run in another thread, they don't
-    //       require any access to the graph and therefore don't risk race conditions.
-    if (!running_audio_tasks_.isEmpty()
-        || !running_video_tasks_.isEmpty()) {
-      return;
-    }
-
-    // No jobs are active, we can process the update queue
-    copier_->ProcessUpdateQueue();
+  if (!PublishGraphChanges()) {
+    // Every copy of the graph is being read by a running job, wait for one to finish
+    return;
   }
 
   if (single_frame_render_) {
@@ -510,7 +523,9 @@ void PreviewAutoCacher::TryRender()
                                                  QtUtils::ValueToPtr<ViewerOutput>(t->property("viewer")),
                                                  t->property("time").value<rational>(),
                                                  nullptr,
-                                                 t->property("dry").toBool());
+                                                 t->property("dry").toBool(),
+                                                 t->property("roi").toRectF(),
+                                                 t->property("divider").toInt());
       video_immediate_passthroughs_[watcher].append(t);
     } else {
       qWarning() << "Failed to find copied node for SFR ticket";
@@ -527,6 +542,11 @@ void PreviewAutoCacher::TryRender()
       while (!pending_video_jobs_.empty()) {
         VideoJob &d = pending_video_jobs_.front();
 
+        if (StartKeyframeThumbnails(d)) {
+          pending_video_jobs_.pop_front();
+          continue;
+        }
+
         if (Node *copy = copier_->GetCopy(d.node)) {
           // Queue next frames
           rational t;
@@ -584,7 +604,211 @@ void PreviewAutoCacher::TryRender()
   }
 }
 
-RenderTicketWatcher* PreviewAutoCacher::RenderFrame(Node *node, ViewerOutput *context, const rational& time, PlaybackCache *cache, bool dry)
+bool PreviewAutoCacher::PublishGraphChanges()
+{
+  // NOTE: Downloads don't pin a copy because, while they run in another thread, they don't
+  //       require any access to the graph and therefore don't risk race conditions.
+  bool needs_publish = copier_->HasUpdatesInQueue();
+
+  if (needs_publish && snapshot_pins_.value(copier_) && copiers_.size() < kMaximumSnapshots) {
+    bool have_idle = false;
+    foreach (ProjectCopier *c, copiers_) {
+      if (!snapshot_pins_.value(c)) {
+        have_idle = true;
+        break;
+      }
+    }
+
+    if (!have_idle) {
+      // Copies are made from the current state of the project, so this starts up to date
+      CreateCopier()->SetProject(project_);
+    }
+  }
+
+  // Bring every idle copy up to date so none lags further behind than the renders using it. Each
+  // copy queues every change since it was last synced, so this catches it up completely.
+  ProjectCopier *up_to_date = nullptr;
+  foreach (ProjectCopier *c, copiers_) {
+    if (!snapshot_pins_.value(c)) {
+      if (c->HasUpdatesInQueue()) {
+        c->ProcessUpdateQueue();
+      }
+
+      if (!up_to_date || c == copier_) {
+        up_to_date = c;
+      }
+    }
+  }
+
+  if (needs_publish) {
+    if (!up_to_date) {
+      return false;
+    }
+
+    copier_ = up_to_date;
+    copied_color_manager_ = copier_->GetCopiedProject()->color_manager();
+  }
+
+  return true;
+}
+
+ProjectCopier *PreviewAutoCacher::CreateCopier()
+{
+  ProjectCopier *c = new ProjectCopier(this);
+  connect(c, &ProjectCopier::AddedNode, this, &PreviewAutoCacher::ConnectToNodeCache);
+  connect(c, &ProjectCopier::RemovedNode, this, &PreviewAutoCacher::DisconnectFromNodeCache);
+  copiers_.append(c);
+  return c;
+}
+
+void PreviewAutoCacher::PinSnapshot(RenderTicketWatcher *watcher)
+{
+  watcher->setProperty("snapshot", QtUtils::PtrToValue(copier_));
+  snapshot_pins_[copier_]++;
+}
+
+ProjectCopier *PreviewAutoCacher::UnpinSnapshot(RenderTicketWatcher *watcher)
+{
+  ProjectCopier *snapshot = QtUtils::ValueToPtr<ProjectCopier>(watcher->property("snapshot"));
+  snapshot_pins_[snapshot]--;
+  return snapshot;
+}
+
+bool PreviewAutoCacher::StartKeyframeThumbnails(const VideoJob &job)
+{
+  ThumbnailCache *cache = dynamic_cast<ThumbnailCache*>(job.cache);
+  Footage *footage = dynamic_cast<Footage*>(job.node);
+  if (!cache || !footage || !footage->IsValid()) {
+    return false;
+  }
+
+  // Stills are only decoded once by the renderer anyway
+  VideoParams vp = footage->GetFirstEnabledVideoStream();
+  if (!vp.is_valid() || vp.video_type() != VideoParams::kVideoTypeVideo) {
+    return false;
+  }
+
+  QString filename = footage->filename();
+  QString failure_key = QStringLiteral("%1:%2").arg(filename, QString::number(vp.stream_index()));
+  if (keyframe_thumbnail_failures_.contains(failure_key)) {
+    return false;
+  }
+
+  QVector<rational> times;
+  TimeRangeListFrameIterator iterator = job.iterator;
+  rational t;
+  while (iterator.GetNext(&t)) {
+    times.append(t);
+  }
+
+  if (times.isEmpty()) {
+    return true;
+  }
+
+  QString decoder_id = footage->decoder();
+  int stream_index = vp.stream_index();
+  QString cache_path = cache->GetCacheDirectory();
+  QUuid uuid = cache->GetUuid();
+  rational timebase = cache->GetTimebase();
+  JobTime job_time = copier_->GetLastUpdateTime();
+  QPointer<ThumbnailCache> cache_ptr(cache);
+  QPointer<ViewerOutput> context(job.context);
+  TimeRange range = job.range;
+
+  KeyframeThumbnailJob kj;
+  kj.cache = cache;
+  kj.cancelled = std::make_shared<CancelAtom>();
+  std::shared_ptr<CancelAtom> cancelled = kj.cancelled;
+
+  kj.future = QtConcurrent::run([=]{
+    DecoderPtr decoder = Decoder::CreateFromID(decoder_id);
+
+    // Times that got a thumbnail, in the same order as `times`
+    QVector<rational> received;
+
+    bool ok = decoder && decoder->ExtractThumbnails(filename, stream_index, times, QSize(160, 120), cancelled.get(), [=, &received](const rational &time, const QImage &image){
+      if (!FrameHashCache::SaveCacheImage(cache_path, uuid, Timecode::time_to_timestamp(time, timebase, Timecode::kRound), image)) {
+        return;
+      }
+
+      received.append(time);
+
+      QMetaObject::invokeMethod(this, [=]{
+        if (cache_ptr && video_cache_data_.value(cache_ptr.data()).job_tracker.isCurrent(time, job_time)) {
+          cache_ptr->ValidateTime(time);
+          ThumbnailService::instance()->Insert(cache_ptr, time, image);
+        }
+      }, Qt::QueuedConnection);
+    });
+
+    // The decoder can succeed overall and still skip some times (e.g. it stopped at a damaged
+    // keyframe), those still need rendering the regular way
+    TimeRangeList missing;
+    if (ok) {
+      int next_received = 0;
+      for (const rational &time : times) {
+        if (next_received < received.size() && received.at(next_received) == time) {
+          next_received++;
+        } else {
+          missing.insert(TimeRange(time, time + timebase));
+        }
+      }
+    }
+
+    QMetaObject::invokeMethod(this, [=]{
+      for (int i=0; i<keyframe_thumbnail_jobs_.size(); i++) {
+        if (keyframe_thumbnail_jobs_.at(i).cancelled == cancelled) {
+          keyframe_thumbnail_jobs_.removeAt(i);
+          break;
+        }
+      }
+
+      if (cancelled->IsCancelled()) {
+        return;
+      }
+
+      if (!ok) {
+        // Render this file's thumbnails the regular way from now on
+        keyframe_thumbnail_failures_.insert(failure_key);
+
+        if (context && cache_ptr) {
+          StartCachingVideoRange(context, cache_ptr.data(), range);
+        }
+      } else if (context && cache_ptr) {
+        foreach (const TimeRange &r, missing) {
+          StartCachingVideoRange(context, cache_ptr.data(), r);
+        }
+      }
+    }, Qt::QueuedConnection);
+  });
+
+  keyframe_thumbnail_jobs_.append(kj);
+
+  return true;
+}
+
+void PreviewAutoCacher::CancelKeyframeThumbnails(PlaybackCache *cache, bool and_wait)
+{
+  for (int i=0; i<keyframe_thumbnail_jobs_.size(); ) {
+    const KeyframeThumbnailJob &kj = keyframe_thumbnail_jobs_.at(i);
+
+    if (cache && kj.cache != cache) {
+      i++;
+      continue;
+    }
+
+    kj.cancelled->Cancel();
+
+    if (and_wait) {
+      kj.future.waitForFinished();
+      keyframe_thumbnail_jobs_.removeAt(i);
+    } else {
+      i++;
+    }
+  }
+}
+
+RenderTicketWatcher* PreviewAutoCacher::RenderFrame(Node *node, ViewerOutput *context, const rational& time, PlaybackCache *cache, bool dry, const QRectF &roi, int divider)
 {
   RenderTicketWatcher* watcher = new RenderTicketWatcher();
   watcher->setProperty("job", QVariant::fromValue(copier_->GetLastUpdateTime()));
@@ -593,6 +817,7 @@ RenderTicketWatcher* PreviewAutoCacher::RenderFrame(Node *node, ViewerOutput *co
   connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::VideoRendered);
 
   running_video_tasks_.append(watcher);
+  PinSnapshot(watcher);
 
   RenderManager::RenderVideoParams rvp(node,
                                        context->GetVideoParams(),
@@ -622,6 +847,15 @@ RenderTicketWatcher* PreviewAutoCacher::RenderFrame(Node *node, ViewerOutput *co
   // Multicam
   rvp.multicam = copier_->GetCopy(multicam_);
 
+  // Frames going to a cache must always be complete
+  if (!cache) {
+    rvp.region_of_interest = roi;
+
+    if (divider > 0) {
+      rvp.video_params.set_divider(divider);
+    }
+  }
+
   watcher->SetTicket(RenderManager::instance()->RenderFrame(rvp));
 
   return watcher;
@@ -636,6 +870,7 @@ RenderTicketPtr PreviewAutoCacher::RenderAudio(Node *node, ViewerOutput *context
   watcher->setProperty("time", QVariant::fromValue(r));
   connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::AudioRendered);
   running_audio_tasks_.append(watcher);
+  PinSnapshot(watcher);
 
   AudioParams p = context->GetAudioParams();
   p.set_format(ViewerOutput::kDefaultSampleFormat);
@@ -703,6 +938,9 @@ void PreviewAutoCacher::SetProject(Project *project)
       running_video_tasks_.clear();
     }
 
+    // Keyframe thumbnails don't use the copied graph, but they do write to its caches
+    CancelKeyframeThumbnails(nullptr, true);
+
     // Handle audio rendering tasks
     if (!running_audio_tasks_.isEmpty()) {
       // Cancel any audio tasks and wait for them to finish
@@ -717,13 +955,21 @@ void PreviewAutoCacher::SetProject(Project *project)
     video_immediate_passthroughs_.clear();
 
     // Disconnect from all node cache's
-    for (auto it=copier_->GetNodeMap().cbegin(); it!=copier_->GetNodeMap().cend(); it++) {
-      DisconnectFromNodeCache(it.key());
+    const QSet<Node*> connected = connected_caches_;
+    foreach (Node *n, connected) {
+      DisconnectFromNodeCache(n);
     }
 
-    // Delete all of our copied nodes
+    // Delete all of our copied nodes, keeping a single copier around for the next project
+    copier_ = copiers_.first();
     copier_->SetProject(nullptr);
 
+    while (copiers_.size() > 1) {
+      delete copiers_.takeLast();
+    }
+
+    snapshot_pins_.clear();
+
     // Ensure all cache data is cleared
     video_cache_data_.clear();
     audio_cache_data_.clear();
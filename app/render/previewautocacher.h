@@ -48,8 +48,8 @@ public:
 
   virtual ~PreviewAutoCacher() override;
 
-  RenderTicketPtr GetSingleFrame(ViewerOutput *viewer, const rational& t, bool dry = false);
-  RenderTicketPtr GetSingleFrame(Node *n, ViewerOutput *viewer, const rational& t, bool dry = false);
+  RenderTicketPtr GetSingleFrame(ViewerOutput *viewer, const rational& t, bool dry = false, const QRectF &roi = QRectF(), int divider = 0);
+  RenderTicketPtr GetSingleFrame(Node *n, ViewerOutput *viewer, const rational& t, bool dry = false, const QRectF &roi = QRectF(), int divider = 0);
 
   RenderTicketPtr GetRangeOfAudio(ViewerOutput *viewer, TimeRange range);
 
@@ -109,7 +109,21 @@ signals:
 private:
   void TryRender();
 
-  RenderTicketWatcher *RenderFrame(Node *node, ViewerOutput *context, const rational &time, PlaybackCache *cache, bool dry);
+  /**
+   * @brief Bring a copy of the graph up to date with queued changes and make it current
+   *
+   * Each running render pins the copy it was started with. If the current copy is pinned, the
+   * changes are applied to an idle copy instead so edits don't have to wait for renders to finish.
+   * Returns false if every copy is in use, in which case the changes stay queued.
+   */
+  bool PublishGraphChanges();
+
+  ProjectCopier *CreateCopier();
+
+  void PinSnapshot(RenderTicketWatcher *watcher);
+  ProjectCopier *UnpinSnapshot(RenderTicketWatcher *watcher);
+
+  RenderTicketWatcher *RenderFrame(Node *node, ViewerOutput *context, const rational &time, PlaybackCache *cache, bool dry, const QRectF &roi = QRectF(), int divider = 0);
 
   RenderTicketPtr RenderAudio(Node *node, ViewerOutput *context, const TimeRange &range, PlaybackCache *cache);
 
@@ -127,8 +141,15 @@ private:
 
   Project* project_;
 
+  // Copy of the graph that new renders use. Older copies may still be in use by running renders.
   ProjectCopier *copier_;
 
+  QVector<ProjectCopier*> copiers_;
+  QHash<ProjectCopier*, int> snapshot_pins_;
+  QSet<Node*> connected_caches_;
+
+  static const int kMaximumSnapshots = 2;
+
   TimeRange cache_range_;
 
   bool use_custom_range_;
@@ -173,9 +194,30 @@ private:
     TimeRangeList needs_conform;
   };
 
+  /**
+   * @brief Produce thumbnails for plain footage straight from its decoder's keyframes
+   *
+   * This skips the renderer entirely. Returns FALSE if the job's node isn't footage that can be
+   * handled this way, in which case it should be rendered normally.
+   */
+  bool StartKeyframeThumbnails(const VideoJob &job);
+
+  struct KeyframeThumbnailJob {
+    PlaybackCache *cache;
+    std::shared_ptr<CancelAtom> cancelled;
+    QFuture<void> future;
+  };
+
+  void CancelKeyframeThumbnails(PlaybackCache *cache = nullptr, bool and_wait = false);
+
   std::list<VideoJob> pending_video_jobs_;
   std::list<AudioJob> pending_audio_jobs_;
 
+  QVector<KeyframeThumbnailJob> keyframe_thumbnail_jobs_;
+
+  // Files whose decoder couldn't provide keyframe thumbnails, which are rendered normally instead
+  QSet<QString> keyframe_thumbnail_failures_;
+
   QHash<PlaybackCache*, VideoCacheData> video_cache_data_;
   QHash<PlaybackCache*, AudioCacheData> audio_cache_data_;
 
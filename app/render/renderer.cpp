@@ -21,15 +21,36 @@
 #include "renderer.h"
 
 #include <QDateTime>
+#include <QDir>
+#include <QStandardPaths>
 #include <QThread>
 #include <QTimer>
 #include <QVector2D>
 
+#include "config/config.h"
+#include "render/rendertrace.h"
+
 namespace olive {
 
 Renderer::Renderer(QObject *parent) :
-  QObject(parent)
+  QObject(parent),
+  texture_cache_bytes_(0),
+  texture_cache_count_(0),
+  texture_cache_hits_(0),
+  texture_cache_misses_(0),
+  texture_cache_trim_request_(0),
+  still_cache_bytes_(0)
 {
+  if (MemoryManager::instance()) {
+    MemoryManager::instance()->RegisterClient(MemoryManager::kTexturePool, this);
+  }
+}
+
+Renderer::~Renderer()
+{
+  if (MemoryManager::instance()) {
+    MemoryManager::instance()->UnregisterClient(this);
+  }
 }
 
 TexturePtr Renderer::CreateTexture(const VideoParams &params, const void *data, int linesize)
@@ -37,18 +58,41 @@ TexturePtr Renderer::CreateTexture(const VideoParams &params, const void *data,
   QVariant v;
 
   if (USE_TEXTURE_CACHE) {
+    bool in_renderer_thread = (QThread::currentThread() == this->thread());
+
     QMutexLocker locker(&texture_cache_lock_);
-    for (auto it=texture_cache_.begin(); it!=texture_cache_.end(); it++) {
-      if (it->width == params.effective_width()
-          && it->height == params.effective_height()
-          && it->depth == params.effective_depth()
-          && it->format == params.format()
-          && it->channel_count == params.channel_count()) {
-        v = it->handle;
-        texture_cache_.erase(it);
-        break;
+
+    auto bucket = texture_cache_.find(TextureKey::FromParams(params));
+    if (bucket != texture_cache_.end()) {
+      std::list<CachedTexture> &list = bucket.value();
+
+      for (auto it=list.begin(); it!=list.end(); it++) {
+        // Only hand out a texture again once the GPU is done with its last use. Fences can only be
+        // polled from our own thread.
+        if (it->fence.isNull() || (in_renderer_thread && IsNativeFenceSignaled(it->fence))) {
+          if (!it->fence.isNull()) {
+            DestroyNativeFence(it->fence);
+          }
+
+          v = it->handle;
+          texture_cache_bytes_ -= it->size;
+          texture_cache_count_--;
+          MemoryManager::Released(MemoryManager::kTexturePool, it->size);
+
+          list.erase(it);
+          if (list.empty()) {
+            texture_cache_.erase(bucket);
+          }
+          break;
+        }
       }
     }
+
+    if (v.isNull()) {
+      texture_cache_misses_++;
+    } else {
+      texture_cache_hits_++;
+    }
   }
 
   if (v.isNull()) {
@@ -56,8 +100,6 @@ TexturePtr Renderer::CreateTexture(const VideoParams &params, const void *data,
                             params.format(), params.channel_count(), data, linesize);
   } else if (data) {
     UploadToTexture(v, params, data, linesize);
-  } else {
-    this->Flush();
   }
 
   return CreateTextureFromNativeHandle(v, params);
@@ -81,17 +123,32 @@ void Renderer::DestroyTexture(Texture *texture)
     //
     //       Presumably Vulkan would not have this issue because it allows for application-wide
     //       instances and multithreading.
+    bool in_renderer_thread = (QThread::currentThread() == this->thread());
+
+    const VideoParams &p = texture->params();
+
+    CachedTexture ct;
+    ct.handle = texture->id();
+    ct.size = qint64(p.effective_width()) * p.effective_height() * p.effective_depth() * p.GetBytesPerPixel();
+    ct.accessed = QDateTime::currentMSecsSinceEpoch();
+
+    // The GPU may still be using the texture for commands from whichever thread released it, so
+    // it can't be handed out again until those are done
+    if (in_renderer_thread) {
+      ct.fence = CreateNativeFence();
+    } else {
+      ct.fence = CreateNativeFenceForCurrentThread();
+    }
+
     texture_cache_lock_.lock();
-    texture_cache_.push_back({texture->params().effective_width(),
-                              texture->params().effective_height(),
-                              texture->params().effective_depth(),
-                              texture->params().format(),
-                              texture->params().channel_count(),
-                              texture->id(),
-                              QDateTime::currentMSecsSinceEpoch()});
+    texture_cache_[TextureKey::FromParams(p)].push_back(ct);
+    texture_cache_bytes_ += ct.size;
+    texture_cache_count_++;
     texture_cache_lock_.unlock();
 
-    if (QThread::currentThread() == this->thread()) {
+    MemoryManager::Allocated(MemoryManager::kTexturePool, ct.size);
+
+    if (in_renderer_thread) {
       ClearOldTextures();
     }
   } else {
@@ -99,6 +156,18 @@ void Renderer::DestroyTexture(Texture *texture)
   }
 }
 
+void Renderer::DestroyPixelBuffer(const QVariant &buffer)
+{
+  if (QThread::currentThread() == this->thread()) {
+    DestroyNativePixelBuffer(buffer);
+  } else {
+    // See DestroyTexture() on why another thread may end up here, we can't destroy it from this
+    // thread so we queue it to be destroyed later
+    QMutexLocker locker(&texture_cache_lock_);
+    pixel_buffer_graveyard_.append(buffer);
+  }
+}
+
 TexturePtr Renderer::InterlaceTexture(TexturePtr top, TexturePtr bottom, const VideoParams &params)
 {
   color_cache_mutex_.lock();
@@ -132,6 +201,9 @@ QVariant Renderer::GetDefaultShader()
 
 void Renderer::Destroy()
 {
+  // Stills hold textures that must be returned to the pool before it's destroyed below
+  ClearCachedStills();
+
   if (!default_shader_.isNull()) {
     DestroyNativeShader(default_shader_);
     default_shader_.clear();
@@ -144,10 +216,20 @@ void Renderer::Destroy()
     interlace_texture_.clear();
   }
 
-  for (auto it=texture_cache_.begin(); it!=texture_cache_.end(); it++) {
-    DestroyNativeTexture(it->handle);
+  for (auto it=texture_cache_.cbegin(); it!=texture_cache_.cend(); it++) {
+    for (const CachedTexture &t : it.value()) {
+      DestroyCachedTexture(t);
+    }
   }
   texture_cache_.clear();
+  MemoryManager::Released(MemoryManager::kTexturePool, texture_cache_bytes_);
+  texture_cache_bytes_ = 0;
+  texture_cache_count_ = 0;
+
+  foreach (const QVariant &b, pixel_buffer_graveyard_) {
+    DestroyNativePixelBuffer(b);
+  }
+  pixel_buffer_graveyard_.clear();
 
   DestroyInternal();
 }
@@ -272,20 +354,192 @@ bool Renderer::GetColorContext(const ColorTransformJob &color_job, Renderer::Col
 
 void Renderer::ClearOldTextures()
 {
+  // Taken first so that stills released below, which come back through here, don't use it up
+  // before they're all in the pool
+  qint64 trim = texture_cache_trim_request_.exchange(0);
+
+  if (trim > 0) {
+    // Stills hold textures, so like the rest of the pool they can only be let go of in this thread
+    ClearCachedStills();
+  }
+
   QMutexLocker locker(&texture_cache_lock_);
 
-  for (auto it=texture_cache_.begin(); it!=texture_cache_.end(); ) {
-    if (it->accessed < QDateTime::currentMSecsSinceEpoch() - MAX_TEXTURE_LIFE) {
-      DestroyNativeTexture(it->handle);
-      it = texture_cache_.erase(it);
+  qint64 min_access = QDateTime::currentMSecsSinceEpoch() - MAX_TEXTURE_LIFE;
+
+  // Remove textures that haven't been used in a while
+  for (auto bucket=texture_cache_.begin(); bucket!=texture_cache_.end(); ) {
+    std::list<CachedTexture> &list = bucket.value();
+
+    while (!list.empty() && list.front().accessed < min_access) {
+      MemoryManager::Released(MemoryManager::kTexturePool, list.front().size);
+      texture_cache_bytes_ -= list.front().size;
+      texture_cache_count_--;
+      DestroyCachedTexture(list.front());
+      list.pop_front();
+    }
+
+    if (list.empty()) {
+      bucket = texture_cache_.erase(bucket);
     } else {
-      it++;
+      bucket++;
     }
   }
+
+  // Enforce memory limit by evicting the least recently released textures first. The limit is
+  // lowered further if the MemoryManager asked us to trim.
+  qint64 limit = qint64(OLIVE_CONFIG("TexturePoolMaximumSize").toLongLong()) * 1024 * 1024;
+  if (trim > 0) {
+    limit = std::min(limit, std::max(qint64(0), texture_cache_bytes_ - trim));
+  }
+
+  while (texture_cache_bytes_ > limit && !texture_cache_.isEmpty()) {
+    auto oldest = texture_cache_.begin();
+    for (auto bucket=texture_cache_.begin(); bucket!=texture_cache_.end(); bucket++) {
+      if (bucket.value().front().accessed < oldest.value().front().accessed) {
+        oldest = bucket;
+      }
+    }
+
+    std::list<CachedTexture> &list = oldest.value();
+    MemoryManager::Released(MemoryManager::kTexturePool, list.front().size);
+    texture_cache_bytes_ -= list.front().size;
+    texture_cache_count_--;
+    DestroyCachedTexture(list.front());
+    list.pop_front();
+
+    if (list.empty()) {
+      texture_cache_.erase(oldest);
+    }
+  }
+
+  foreach (const QVariant &b, pixel_buffer_graveyard_) {
+    DestroyNativePixelBuffer(b);
+  }
+  pixel_buffer_graveyard_.clear();
+}
+
+void Renderer::DestroyCachedTexture(const CachedTexture &t)
+{
+  if (!t.fence.isNull()) {
+    DestroyNativeFence(t.fence);
+  }
+
+  DestroyNativeTexture(t.handle);
+}
+
+qint64 Renderer::TrimMemory(qint64 bytes)
+{
+  // Each request asks for the full excess at that time, so the latest one supersedes the rest
+  texture_cache_trim_request_ = bytes;
+
+  // Nothing has been freed yet, but this is what the next clean up will free. That includes cached
+  // stills, which go back to the pool to be destroyed along with everything else.
+  qint64 held;
+
+  still_cache_lock_.lock();
+  held = still_cache_bytes_;
+  still_cache_lock_.unlock();
+
+  texture_cache_lock_.lock();
+  held += texture_cache_bytes_;
+  texture_cache_lock_.unlock();
+
+  return std::min(bytes, held);
+}
+
+TexturePtr Renderer::GetCachedStill(const QString &key)
+{
+  QMutexLocker locker(&still_cache_lock_);
+
+  auto it = still_cache_.find(key);
+  if (it == still_cache_.end()) {
+    return nullptr;
+  }
+
+  it->accessed = QDateTime::currentMSecsSinceEpoch();
+  return it->texture;
+}
+
+void Renderer::InsertCachedStill(const QString &key, TexturePtr texture)
+{
+  const VideoParams &p = texture->params();
+
+  CachedStill cs;
+  cs.texture = texture;
+  cs.size = qint64(p.effective_width()) * p.effective_height() * p.effective_depth() * p.GetBytesPerPixel();
+  cs.accessed = QDateTime::currentMSecsSinceEpoch();
+
+  qint64 limit = qint64(OLIVE_CONFIG("StillImageCacheSize").toLongLong()) * 1024 * 1024;
+  if (cs.size > limit) {
+    return;
+  }
+
+  // Evicted textures are released after unlocking since that re-enters the texture pool
+  QVector<TexturePtr> evicted;
+
+  {
+    QMutexLocker locker(&still_cache_lock_);
+
+    auto existing = still_cache_.find(key);
+    if (existing != still_cache_.end()) {
+      still_cache_bytes_ -= existing->size;
+      evicted.append(existing->texture);
+      still_cache_.erase(existing);
+    }
+
+    while (still_cache_bytes_ + cs.size > limit && !still_cache_.isEmpty()) {
+      auto oldest = still_cache_.begin();
+      for (auto it=still_cache_.begin(); it!=still_cache_.end(); it++) {
+        if (it->accessed < oldest->accessed) {
+          oldest = it;
+        }
+      }
+
+      still_cache_bytes_ -= oldest->size;
+      evicted.append(oldest->texture);
+      still_cache_.erase(oldest);
+    }
+
+    still_cache_.insert(key, cs);
+    still_cache_bytes_ += cs.size;
+  }
+}
+
+void Renderer::ClearCachedStills()
+{
+  QHash<QString, CachedStill> stills;
+
+  {
+    QMutexLocker locker(&still_cache_lock_);
+    stills.swap(still_cache_);
+    still_cache_bytes_ = 0;
+  }
+}
+
+QString Renderer::GetShaderCacheDirectory()
+{
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(QStringLiteral("shaders"));
+}
+
+Renderer::TexturePoolStatistics Renderer::GetTexturePoolStatistics()
+{
+  QMutexLocker locker(&texture_cache_lock_);
+
+  TexturePoolStatistics s;
+
+  s.hits = texture_cache_hits_;
+  s.misses = texture_cache_misses_;
+  s.bytes_held = texture_cache_bytes_;
+  s.textures_held = texture_cache_count_;
+
+  return s;
 }
 
 void Renderer::BlitColorManaged(const ColorTransformJob &color_job, Texture *destination, const VideoParams &params)
 {
+  RenderTraceSpan span("Color", "Color Transform");
+
   ColorContext color_ctx;
   if (!GetColorContext(color_job, &color_ctx)) {
     return;
@@ -298,6 +552,7 @@ void Renderer::BlitColorManaged(const ColorTransformJob &color_job, Texture *des
   job.Insert(QStringLiteral("ove_maintex_alpha"), NodeValue(NodeValue::kInt, int(color_job.GetInputAlphaAssociation())));
   job.Insert(QStringLiteral("ove_force_opaque"), NodeValue(NodeValue::kBoolean, color_job.GetForceOpaque()));
   job.Insert(color_job.GetValues());
+  job.SetRegionOfInterest(color_job.GetRegionOfInterest());
 
   foreach (const ColorContext::LUT& l, color_ctx.lut3d_textures) {
     job.Insert(l.name, NodeValue(NodeValue::kTexture, QVariant::fromValue(l.texture)));
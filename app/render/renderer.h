@@ -29,6 +29,7 @@
 #include "node/node.h"
 #include "render/colorprocessor.h"
 #include "render/job/colortransformjob.h"
+#include "render/memorymanager.h"
 #include "render/videoparams.h"
 #include "texture.h"
 
@@ -36,12 +37,14 @@ namespace olive {
 
 class ShaderJob;
 
-class Renderer : public QObject
+class Renderer : public QObject, public MemoryManager::Client
 {
   Q_OBJECT
 public:
   Renderer(QObject* parent = nullptr);
 
+  virtual ~Renderer() override;
+
   virtual bool Init() = 0;
 
   TexturePtr CreateTexture(const VideoParams& params, const void *data = nullptr, int linesize = 0);
@@ -94,10 +97,84 @@ public:
 
   virtual void DownloadFromTexture(const QVariant &handle, const VideoParams &params, void* data, int linesize) = 0;
 
+  /**
+   * @brief Create a buffer of `size` bytes for staging texture uploads
+   *
+   * Returns a null QVariant if the backend doesn't support pixel buffers.
+   */
+  virtual QVariant CreateNativePixelBuffer(int size) = 0;
+
+  /**
+   * @brief Upload to a texture by copying `data` into a pixel buffer first
+   *
+   * The copy into the buffer is the only synchronous part, the transfer into the texture happens
+   * asynchronously on the GPU. `linesize` is in pixels, as with UploadToTexture().
+   */
+  virtual void UploadToTextureFromPixelBuffer(const QVariant &handle, const VideoParams &params, const QVariant &buffer, int buffer_size, const void* data, int linesize) = 0;
+
+  /**
+   * @brief Destroy a pixel buffer created with CreateNativePixelBuffer()
+   *
+   * Can be called from any thread. If called from a thread other than the renderer's, the buffer
+   * is destroyed the next time the renderer cleans up in its own thread.
+   */
+  void DestroyPixelBuffer(const QVariant &buffer);
+
   virtual void Flush() = 0;
 
   virtual Color GetPixelFromTexture(olive::Texture *texture, const QPointF &pt) = 0;
 
+  struct TexturePoolStatistics
+  {
+    quint64 hits = 0;
+    quint64 misses = 0;
+    qint64 bytes_held = 0;
+    int textures_held = 0;
+
+    double hit_rate() const
+    {
+      quint64 total = hits + misses;
+      return total ? double(hits) / double(total) : 0.0;
+    }
+  };
+
+  /**
+   * @brief Retrieve usage statistics of the texture pool
+   *
+   * This function is thread-safe.
+   */
+  TexturePoolStatistics GetTexturePoolStatistics();
+
+  /**
+   * @brief Retrieve a color managed still image stored with InsertCachedStill(), or nullptr
+   *
+   * This function is thread-safe.
+   */
+  TexturePtr GetCachedStill(const QString &key);
+
+  /**
+   * @brief Keep a reference-space still image around so later renders can skip decoding and
+   * color managing it
+   *
+   * The least recently used stills are dropped once the cache exceeds the "StillImageCacheSize"
+   * config entry. This function is thread-safe.
+   */
+  void InsertCachedStill(const QString &key, TexturePtr texture);
+
+  /**
+   * @brief Directory that compiled shader programs and the list of shaders in use are cached in
+   */
+  static QString GetShaderCacheDirectory();
+
+  /**
+   * @brief Request that pooled textures are freed
+   *
+   * Textures, including those held by cached stills, can only be destroyed in the renderer's
+   * thread, so this happens the next time the renderer cleans up its pool. Returns how much that
+   * will free.
+   */
+  virtual qint64 TrimMemory(qint64 bytes) override;
+
 protected:
   virtual void Blit(QVariant shader,
                     olive::ShaderJob job,
@@ -109,6 +186,29 @@ protected:
 
   virtual void DestroyNativeTexture(QVariant texture) = 0;
 
+  virtual void DestroyNativePixelBuffer(QVariant buffer) = 0;
+
+  /**
+   * @brief Insert a fence after all commands submitted so far
+   */
+  virtual QVariant CreateNativeFence() = 0;
+
+  /**
+   * @brief Insert a fence after all commands submitted so far by the calling thread
+   *
+   * Used when a texture is released from a thread other than ours (e.g. the viewer drawing it in
+   * a shared context). The fence must be pollable by IsNativeFenceSignaled() from our thread.
+   * Returns a null fence if the calling thread has nothing that could still be using the texture.
+   */
+  virtual QVariant CreateNativeFenceForCurrentThread() = 0;
+
+  /**
+   * @brief Check without blocking whether the GPU has passed a fence
+   */
+  virtual bool IsNativeFenceSignaled(const QVariant &fence) = 0;
+
+  virtual void DestroyNativeFence(QVariant fence) = 0;
+
   virtual void DestroyInternal() = 0;
 
 private:
@@ -133,20 +233,73 @@ private:
 
   QHash<QString, ColorContext> color_cache_;
 
-  struct CachedTexture
+  struct TextureKey
   {
     int width;
     int height;
     int depth;
     PixelFormat format;
     int channel_count;
+
+    static TextureKey FromParams(const VideoParams &p)
+    {
+      return {p.effective_width(), p.effective_height(), p.effective_depth(), p.format(), p.channel_count()};
+    }
+
+    bool operator==(const TextureKey &rhs) const
+    {
+      return width == rhs.width && height == rhs.height && depth == rhs.depth
+          && format == rhs.format && channel_count == rhs.channel_count;
+    }
+
+    friend uint qHash(const TextureKey &k, uint seed = 0)
+    {
+      return ::qHash((qint64(k.width) << 32) | k.height, seed)
+          ^ ::qHash((k.depth << 16) | (int(static_cast<PixelFormat::Format>(k.format)) << 8) | k.channel_count);
+    }
+  };
+
+  struct CachedTexture
+  {
     QVariant handle;
+
+    // Signaled once the GPU has finished all commands that used this texture. Textures released
+    // from another thread are fenced in that thread's context with
+    // CreateNativeFenceForCurrentThread(), so this is only null if that thread had no GL context
+    // and therefore no commands to wait on.
+    QVariant fence;
+
+    qint64 size;
+    qint64 accessed;
+  };
+
+  void DestroyCachedTexture(const CachedTexture &t);
+
+  struct CachedStill
+  {
+    TexturePtr texture;
+    qint64 size;
     qint64 accessed;
   };
 
+  void ClearCachedStills();
+
   static const int MAX_TEXTURE_LIFE = 5000;
   static const bool USE_TEXTURE_CACHE = true;
-  std::list<CachedTexture> texture_cache_;
+
+  // Buckets are ordered oldest released first
+  QHash<TextureKey, std::list<CachedTexture> > texture_cache_;
+  qint64 texture_cache_bytes_;
+  int texture_cache_count_;
+  quint64 texture_cache_hits_;
+  quint64 texture_cache_misses_;
+  std::atomic<qint64> texture_cache_trim_request_;
+
+  QVector<QVariant> pixel_buffer_graveyard_;
+
+  QHash<QString, CachedStill> still_cache_;
+  qint64 still_cache_bytes_;
+  QMutex still_cache_lock_;
 
   QMutex color_cache_mutex_;
 
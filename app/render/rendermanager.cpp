@@ -21,13 +21,18 @@
 #include "rendermanager.h"
 
 #include <QApplication>
+#include <QDir>
+#include <QFile>
 #include <QMatrix4x4>
+#include <QSaveFile>
 #include <QThread>
 
 #include "config/config.h"
 #include "core.h"
 #include "render/opengl/openglrenderer.h"
 #include "renderprocessor.h"
+#include "rendertrace.h"
+#include "shaderfusion.h"
 #include "task/conform/conform.h"
 #include "task/taskmanager.h"
 #include "window/mainwindow/mainwindow.h"
@@ -39,7 +44,8 @@ const rational RenderManager::kDryRunInterval = rational(10);
 
 RenderManager::RenderManager(QObject *parent) :
   backend_(kOpenGL),
-  aggressive_gc_(0)
+  aggressive_gc_(0),
+  shader_uses_changed_(false)
 {
   if (backend_ == kOpenGL) {
     context_ = new OpenGLRenderer();
@@ -53,12 +59,16 @@ RenderManager::RenderManager(QObject *parent) :
 
   if (context_) {
     video_thread_ = CreateThread(context_);
+    video_thread_->setObjectName(QStringLiteral("Video Render"));
     dry_run_thread_ = CreateThread();
+    dry_run_thread_->setObjectName(QStringLiteral("Dry Run Render"));
     audio_thread_ = CreateThread();
+    audio_thread_->setObjectName(QStringLiteral("Audio Render"));
 
     waveform_threads_.resize(QThread::idealThreadCount());
     for (size_t i=0; i<waveform_threads_.size(); i++) {
       waveform_threads_[i] = CreateThread();
+      waveform_threads_[i]->setObjectName(QStringLiteral("Waveform Render %1").arg(i));
     }
 
     auto_cacher_ = new PreviewAutoCacher(this);
@@ -68,10 +78,40 @@ RenderManager::RenderManager(QObject *parent) :
   decoder_clear_timer_->setInterval(kDecoderMaximumInactivity);
   connect(decoder_clear_timer_, &QTimer::timeout, this, &RenderManager::ClearOldDecoders);
   decoder_clear_timer_->start();
+
+  if (decoder_cache_ && MemoryManager::instance()) {
+    MemoryManager::instance()->RegisterClient(MemoryManager::kDecoderFrames, this);
+  }
+
+  // Load list of shaders that were used in previous sessions
+  QFile uses_file(QDir(Renderer::GetShaderCacheDirectory()).filePath(QStringLiteral("used.txt")));
+  if (uses_file.open(QFile::ReadOnly | QFile::Text)) {
+    while (!uses_file.atEnd()) {
+      QString line = QString::fromUtf8(uses_file.readLine()).trimmed();
+      if (!line.isEmpty()) {
+        shader_uses_.insert(line);
+      }
+    }
+  }
 }
 
 RenderManager::~RenderManager()
 {
+  if (MemoryManager::instance()) {
+    MemoryManager::instance()->UnregisterClient(this);
+  }
+
+  if (shader_uses_changed_ && QDir().mkpath(Renderer::GetShaderCacheDirectory())) {
+    QSaveFile uses_file(QDir(Renderer::GetShaderCacheDirectory()).filePath(QStringLiteral("used.txt")));
+    if (uses_file.open(QFile::WriteOnly | QFile::Text)) {
+      foreach (const QString &id, shader_uses_) {
+        uses_file.write(id.toUtf8());
+        uses_file.write("\n");
+      }
+      uses_file.commit();
+    }
+  }
+
   if (context_) {
     delete shader_cache_;
     delete decoder_cache_;
@@ -96,28 +136,37 @@ RenderThread *RenderManager::CreateThread(Renderer *renderer)
 
 RenderTicketPtr RenderManager::RenderFrame(const RenderVideoParams &params)
 {
+  Q_ASSERT(params.video_params.is_valid());
+
   // Create ticket
-  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+  RenderTicketPtr ticket = std::make_shared<RenderVideoTicket>(params);
 
-  ticket->setProperty("node", QtUtils::PtrToValue(params.node));
+  // Parameters are read directly from the ticket by the renderer, these are only for listeners
   ticket->setProperty("time", QVariant::fromValue(params.time));
-  ticket->setProperty("size", params.force_size);
-  ticket->setProperty("matrix", params.force_matrix);
-  ticket->setProperty("format", static_cast<PixelFormat::Format>(params.force_format));
-  ticket->setProperty("usecache", params.use_cache);
-  ticket->setProperty("channelcount", params.force_channel_count);
-  ticket->setProperty("mode", params.mode);
   ticket->setProperty("type", kTypeVideo);
-  ticket->setProperty("colormanager", QtUtils::PtrToValue(params.color_manager));
-  ticket->setProperty("coloroutput", QVariant::fromValue(params.force_color_output));
+
+  if (params.return_type == ReturnType::kNull) {
+    dry_run_thread_->AddTicket(ticket);
+  } else {
+    video_thread_->AddTicket(ticket);
+  }
+
+  return ticket;
+}
+
+RenderTicketPtr RenderManager::RenderFrameRange(const RenderVideoParams &params, const TimeRange &range, const FrameRenderedCallback &frame_callback)
+{
   Q_ASSERT(params.video_params.is_valid());
-  ticket->setProperty("vparam", QVariant::fromValue(params.video_params));
-  ticket->setProperty("aparam", QVariant::fromValue(params.audio_params));
-  ticket->setProperty("return", params.return_type);
-  ticket->setProperty("cache", params.cache_dir);
-  ticket->setProperty("cachetimebase", QVariant::fromValue(params.cache_timebase));
-  ticket->setProperty("cacheid", QVariant::fromValue(params.cache_id));
-  ticket->setProperty("multicam", QtUtils::PtrToValue(params.multicam));
+
+  // Create ticket
+  RenderVideoTicketPtr ticket = std::make_shared<RenderVideoTicket>(params, range);
+
+  if (frame_callback) {
+    connect(ticket.get(), &RenderVideoTicket::FrameRendered, ticket.get(), frame_callback, Qt::DirectConnection);
+  }
+
+  ticket->setProperty("time", QVariant::fromValue(range));
+  ticket->setProperty("type", kTypeVideoRange);
 
   if (params.return_type == ReturnType::kNull) {
     dry_run_thread_->AddTicket(ticket);
@@ -128,6 +177,98 @@ RenderTicketPtr RenderManager::RenderFrame(const RenderVideoParams &params)
   return ticket;
 }
 
+void RenderManager::SetProject(Project *p)
+{
+  auto_cacher_->SetProject(p);
+
+  if (!p || !context_) {
+    return;
+  }
+
+  // Generate code on this thread since nodes belong to it, the render thread only compiles
+  QHash<QString, Node*> nodes;
+  foreach (Node *n, p->nodes()) {
+    // Any instance of the type will do, but only if its code can't differ between instances
+    if (n->ShaderCodeDependsOnlyOnID()) {
+      nodes.insert(n->id(), n);
+    }
+  }
+
+  RenderShaderPrewarmTicket::ShaderList shaders;
+
+  {
+    QMutexLocker locker(&shader_uses_lock_);
+
+    foreach (const QString &id, shader_uses_) {
+      ShaderCode code;
+
+      if (id.startsWith(QStringLiteral("fused|"))) {
+        code = GetFusedShaderCode(id, nodes);
+      } else {
+        int separator = id.indexOf(':');
+        if (separator == -1) {
+          continue;
+        }
+
+        Node *n = nodes.value(id.left(separator));
+        if (!n) {
+          continue;
+        }
+
+        code = n->GetShaderCode(id.mid(separator + 1));
+      }
+
+      if (!code.frag_code().isEmpty()) {
+        shaders.append({id, code});
+      }
+    }
+  }
+
+  if (!shaders.isEmpty()) {
+    RenderTicketPtr ticket = std::make_shared<RenderShaderPrewarmTicket>(shaders);
+    ticket->setProperty("type", kTypeShaderPrewarm);
+    video_thread_->AddTicket(ticket);
+  }
+}
+
+ShaderCode RenderManager::GetFusedShaderCode(const QString &signature, const QHash<QString, Node *> &nodes)
+{
+  // Signature is "fused|<node id>:<pointwise input>:<shader id>|...", see
+  // RenderProcessor::ProcessFusedShaders()
+  QStringList parts = signature.split('|');
+
+  QVector<ShaderFusion::Stage> stages(parts.size() - 1);
+  for (int i=1; i<parts.size(); i++) {
+    const QString &part = parts.at(i);
+
+    int node_end = part.indexOf(':');
+    int input_end = (node_end == -1) ? -1 : part.indexOf(':', node_end + 1);
+    if (input_end == -1) {
+      return ShaderCode();
+    }
+
+    Node *n = nodes.value(part.left(node_end));
+    if (!n) {
+      return ShaderCode();
+    }
+
+    stages[i - 1].code = n->GetShaderCode(part.mid(input_end + 1));
+    stages[i - 1].pointwise_input = part.mid(node_end + 1, input_end - node_end - 1);
+  }
+
+  return ShaderFusion::Fuse(stages);
+}
+
+void RenderManager::RecordShaderUse(const QString &id)
+{
+  QMutexLocker locker(&shader_uses_lock_);
+
+  if (!shader_uses_.contains(id)) {
+    shader_uses_.insert(id);
+    shader_uses_changed_ = true;
+  }
+}
+
 RenderTicketPtr RenderManager::RenderAudio(const RenderAudioParams &params)
 {
   // Create ticket
@@ -175,6 +316,39 @@ void RenderManager::SetAggressiveGarbageCollection(bool enabled)
   }
 }
 
+qint64 RenderManager::TrimMemory(qint64 bytes)
+{
+  QMutexLocker locker(decoder_cache_->mutex());
+
+  qint64 start_usage = MemoryManager::GetUsage(MemoryManager::kDecoderFrames);
+
+  // Decoders accessed very recently are probably in use by a render right now
+  qint64 min_age = QDateTime::currentMSecsSinceEpoch() - kDecoderMaximumInactivityAggressive;
+
+  qint64 freed = 0;
+  while (freed < bytes) {
+    auto oldest = decoder_cache_->end();
+    for (auto it=decoder_cache_->begin(); it!=decoder_cache_->end(); it++) {
+      qint64 accessed = it.value().decoder->GetLastAccessedTime();
+      if (accessed < min_age
+          && (oldest == decoder_cache_->end() || accessed < oldest.value().decoder->GetLastAccessedTime())) {
+        oldest = it;
+      }
+    }
+
+    if (oldest == decoder_cache_->end()) {
+      break;
+    }
+
+    oldest.value().decoder->Close();
+    decoder_cache_->erase(oldest);
+
+    freed = start_usage - MemoryManager::GetUsage(MemoryManager::kDecoderFrames);
+  }
+
+  return freed;
+}
+
 void RenderManager::ClearOldDecoders()
 {
   QMutexLocker locker(decoder_cache_->mutex());
@@ -209,6 +383,9 @@ RenderThread::RenderThread(Renderer *renderer, DecoderCache *decoder_cache, Shad
 void RenderThread::AddTicket(RenderTicketPtr ticket)
 {
   QMutexLocker locker(&mutex_);
+  if (RenderTrace::IsEnabled()) {
+    ticket->setProperty("tracequeued", RenderTrace::Now());
+  }
   ticket->moveToThread(this);
   queue_.push_back(ticket);
   wait_.wakeOne();
@@ -260,10 +437,27 @@ void RenderThread::run()
       // Setup the ticket for ::Process
       ticket->Start();
 
+      rational trace_time = rational::NaN;
+      if (RenderTrace::IsEnabled()) {
+        QVariant queued = ticket->property("tracequeued");
+        if (queued.isValid()) {
+          RenderTrace::AddEvent("Queue", QStringLiteral("Ticket Queued"), queued.toLongLong(), RenderTrace::Now());
+        }
+
+        QVariant t = ticket->property("time");
+        if (t.userType() == qMetaTypeId<rational>()) {
+          trace_time = t.value<rational>();
+        }
+      }
+
       if (ticket->IsCancelled()) {
         ticket->Finish();
       } else {
-        RenderProcessor::Process(ticket, context_, decoder_cache_, shader_cache_);
+        RenderTraceSpan span("Ticket", "Render Ticket", trace_time);
+        RenderProcessor::Process(ticket, context_, decoder_cache_, shader_cache_, &plan_);
+
+        // Keep the plan from growing unbounded as the graph is edited
+        plan_.Prune();
       }
 
       locker.relock();
@@ -21,6 +21,9 @@
 #ifndef RENDERBACKEND_H
 #define RENDERBACKEND_H
 
+#include <functional>
+#include <QMutex>
+#include <QSet>
 #include <QtConcurrent/QtConcurrent>
 
 #include "config/config.h"
@@ -46,6 +49,11 @@ public:
 
   bool RemoveTicket(RenderTicketPtr ticket);
 
+  /**
+   * @brief Close decoders that aren't in use, least recently used first
+   */
+  virtual qint64 TrimMemory(qint64 bytes) override;
+
   void quit();
 
 protected:
@@ -66,9 +74,11 @@ private:
 
   ShaderCache *shader_cache_;
 
+  NodeTraverserPlan plan_;
+
 };
 
-class RenderManager : public QObject
+class RenderManager : public QObject, public MemoryManager::Client
 {
   Q_OBJECT
 public:
@@ -103,6 +113,11 @@ public:
   };
 
   struct RenderVideoParams {
+    RenderVideoParams() :
+      RenderVideoParams(nullptr, VideoParams(), AudioParams(), rational(0), nullptr, RenderMode::kOffline)
+    {
+    }
+
     RenderVideoParams(Node *n, const VideoParams &vparam, const AudioParams &aparam, const rational &t,
                 ColorManager *colorman, RenderMode::Mode m)
     {
@@ -145,6 +160,10 @@ public:
     QSize force_size;
     int force_channel_count;
     QMatrix4x4 force_matrix;
+
+    // Normalized area of the frame that will be used, the rest may be left blank. A null rect
+    // renders the whole frame.
+    QRectF region_of_interest;
     PixelFormat force_format;
     ColorProcessorPtr force_color_output;
   };
@@ -161,6 +180,24 @@ public:
    */
   RenderTicketPtr RenderFrame(const RenderVideoParams &params);
 
+  /**
+   * @brief Asynchronously generate every frame in a range
+   *
+   * Frames are rendered in order by a single traverser so decoders, cached tables and static
+   * values are shared across the range rather than set up again for every frame. `params.time`
+   * is ignored. Each frame is streamed back through RenderVideoTicket::FrameRendered as it
+   * completes, in order and in the same form RenderFrame would return it (or a null QVariant if
+   * it couldn't be rendered). The ticket itself finishes with no value once the range is done or
+   * cancelled, with "rendertime" and "cached" covering the whole range.
+   *
+   * `frame_callback` is connected to FrameRendered before the ticket is queued so no frames can be
+   * missed. It's called directly on the render thread and must be thread-safe.
+   *
+   * This function is thread-safe.
+   */
+  using FrameRenderedCallback = std::function<void(const rational &time, const QVariant &result)>;
+  RenderTicketPtr RenderFrameRange(const RenderVideoParams &params, const TimeRange &range, const FrameRenderedCallback &frame_callback);
+
   struct RenderAudioParams {
     RenderAudioParams(Node *n, const TimeRange &time, const AudioParams &aparam, RenderMode::Mode m)
     {
@@ -193,7 +230,9 @@ public:
 
   enum TicketType {
     kTypeVideo,
-    kTypeAudio
+    kTypeVideoRange,
+    kTypeAudio,
+    kTypeShaderPrewarm
   };
 
   Backend backend() const
@@ -206,10 +245,17 @@ public:
     return auto_cacher_;
   }
 
-  void SetProject(Project *p)
-  {
-    auto_cacher_->SetProject(p);
-  }
+  /**
+   * @brief Set the active project and start compiling the shaders it used last time in the background
+   */
+  void SetProject(Project *p);
+
+  /**
+   * @brief Remember that a node's shader was compiled so it can be pre-warmed when a project loads
+   *
+   * `id` is in the form "nodeid:shaderid". This function is thread-safe.
+   */
+  void RecordShaderUse(const QString &id);
 
 public slots:
   void SetAggressiveGarbageCollection(bool enabled);
@@ -223,6 +269,13 @@ private:
 
   RenderThread *CreateThread(Renderer *renderer = nullptr);
 
+  /**
+   * @brief Rebuild the code of a fused chain from the signature it was cached under
+   *
+   * Returns an empty ShaderCode if any stage's node isn't in `nodes` or the chain no longer fuses.
+   */
+  static ShaderCode GetFusedShaderCode(const QString &signature, const QHash<QString, Node*> &nodes);
+
   static RenderManager* instance_;
 
   Renderer* context_;
@@ -251,11 +304,80 @@ private:
 
   PreviewAutoCacher *auto_cacher_;
 
+  QMutex shader_uses_lock_;
+  QSet<QString> shader_uses_;
+  bool shader_uses_changed_;
+
 private slots:
   void ClearOldDecoders();
 
 };
 
+/**
+ * @brief Ticket for video renders that carries its parameters directly rather than as properties
+ */
+class RenderVideoTicket : public RenderTicket
+{
+  Q_OBJECT
+public:
+  RenderVideoTicket(const RenderManager::RenderVideoParams &params, const TimeRange &range = TimeRange()) :
+    params_(params),
+    range_(range)
+  {
+  }
+
+  const RenderManager::RenderVideoParams &params() const
+  {
+    return params_;
+  }
+
+  /**
+   * @brief Range to render for tickets from RenderManager::RenderFrameRange
+   */
+  const TimeRange &range() const
+  {
+    return range_;
+  }
+
+signals:
+  /**
+   * @brief Emitted from the render thread when each frame of a range ticket is complete
+   */
+  void FrameRendered(const olive::rational &time, const QVariant &result);
+
+private:
+  RenderManager::RenderVideoParams params_;
+
+  TimeRange range_;
+
+};
+
+using RenderVideoTicketPtr = std::shared_ptr<RenderVideoTicket>;
+
+/**
+ * @brief Ticket carrying shader code to compile ahead of time, keyed the same way as ShaderCache
+ */
+class RenderShaderPrewarmTicket : public RenderTicket
+{
+  Q_OBJECT
+public:
+  using ShaderList = QVector<QPair<QString, ShaderCode> >;
+
+  RenderShaderPrewarmTicket(const ShaderList &shaders) :
+    shaders_(shaders)
+  {
+  }
+
+  const ShaderList &shaders() const
+  {
+    return shaders_;
+  }
+
+private:
+  ShaderList shaders_;
+
+};
+
 }
 
 Q_DECLARE_METATYPE(olive::RenderManager::TicketType)
@@ -20,6 +20,8 @@
 
 #include "renderprocessor.h"
 
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QOpenGLContext>
 #include <QVector2D>
 #include <QVector3D>
@@ -30,17 +32,20 @@
 #include "node/block/transition/transition.h"
 #include "node/project.h"
 #include "rendermanager.h"
+#include "shaderfusion.h"
 
 namespace olive {
 
 #define super NodeTraverser
 
-RenderProcessor::RenderProcessor(RenderTicketPtr ticket, Renderer *render_ctx, DecoderCache* decoder_cache, ShaderCache *shader_cache) :
+RenderProcessor::RenderProcessor(RenderTicketPtr ticket, Renderer *render_ctx, DecoderCache* decoder_cache, ShaderCache *shader_cache, NodeTraverserPlan *plan) :
   ticket_(ticket),
+  mode_(RenderMode::kOffline),
   render_ctx_(render_ctx),
   decoder_cache_(decoder_cache),
   shader_cache_(shader_cache)
 {
+  SetPlan(plan);
 }
 
 TexturePtr RenderProcessor::GenerateTexture(const rational &time, const rational &frame_length)
@@ -48,12 +53,18 @@ TexturePtr RenderProcessor::GenerateTexture(const rational &time, const rational
   TimeRange range = TimeRange(time, time + frame_length);
 
   NodeValueTable table;
-  if (Node* node = QtUtils::ValueToPtr<Node>(ticket_->property("node"))) {
-    table = GenerateTable(node, range);
+  if (video_params_.node) {
+    table = GenerateTable(video_params_.node, range);
   }
 
   NodeValue tex_val = table.Get(NodeValue::kTexture);
 
+  // Multicam displays every source in full, so only restrict regions for regular renders
+  const QRectF &roi = video_params_.region_of_interest;
+  if (!roi.isNull() && !video_params_.multicam) {
+    PropagateRegionOfInterest(tex_val, roi);
+  }
+
   ResolveJobs(tex_val);
 
   return tex_val.toTexture();
@@ -64,18 +75,18 @@ FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational& time
   // Set up output frame parameters
   VideoParams frame_params = GetCacheVideoParams();
 
-  QSize frame_size = ticket_->property("size").value<QSize>();
+  const QSize &frame_size = video_params_.force_size;
   if (!frame_size.isNull()) {
     frame_params.set_width(frame_size.width());
     frame_params.set_height(frame_size.height());
   }
 
-  PixelFormat frame_format = static_cast<PixelFormat::Format>(ticket_->property("format").toInt());
+  PixelFormat frame_format = video_params_.force_format;
   if (frame_format != PixelFormat::INVALID) {
     frame_params.set_format(frame_format);
   }
 
-  int force_channel_count = ticket_->property("channelcount").toInt();
+  int force_channel_count = video_params_.force_channel_count;
   if (force_channel_count != 0) {
     frame_params.set_channel_count(force_channel_count);
   } else {
@@ -92,7 +103,7 @@ FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational& time
     memset(frame->data(), 0, frame->allocated_size());
   } else {
     // Dump texture contents to frame
-    ColorProcessorPtr output_color_transform = ticket_->property("coloroutput").value<ColorProcessorPtr>();
+    ColorProcessorPtr output_color_transform = video_params_.force_color_output;
     const VideoParams& tex_params = texture->params();
 
     if (output_color_transform) {
@@ -113,7 +124,7 @@ FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational& time
         || tex_params.format() != frame_params.format()) {
       TexturePtr blit_tex = render_ctx_->CreateTexture(frame_params);
 
-      QMatrix4x4 matrix = ticket_->property("matrix").value<QMatrix4x4>();
+      const QMatrix4x4 &matrix = video_params_.force_matrix;
 
       // No color transform, just blit
       ShaderJob job;
@@ -134,85 +145,186 @@ FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational& time
   return frame;
 }
 
+bool RenderProcessor::RenderVideoFrame(const rational &time, QVariant *result, bool *cached)
+{
+  rational frame_length = GetCacheVideoParams().frame_rate_as_time_base();
+  if (GetCacheVideoParams().interlacing() != VideoParams::kInterlaceNone) {
+    frame_length /= 2;
+  }
+
+  TexturePtr texture = GenerateTexture(time, frame_length);
+
+  if (!render_ctx_) {
+    return false;
+  }
+
+  if (GetCacheVideoParams().interlacing() != VideoParams::kInterlaceNone) {
+    // Get next between frame and interlace it
+    TexturePtr top = texture;
+    TexturePtr bottom = GenerateTexture(time + frame_length, frame_length);
+
+    if (GetCacheVideoParams().interlacing() == VideoParams::kInterlacedBottomFirst) {
+      std::swap(top, bottom);
+    }
+
+    texture = render_ctx_->InterlaceTexture(top, bottom, GetCacheVideoParams());
+  }
+
+  if (HeardCancel()) {
+    // Return nothing since we can't guarantee the frame we generated is actually "complete"
+    return false;
+  }
+
+  FramePtr frame;
+  const QString &cache = video_params_.cache_dir;
+  RenderManager::ReturnType return_type = video_params_.return_type;
+
+  if (return_type == RenderManager::kFrame || !cache.isEmpty()) {
+    // Convert to CPU frame
+    frame = GenerateFrame(texture, time);
+
+    // Save to cache if requested
+    if (!cache.isEmpty()) {
+      bool cache_result = FrameHashCache::SaveCacheFrame(cache, QUuid(video_params_.cache_id), time, video_params_.cache_timebase, frame);
+      if (cached) {
+        *cached = cache_result;
+      }
+    }
+  }
+
+  if (return_type == RenderManager::kTexture) {
+    // Return GPU texture
+    if (!texture) {
+      texture = render_ctx_->CreateTexture(GetCacheVideoParams());
+      render_ctx_->ClearDestination(texture.get());
+    }
+
+    render_ctx_->Flush();
+
+    *result = QVariant::fromValue(texture);
+  } else {
+    *result = QVariant::fromValue(frame);
+  }
+
+  return true;
+}
+
 void RenderProcessor::Run()
 {
   // Depending on the render ticket type, start a job
-  RenderManager::TicketType type = ticket_->property("type").value<RenderManager::TicketType>();
+  type_ = ticket_->property("type").value<RenderManager::TicketType>();
 
   SetCancelPointer(ticket_->GetCancelAtom());
 
-  SetCacheVideoParams(ticket_->property("vparam").value<VideoParams>());
-  SetCacheAudioParams(ticket_->property("aparam").value<AudioParams>());
+  if (RenderVideoTicket *video_ticket = dynamic_cast<RenderVideoTicket*>(ticket_.get())) {
+    video_params_ = video_ticket->params();
+    mode_ = video_params_.mode;
+
+    SetCacheVideoParams(video_params_.video_params);
+    SetCacheAudioParams(video_params_.audio_params);
+  } else {
+    mode_ = static_cast<RenderMode::Mode>(ticket_->property("mode").toInt());
+
+    SetCacheVideoParams(ticket_->property("vparam").value<VideoParams>());
+    SetCacheAudioParams(ticket_->property("aparam").value<AudioParams>());
+  }
 
   if (IsCancelled()) {
     ticket_->Finish();
     return;
   }
 
-  switch (type) {
+  switch (type_) {
   case RenderManager::kTypeVideo:
   {
-    rational time = ticket_->property("time").value<rational>();
+    QElapsedTimer render_timer;
+    render_timer.start();
 
-    rational frame_length = GetCacheVideoParams().frame_rate_as_time_base();
-    if (GetCacheVideoParams().interlacing() != VideoParams::kInterlaceNone) {
-      frame_length /= 2;
-    }
+    QVariant result;
+    bool cached = false;
+    bool rendered = RenderVideoFrame(video_params_.time, &result, &cached);
 
-    TexturePtr texture = GenerateTexture(time, frame_length);
+    // Used by the viewer to judge whether playback can keep up at this resolution
+    ticket_->setProperty("rendertime", render_timer.elapsed());
 
-    if (!render_ctx_) {
-      ticket_->Finish();
+    if (!video_params_.cache_dir.isEmpty()) {
+      ticket_->setProperty("cached", cached);
+    }
+
+    if (rendered) {
+      ticket_->Finish(result);
     } else {
-      if (GetCacheVideoParams().interlacing() != VideoParams::kInterlaceNone) {
-        // Get next between frame and interlace it
-        TexturePtr top = texture;
-        TexturePtr bottom = GenerateTexture(time + frame_length, frame_length);
+      ticket_->Finish();
+    }
+    break;
+  }
+  case RenderManager::kTypeVideoRange:
+  {
+    RenderVideoTicket *video_ticket = static_cast<RenderVideoTicket*>(ticket_.get());
 
-        if (GetCacheVideoParams().interlacing() == VideoParams::kInterlacedBottomFirst) {
-          std::swap(top, bottom);
-        }
+    // All frames share this traverser, so anything that doesn't change between them (decoders,
+    // static values, tables for the next interlaced field) is only set up once
+    TimeRangeListFrameIterator iterator({video_ticket->range()}, GetCacheVideoParams().frame_rate_as_time_base());
+
+    QElapsedTimer render_timer;
+    render_timer.start();
+
+    // Only true if every frame in the range made it into the cache
+    bool all_cached = true;
 
-        texture = render_ctx_->InterlaceTexture(top, bottom, GetCacheVideoParams());
+    rational time;
+    while (!IsCancelled() && iterator.GetNext(&time)) {
+      PruneCachesBefore(time);
+
+      QVariant result;
+      bool cached = false;
+      if (!RenderVideoFrame(time, &result, &cached)) {
+        // Still report the frame so listeners see every time in order, just as a per-frame ticket
+        // that failed would finish with no value
+        result.clear();
       }
+      all_cached &= cached;
 
-      if (HeardCancel()) {
-        // Finish cancelled ticket with nothing since we can't guarantee the frame we generated
-        // is actually "complete
-        ticket_->Finish();
-      } else {
-        FramePtr frame;
-        QString cache = ticket_->property("cache").toString();
-        RenderManager::ReturnType return_type = RenderManager::ReturnType(ticket_->property("return").toInt());
-
-        if (return_type == RenderManager::kFrame || !cache.isEmpty()) {
-          // Convert to CPU frame
-          frame = GenerateFrame(texture, time);
-
-          // Save to cache if requested
-          if (!cache.isEmpty()) {
-            rational timebase = ticket_->property("cachetimebase").value<rational>();
-            QUuid uuid = ticket_->property("cacheid").value<QUuid>();
-            bool cache_result = FrameHashCache::SaveCacheFrame(cache, uuid, time, timebase, frame);
-            ticket_->setProperty("cached", cache_result);
-          }
-        }
+      if (IsCancelled()) {
+        break;
+      }
 
-        if (return_type == RenderManager::kTexture) {
-          // Return GPU texture
-          if (!texture) {
-            texture = render_ctx_->CreateTexture(GetCacheVideoParams());
-            render_ctx_->ClearDestination(texture.get());
-          }
+      emit video_ticket->FrameRendered(time, result);
+    }
 
-          render_ctx_->Flush();
+    // Totals for the whole range, since there's no per-frame ticket to attach them to
+    ticket_->setProperty("rendertime", render_timer.elapsed());
+
+    if (!video_params_.cache_dir.isEmpty()) {
+      ticket_->setProperty("cached", all_cached && !IsCancelled());
+    }
 
-          ticket_->Finish(QVariant::fromValue(texture));
-        } else {
-          ticket_->Finish(QVariant::fromValue(frame));
+    ticket_->Finish();
+    break;
+  }
+  case RenderManager::kTypeShaderPrewarm:
+  {
+    RenderShaderPrewarmTicket *prewarm_ticket = static_cast<RenderShaderPrewarmTicket*>(ticket_.get());
+
+    if (render_ctx_) {
+      foreach (const auto &s, prewarm_ticket->shaders()) {
+        if (IsCancelled()) {
+          break;
+        }
+
+        // Lock per shader so renders queued behind us aren't held up by the whole list
+        QMutexLocker locker(shader_cache_->mutex());
+
+        if (!shader_cache_->contains(s.first)) {
+          QVariant shader = render_ctx_->CreateNativeShader(s.second);
+          if (!shader.isNull()) {
+            shader_cache_->insert(s.first, shader);
+          }
         }
       }
     }
+
+    ticket_->Finish();
     break;
   }
   case RenderManager::kTypeAudio:
@@ -299,15 +411,42 @@ NodeValueDatabase RenderProcessor::GenerateDatabase(const Node *node, const Time
   NodeValueDatabase db = super::GenerateDatabase(node, range);
 
   if (const MultiCamNode *multicam = dynamic_cast<const MultiCamNode*>(node)) {
-    if (QtUtils::ValueToPtr<MultiCamNode>(ticket_->property("multicam")) == multicam) {
+    if (video_params_.multicam == multicam) {
       int sz = multicam->GetSourceCount();
       QVector<TexturePtr> multicam_tex(sz);
+
+      // Each source is only displayed as a tile of the grid, so render the ones that aren't the
+      // program angle at a divider to match the tile rather than the full sequence resolution
+      int rows, cols;
+      multicam->GetRowsAndColumns(&rows, &cols);
+      int tile_multiplier = std::max(rows, cols);
+
+      VideoParams full_params = GetCacheVideoParams();
+      VideoParams tile_params = full_params;
+      tile_params.set_divider(std::max(full_params.divider(),
+                                       VideoParams::GetDividerForTargetResolution(full_params.width(), full_params.height(),
+                                                                                  full_params.effective_width() / tile_multiplier,
+                                                                                  full_params.effective_height() / tile_multiplier)));
+
       for (int i=0; i<sz; i++) {
+        // The program angle has already been generated at full resolution for the main output
+        bool reduced = (i != multicam->GetCurrentSource() && tile_params.divider() != full_params.divider());
+
+        if (reduced) {
+          SetCacheVideoParams(tile_params);
+          StashCaches();
+        }
+
         NodeValueTable t = GenerateTable(multicam->GetConnectedRenderOutput(multicam->kSourcesInput, i), range, multicam);
         NodeValue val = GenerateRowValueElement(multicam, multicam->kSourcesInput, i, &t, range);
         ResolveJobs(val);
 
         multicam_tex[i] = val.toTexture();
+
+        if (reduced) {
+          RestoreCaches();
+          SetCacheVideoParams(full_params);
+        }
       }
       ticket_->setProperty("multicam_output", QVariant::fromValue(multicam_tex));
     }
@@ -316,25 +455,22 @@ NodeValueDatabase RenderProcessor::GenerateDatabase(const Node *node, const Time
   return db;
 }
 
-void RenderProcessor::Process(RenderTicketPtr ticket, Renderer *render_ctx, DecoderCache *decoder_cache, ShaderCache *shader_cache)
+void RenderProcessor::Process(RenderTicketPtr ticket, Renderer *render_ctx, DecoderCache *decoder_cache, ShaderCache *shader_cache, NodeTraverserPlan *plan)
 {
-  RenderProcessor p(ticket, render_ctx, decoder_cache, shader_cache);
+  RenderProcessor p(ticket, render_ctx, decoder_cache, shader_cache, plan);
   p.Run();
 }
 
 void RenderProcessor::ProcessVideoFootage(TexturePtr destination, const FootageJob *stream, const rational &input_time)
 {
-  if (ticket_->property("type").value<RenderManager::TicketType>() != RenderManager::kTypeVideo) {
+  if (type_ == RenderManager::kTypeAudio) {
     // Video cannot contribute to audio, so we do nothing here
     return;
   }
 
-  // Check the still frame cache. On large frames such as high resolution still images, uploading
-  // and color managing them for every frame is a waste of time, so we implement a small cache here
-  // to optimize such a situation
   VideoParams stream_data = stream->video_params();
 
-  ColorManager* color_manager = QtUtils::ValueToPtr<ColorManager>(ticket_->property("colormanager"));
+  ColorManager* color_manager = video_params_.color_manager;
 
   QString using_colorspace = stream_data.colorspace();
 
@@ -394,31 +530,74 @@ void RenderProcessor::ProcessVideoFootage(TexturePtr destination, const FootageJ
         if (!IsCancelled() && unmanaged_texture) {
           // We convert to our rendering pixel format, since that will always be float-based which
           // is necessary for correct color conversion
-          ColorProcessorPtr processor = ColorProcessor::Create(color_manager,
-                                                               using_colorspace,
-                                                               color_manager->GetReferenceColorSpace());
+          ColorProcessorPtr processor = ColorProcessorCache::Get(color_manager,
+                                                                 using_colorspace,
+                                                                 color_manager->GetReferenceColorSpace());
 
           ColorTransformJob job;
 
           job.SetColorProcessor(processor);
           job.SetInputTexture(unmanaged_texture);
-
-          if (stream_data.channel_count() != VideoParams::kRGBAChannelCount
-              || stream_data.colorspace() == color_manager->GetReferenceColorSpace()) {
-            job.SetInputAlphaAssociation(kAlphaNone);
-          } else if (stream_data.premultiplied_alpha()) {
-            job.SetInputAlphaAssociation(kAlphaAssociated);
-          } else {
-            job.SetInputAlphaAssociation(kAlphaUnassociated);
-          }
+          job.SetInputAlphaAssociation(GetFootageAlphaAssociation(stream_data));
 
           render_ctx_->BlitColorManaged(job, destination.get());
+
+          if (stream_data.video_type() == VideoParams::kVideoTypeStill) {
+            // On large frames such as high resolution still images, uploading and color managing
+            // them for every frame is a waste of time, so keep the result for GetCachedVideoFootage()
+            render_ctx_->InsertCachedStill(GetStillCacheKey(stream), destination);
+          }
         }
       }
     }
   }
 }
 
+TexturePtr RenderProcessor::GetCachedVideoFootage(const FootageJob *stream, const rational &input_time)
+{
+  Q_UNUSED(input_time)
+
+  if (type_ == RenderManager::kTypeAudio
+      || !render_ctx_
+      || stream->video_params().video_type() != VideoParams::kVideoTypeStill) {
+    return nullptr;
+  }
+
+  return render_ctx_->GetCachedStill(GetStillCacheKey(stream));
+}
+
+AlphaAssociated RenderProcessor::GetFootageAlphaAssociation(const VideoParams &stream_data) const
+{
+  if (stream_data.channel_count() != VideoParams::kRGBAChannelCount
+      || stream_data.colorspace() == video_params_.color_manager->GetReferenceColorSpace()) {
+    return kAlphaNone;
+  } else if (stream_data.premultiplied_alpha()) {
+    return kAlphaAssociated;
+  } else {
+    return kAlphaUnassociated;
+  }
+}
+
+QString RenderProcessor::GetStillCacheKey(const FootageJob *stream) const
+{
+  const VideoParams &stream_data = stream->video_params();
+  ColorManager *color_manager = video_params_.color_manager;
+
+  // Processor ID covers the source and reference color spaces as well as the config itself
+  ColorProcessorPtr processor = ColorProcessorCache::Get(color_manager,
+                                                         stream_data.colorspace(),
+                                                         color_manager->GetReferenceColorSpace());
+
+  return QStringLiteral("%1:%2:%3:%4:%5:%6:%7:%8").arg(stream->filename(),
+                                                       QString::number(QFileInfo(stream->filename()).lastModified().toMSecsSinceEpoch()),
+                                                       QString::number(stream_data.stream_index()),
+                                                       processor->id(),
+                                                       QString::number(stream_data.divider()),
+                                                       QString::number(GetFootageAlphaAssociation(stream_data)),
+                                                       QString::number(static_cast<PixelFormat::Format>(GetCacheVideoParams().format())),
+                                                       QString::number(stream_data.color_range()));
+}
+
 void RenderProcessor::ProcessAudioFootage(SampleBuffer &destination, const FootageJob *stream, const TimeRange &input_time)
 {
   DecoderPtr decoder = ResolveDecoderFromInput(stream->decoder(), Decoder::CodecStream(stream->filename(), stream->audio_params().stream_index(), nullptr));
@@ -430,7 +609,7 @@ void RenderProcessor::ProcessAudioFootage(SampleBuffer &destination, const Foota
                                                                  input_time, audio_params,
                                                                  stream->cache_path(),
                                                                  loop_mode(),
-                                                                 static_cast<RenderMode::Mode>(ticket_->property("mode").toInt()));
+                                                                 mode_);
 
     if (status == Decoder::kWaitingForConform) {
       ticket_->setProperty("incomplete", true);
@@ -464,6 +643,10 @@ void RenderProcessor::ProcessShader(TexturePtr destination, const Node *node, co
     }
 
     shader_cache_->insert(full_shader_id, shader);
+
+    if (RenderManager::instance() && node->ShaderCodeDependsOnlyOnID()) {
+      RenderManager::instance()->RecordShaderUse(full_shader_id);
+    }
   }
 
   locker.unlock();
@@ -472,6 +655,66 @@ void RenderProcessor::ProcessShader(TexturePtr destination, const Node *node, co
   render_ctx_->BlitToTexture(shader, *job, destination.get());
 }
 
+bool RenderProcessor::ProcessFusedShaders(TexturePtr destination, const QVector<FusedShaderStage> &stages)
+{
+  if (!render_ctx_) {
+    return false;
+  }
+
+  // Fused programs are cached by the chain's signature. Chains that can't be fused are cached as
+  // null so they aren't re-parsed every frame. The signature carries everything needed to fuse the
+  // chain again, RenderManager::SetProject() parses it to pre-warm fused programs.
+  QString signature = QStringLiteral("fused");
+  bool invalidate = false;
+  bool recordable = true;
+  foreach (const FusedShaderStage &s, stages) {
+    signature.append(QStringLiteral("|%1:%2:%3").arg(s.node->id(), s.job->GetPointwiseInput(), s.job->GetShaderID()));
+    invalidate |= s.node->ShaderCodeInvalidateFlag();
+    recordable &= s.node->ShaderCodeDependsOnlyOnID();
+  }
+
+  QMutexLocker locker(shader_cache_->mutex());
+
+  QVariant shader;
+
+  if (!invalidate && shader_cache_->contains(signature)) {
+    shader = shader_cache_->value(signature);
+  } else {
+    QVector<ShaderFusion::Stage> fusion(stages.size());
+    for (int i=0; i<stages.size(); i++) {
+      const FusedShaderStage &s = stages.at(i);
+      fusion[i].code = s.node->GetShaderCode(s.job->GetShaderID());
+      fusion[i].pointwise_input = s.job->GetPointwiseInput();
+    }
+
+    ShaderCode code = ShaderFusion::Fuse(fusion);
+    if (!code.frag_code().isEmpty()) {
+      shader = render_ctx_->CreateNativeShader(code);
+    }
+
+    shader_cache_->insert(signature, shader);
+
+    if (!shader.isNull() && RenderManager::instance() && recordable) {
+      RenderManager::instance()->RecordShaderUse(signature);
+    }
+  }
+
+  locker.unlock();
+
+  if (shader.isNull()) {
+    return false;
+  }
+
+  QVector<const ShaderJob*> jobs(stages.size());
+  for (int i=0; i<stages.size(); i++) {
+    jobs[i] = stages.at(i).job;
+  }
+
+  render_ctx_->BlitToTexture(shader, ShaderFusion::FuseJobs(jobs), destination.get());
+
+  return true;
+}
+
 void RenderProcessor::ProcessSamples(SampleBuffer &destination, const Node *node, const TimeRange &range, const SampleJob &job)
 {
   if (!job.samples().is_allocated()) {
@@ -561,8 +804,8 @@ void RenderProcessor::ConvertToReferenceSpace(TexturePtr destination, TexturePtr
     return;
   }
 
-  ColorManager* color_manager = QtUtils::ValueToPtr<ColorManager>(ticket_->property("colormanager"));
-  ColorProcessorPtr cp = ColorProcessor::Create(color_manager, input_cs, color_manager->GetReferenceColorSpace());
+  ColorManager* color_manager = video_params_.color_manager;
+  ColorProcessorPtr cp = ColorProcessorCache::Get(color_manager, input_cs, color_manager->GetReferenceColorSpace());
 
   ColorTransformJob ctj;
 
@@ -575,7 +818,7 @@ void RenderProcessor::ConvertToReferenceSpace(TexturePtr destination, TexturePtr
 
 bool RenderProcessor::UseCache() const
 {
-  return static_cast<RenderMode::Mode>(ticket_->property("mode").toInt()) == RenderMode::kOffline;
+  return mode_ == RenderMode::kOffline;
 }
 
 }
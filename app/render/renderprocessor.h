@@ -25,6 +25,7 @@
 #include "node/traverser.h"
 #include "render/renderer.h"
 #include "rendercache.h"
+#include "rendermanager.h"
 #include "renderticket.h"
 
 namespace olive {
@@ -34,7 +35,7 @@ class RenderProcessor : public NodeTraverser
 public:
   virtual NodeValueDatabase GenerateDatabase(const Node *node, const TimeRange &range) override;
 
-  static void Process(RenderTicketPtr ticket, Renderer* render_ctx, DecoderCache* decoder_cache, ShaderCache* shader_cache);
+  static void Process(RenderTicketPtr ticket, Renderer* render_ctx, DecoderCache* decoder_cache, ShaderCache* shader_cache, NodeTraverserPlan *plan = nullptr);
 
   struct RenderedWaveform {
     const ClipBlock* block;
@@ -46,10 +47,14 @@ public:
 protected:
   virtual void ProcessVideoFootage(TexturePtr destination, const FootageJob *stream, const rational &input_time) override;
 
+  virtual TexturePtr GetCachedVideoFootage(const FootageJob *stream, const rational &input_time) override;
+
   virtual void ProcessAudioFootage(SampleBuffer &destination, const FootageJob *stream, const TimeRange &input_time) override;
 
   virtual void ProcessShader(TexturePtr destination, const Node *node, const ShaderJob *job) override;
 
+  virtual bool ProcessFusedShaders(TexturePtr destination, const QVector<FusedShaderStage> &stages) override;
+
   virtual void ProcessSamples(SampleBuffer &destination, const Node *node, const TimeRange &range, const SampleJob &job) override;
 
   virtual void ProcessColorTransform(TexturePtr destination, const Node *node, const ColorTransformJob *job) override;
@@ -70,18 +75,43 @@ protected:
   virtual bool UseCache() const override;
 
 private:
-  RenderProcessor(RenderTicketPtr ticket, Renderer* render_ctx, DecoderCache* decoder_cache, ShaderCache* shader_cache);
+  RenderProcessor(RenderTicketPtr ticket, Renderer* render_ctx, DecoderCache* decoder_cache, ShaderCache* shader_cache, NodeTraverserPlan *plan);
 
   TexturePtr GenerateTexture(const rational& time, const rational& frame_length);
 
   FramePtr GenerateFrame(TexturePtr texture, const rational &time);
 
+  /**
+   * @brief Render one frame of a video ticket
+   *
+   * Returns false if no usable frame was produced (e.g. a dry run or the ticket was cancelled),
+   * otherwise `result` is set to what the ticket asked for. If the ticket has a cache directory,
+   * `cached` is set to whether this frame was saved to it.
+   */
+  bool RenderVideoFrame(const rational &time, QVariant *result, bool *cached = nullptr);
+
   void Run();
 
   DecoderPtr ResolveDecoderFromInput(const QString &decoder_id, const Decoder::CodecStream& stream);
 
+  AlphaAssociated GetFootageAlphaAssociation(const VideoParams &stream_data) const;
+
+  /**
+   * @brief Key that a still image's color managed texture is stored under in the Renderer
+   *
+   * Includes everything that affects the result, including the file's modification time so
+   * that stills edited outside of Olive are picked up again.
+   */
+  QString GetStillCacheKey(const FootageJob *stream) const;
+
   RenderTicketPtr ticket_;
 
+  RenderManager::TicketType type_;
+
+  RenderManager::RenderVideoParams video_params_;
+
+  RenderMode::Mode mode_;
+
   Renderer* render_ctx_;
 
   DecoderCache* decoder_cache_;
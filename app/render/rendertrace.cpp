@@ -0,0 +1,187 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "rendertrace.h"
+
+#include <chrono>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+
+#include "node/node.h"
+
+namespace olive {
+
+std::atomic_bool RenderTrace::enabled_(false);
+QMutex RenderTrace::lock_;
+std::vector<RenderTrace::Event> RenderTrace::events_;
+QHash<void*, int> RenderTrace::thread_ids_;
+QVector<QString> RenderTrace::thread_names_;
+std::atomic<qint64> RenderTrace::epoch_(0);
+thread_local RenderTraceSpan *RenderTraceSpan::current_ = nullptr;
+
+// Stop recording past this many events so a forgotten trace can't eat all the memory
+const size_t kMaximumEvents = 4000000;
+
+static qint64 SteadyClockMicroseconds()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RenderTrace::SetEnabled(bool e)
+{
+  QMutexLocker locker(&lock_);
+
+  if (e) {
+    events_.clear();
+    thread_ids_.clear();
+    thread_names_.clear();
+    epoch_ = SteadyClockMicroseconds();
+  }
+
+  enabled_ = e;
+}
+
+qint64 RenderTrace::Now()
+{
+  return SteadyClockMicroseconds() - epoch_.load(std::memory_order_relaxed);
+}
+
+void RenderTrace::AddEvent(const char *category, const QString &name, qint64 start, qint64 end, const rational &time)
+{
+  QThread *thread = QThread::currentThread();
+
+  QMutexLocker locker(&lock_);
+
+  if (!enabled_ || events_.size() >= kMaximumEvents) {
+    return;
+  }
+
+  int tid = thread_ids_.value(thread, -1);
+  if (tid == -1) {
+    tid = thread_names_.size();
+    thread_ids_.insert(thread, tid);
+
+    QString thread_name = thread->objectName();
+    if (thread_name.isEmpty()) {
+      thread_name = QStringLiteral("%1 %2").arg(thread->metaObject()->className(), QString::number(tid));
+    }
+    thread_names_.append(thread_name);
+  }
+
+  events_.push_back({category, name, start, end - start, time.isNaN() ? qSNaN() : time.toDouble(), tid});
+}
+
+static QString EscapeJSONString(const QString &s)
+{
+  QString escaped;
+  escaped.reserve(s.size());
+
+  for (const QChar &c : s) {
+    if (c == '"' || c == '\\') {
+      escaped.append('\\');
+      escaped.append(c);
+    } else if (c.unicode() < 0x20) {
+      escaped.append(QStringLiteral("\\u%1").arg(c.unicode(), 4, 16, QLatin1Char('0')));
+    } else {
+      escaped.append(c);
+    }
+  }
+
+  return escaped;
+}
+
+bool RenderTrace::Export(const QString &filename)
+{
+  QFile f(filename);
+  if (!f.open(QFile::WriteOnly | QFile::Truncate)) {
+    return false;
+  }
+
+  QMutexLocker locker(&lock_);
+
+  QTextStream s(&f);
+  s << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  s << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Olive\"}}";
+
+  for (int i=0; i<thread_names_.size(); i++) {
+    s << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+      << ",\"args\":{\"name\":\"" << EscapeJSONString(thread_names_.at(i)) << "\"}}";
+  }
+
+  for (const Event &e : events_) {
+    s << ",\n{\"name\":\"" << EscapeJSONString(e.name) << "\",\"cat\":\"" << e.category
+      << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+      << ",\"ts\":" << e.start << ",\"dur\":" << e.duration;
+
+    if (!qIsNaN(e.time)) {
+      s << ",\"args\":{\"time\":" << QString::number(e.time, 'f', 6) << "}";
+    }
+
+    s << "}";
+  }
+
+  s << "]}\n";
+
+  s.flush();
+  return f.error() == QFile::NoError;
+}
+
+size_t RenderTrace::GetEventCount()
+{
+  QMutexLocker locker(&lock_);
+  return events_.size();
+}
+
+void RenderTraceSpan::Begin()
+{
+  parent_ = current_;
+  current_ = this;
+
+  if (time_.isNaN() && parent_) {
+    time_ = parent_->time_;
+  }
+
+  start_ = RenderTrace::Now();
+}
+
+RenderTraceSpan::~RenderTraceSpan()
+{
+  if (start_ < 0) {
+    return;
+  }
+
+  current_ = parent_;
+
+  if (RenderTrace::IsEnabled()) {
+    QString name;
+    if (node_) {
+      name = node_->GetLabelAndName();
+    } else if (name_) {
+      name = QString::fromLatin1(name_);
+    } else {
+      name = dynamic_name_;
+    }
+
+    RenderTrace::AddEvent(category_, name, start_, RenderTrace::Now(), time_);
+  }
+}
+
+}
@@ -0,0 +1,201 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef RENDERTRACE_H
+#define RENDERTRACE_H
+
+#include <atomic>
+#include <olive/core/core.h>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+#include "common/define.h"
+
+namespace olive {
+
+using namespace core;
+
+class Node;
+
+/**
+ * @brief Process-wide recorder of timed render spans, exportable as a Chrome/Perfetto trace
+ *
+ * Recording is off by default. While off, creating a RenderTraceSpan only costs reading an atomic
+ * flag, so spans can be left in hot paths permanently. Exported files can be opened in
+ * chrome://tracing or https://ui.perfetto.dev.
+ */
+class RenderTrace
+{
+public:
+  /**
+   * @brief Start or stop recording
+   *
+   * Starting discards any events from a previous recording.
+   */
+  static void SetEnabled(bool e);
+
+  static bool IsEnabled()
+  {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Current time on the trace clock in microseconds
+   *
+   * Thread-safe. The clock is monotonic and restarts from 0 whenever recording starts.
+   */
+  static qint64 Now();
+
+  /**
+   * @brief Record a span that has already finished
+   *
+   * @param time
+   *
+   * Sequence time of the frame the span was for, or NaN if not applicable.
+   */
+  static void AddEvent(const char *category, const QString &name, qint64 start, qint64 end, const rational &time = rational::NaN);
+
+  /**
+   * @brief Write all recorded events to a file in Chrome trace event JSON format
+   */
+  static bool Export(const QString &filename);
+
+  static size_t GetEventCount();
+
+private:
+  struct Event
+  {
+    const char *category;
+    QString name;
+    qint64 start;
+    qint64 duration;
+    double time;
+    int thread;
+  };
+
+  static std::atomic_bool enabled_;
+
+  static QMutex lock_;
+
+  static std::vector<Event> events_;
+
+  static QHash<void*, int> thread_ids_;
+
+  static QVector<QString> thread_names_;
+
+  // Steady clock time in microseconds that Now() counts from
+  static std::atomic<qint64> epoch_;
+
+};
+
+/**
+ * @brief Records the lifetime of this object as a span if tracing is enabled
+ *
+ * Spans that aren't given a frame time take it from the span they're nested in on the same
+ * thread, so work deep inside a frame's render (decoding, uploads, shaders) is still attributed
+ * to that frame.
+ */
+class RenderTraceSpan
+{
+public:
+  RenderTraceSpan(const char *category, const char *name, const rational &time = rational::NaN) :
+    category_(category),
+    name_(name),
+    node_(nullptr),
+    time_(time),
+    start_(-1)
+  {
+    if (RenderTrace::IsEnabled()) {
+      Begin();
+    }
+  }
+
+  RenderTraceSpan(const char *category, const QString &name, const rational &time = rational::NaN) :
+    category_(category),
+    name_(nullptr),
+    node_(nullptr),
+    time_(time),
+    start_(-1)
+  {
+    if (RenderTrace::IsEnabled()) {
+      dynamic_name_ = name;
+      Begin();
+    }
+  }
+
+  RenderTraceSpan(const char *category, const Node *node, const rational &time = rational::NaN) :
+    category_(category),
+    name_(nullptr),
+    node_(node),
+    time_(time),
+    start_(-1)
+  {
+    if (RenderTrace::IsEnabled()) {
+      Begin();
+    }
+  }
+
+  ~RenderTraceSpan();
+
+  DISABLE_COPY_MOVE(RenderTraceSpan)
+
+  /**
+   * @brief Whether this span will be recorded, so names that cost something to build can be
+   * skipped when it won't
+   */
+  bool IsRecording() const
+  {
+    return start_ >= 0;
+  }
+
+  void SetName(const QString &name)
+  {
+    name_ = nullptr;
+    node_ = nullptr;
+    dynamic_name_ = name;
+  }
+
+private:
+  void Begin();
+
+  const char *category_;
+
+  const char *name_;
+
+  QString dynamic_name_;
+
+  const Node *node_;
+
+  rational time_;
+
+  qint64 start_;
+
+  RenderTraceSpan *parent_;
+
+  // Innermost span being recorded on this thread
+  static thread_local RenderTraceSpan *current_;
+
+};
+
+}
+
+#endif // RENDERTRACE_H
@@ -0,0 +1,374 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "shaderfusion.h"
+
+#include <QRegularExpression>
+#include <QSet>
+
+namespace olive {
+
+namespace {
+
+const QString kTexCoord = QStringLiteral("ove_texcoord");
+const QString kFragColor = QStringLiteral("frag_color");
+
+bool IsIdentifierStart(QChar c)
+{
+  return c.isLetter() || c == '_';
+}
+
+bool IsIdentifierChar(QChar c)
+{
+  return c.isLetterOrNumber() || c == '_';
+}
+
+QString StripComments(const QString &code, bool *ok)
+{
+  QString out;
+  out.reserve(code.size());
+
+  for (int i=0; i<code.size(); i++) {
+    if (code.at(i) == '/' && i + 1 < code.size()) {
+      if (code.at(i+1) == '/') {
+        // Keep the line break so preprocessor directives stay terminated
+        while (i < code.size() && code.at(i) != '\n') {
+          i++;
+        }
+        if (i < code.size()) {
+          out.append('\n');
+        }
+        continue;
+      } else if (code.at(i+1) == '*') {
+        int end = code.indexOf(QStringLiteral("*/"), i + 2);
+        if (end == -1) {
+          *ok = false;
+          return QString();
+        }
+        out.append(' ');
+        i = end + 1;
+        continue;
+      }
+    }
+
+    out.append(code.at(i));
+  }
+
+  return out;
+}
+
+QStringList SplitTopLevel(const QString &code, bool *ok)
+{
+  // Splits code into top-level statements: preprocessor directives, declarations and function
+  // definitions
+  QStringList chunks;
+  QString current;
+  int braces = 0;
+  int parens = 0;
+
+  for (int i=0; i<code.size(); i++) {
+    QChar c = code.at(i);
+
+    if (c == '#' && braces == 0 && parens == 0 && current.trimmed().isEmpty()) {
+      int end = i;
+      while (end < code.size() && !(code.at(end) == '\n' && code.at(end-1) != '\\')) {
+        end++;
+      }
+      chunks.append(code.mid(i, end - i));
+      current.clear();
+      i = end;
+      continue;
+    }
+
+    current.append(c);
+
+    if (c == '{') {
+      braces++;
+    } else if (c == '}') {
+      braces--;
+      if (braces < 0) {
+        *ok = false;
+        return QStringList();
+      } else if (braces == 0 && parens == 0) {
+        chunks.append(current);
+        current.clear();
+      }
+    } else if (c == '(') {
+      parens++;
+    } else if (c == ')') {
+      parens--;
+    } else if (c == ';' && braces == 0 && parens == 0) {
+      chunks.append(current);
+      current.clear();
+    }
+  }
+
+  if (braces != 0 || parens != 0 || !current.trimmed().isEmpty()) {
+    *ok = false;
+  }
+
+  return chunks;
+}
+
+bool ContainsIdentifier(const QString &code, const QString &id)
+{
+  return code.contains(QRegularExpression(QStringLiteral("\\b%1\\b").arg(QRegularExpression::escape(id))));
+}
+
+QString PrefixIdentifiers(const QString &code, const QSet<QString> &ids, const QString &prefix)
+{
+  QString out;
+  out.reserve(code.size() + ids.size() * prefix.size());
+
+  for (int i=0; i<code.size(); ) {
+    QChar c = code.at(i);
+
+    if (IsIdentifierStart(c)) {
+      int start = i;
+      while (i < code.size() && IsIdentifierChar(code.at(i))) {
+        i++;
+      }
+
+      QString token = code.mid(start, i - start);
+
+      // Don't touch swizzles and struct members
+      bool is_member = (start > 0 && code.at(start-1) == '.');
+
+      if (!is_member && ids.contains(token)) {
+        out.append(prefix);
+      }
+      out.append(token);
+    } else if (c.isDigit()) {
+      // Consume whole numeric literals so exponents/suffixes aren't mistaken for identifiers
+      while (i < code.size() && (IsIdentifierChar(code.at(i)) || code.at(i) == '.')) {
+        out.append(code.at(i));
+        i++;
+      }
+    } else {
+      out.append(c);
+      i++;
+    }
+  }
+
+  return out;
+}
+
+}
+
+ShaderCode ShaderFusion::Fuse(const QVector<Stage> &stages)
+{
+  static const QRegularExpression define_regex(QStringLiteral("^#\\s*define\\s+(\\w+)"));
+  static const QRegularExpression directive_regex(QStringLiteral("^#\\s*(version|extension)\\b"));
+  static const QRegularExpression varying_regex(QStringLiteral("^(?:in|out)\\s+\\w+\\s+(\\w+)\\s*;$"));
+  static const QRegularExpression uniform_regex(QStringLiteral("^uniform\\s+(?:(?:lowp|mediump|highp)\\s+)?(\\w+)\\s+(\\w+)\\s*(?:\\[[^\\]]*\\])?\\s*;$"));
+  static const QRegularExpression function_regex(QStringLiteral("^\\w+\\s+(\\w+)\\s*\\("));
+  static const QRegularExpression global_regex(QStringLiteral("^(?:const\\s+)?(?:(?:lowp|mediump|highp)\\s+)?\\w+\\s+(\\w+)\\s*(?:\\[[^\\]]*\\])?\\s*(?:=|;)"));
+  static const QRegularExpression return_regex(QStringLiteral("\\breturn\\s*;"));
+
+  if (stages.size() < 2) {
+    return ShaderCode();
+  }
+
+  QString fused = QStringLiteral("in vec2 %1;\nout vec4 %2;\n\n").arg(kTexCoord, kFragColor);
+
+  for (int i=0; i<stages.size(); i++) {
+    const Stage &stage = stages.at(i);
+
+    if (!stage.code.vert_code().isEmpty() || stage.code.frag_code().isEmpty()) {
+      // Fused programs always use the default vertex shader
+      return ShaderCode();
+    }
+
+    bool ok = true;
+    QStringList chunks = SplitTopLevel(StripComments(stage.code.frag_code(), &ok), &ok);
+    if (!ok) {
+      return ShaderCode();
+    }
+
+    const QString &main_input = stage.pointwise_input;
+    bool replace_main_input = (i > 0);
+    if (replace_main_input && main_input.isEmpty()) {
+      return ShaderCode();
+    }
+    QString main_input_enabled = main_input + QStringLiteral("_enabled");
+
+    QSet<QString> globals;
+    QStringList kept;
+    QString main_body;
+    bool found_main = false;
+
+    foreach (const QString &chunk, chunks) {
+      QString t = chunk.trimmed();
+
+      if (t.isEmpty() || t == QStringLiteral(";")) {
+        continue;
+      }
+
+      if (t.startsWith('#')) {
+        if (directive_regex.match(t).hasMatch()) {
+          return ShaderCode();
+        }
+
+        QRegularExpressionMatch m = define_regex.match(t);
+        if (m.hasMatch()) {
+          globals.insert(m.captured(1));
+        }
+
+        kept.append(t);
+      } else if (t.startsWith(QStringLiteral("in ")) || t.startsWith(QStringLiteral("out "))) {
+        // The only varyings the default vertex shader provides are the texcoord in and color out,
+        // which the fused program declares once
+        QRegularExpressionMatch m = varying_regex.match(t);
+        if (!m.hasMatch() || (m.captured(1) != kTexCoord && m.captured(1) != kFragColor)) {
+          return ShaderCode();
+        }
+      } else if (t.startsWith(QStringLiteral("precision "))) {
+        continue;
+      } else if (t.startsWith(QStringLiteral("uniform "))) {
+        QRegularExpressionMatch m = uniform_regex.match(t);
+        if (!m.hasMatch()) {
+          return ShaderCode();
+        }
+
+        const QString type = m.captured(1);
+        const QString name = m.captured(2);
+
+        if (replace_main_input && name == main_input) {
+          if (type != QStringLiteral("sampler2D")) {
+            return ShaderCode();
+          }
+          continue;
+        } else if (replace_main_input && name == main_input_enabled) {
+          continue;
+        }
+
+        globals.insert(name);
+        kept.append(t);
+      } else if (t.endsWith('}')) {
+        QRegularExpressionMatch m = function_regex.match(t);
+        if (!m.hasMatch()) {
+          // Structs and interface blocks aren't supported
+          return ShaderCode();
+        }
+
+        if (m.captured(1) == QStringLiteral("main")) {
+          int open = t.indexOf('{');
+          main_body = t.mid(open + 1, t.size() - open - 2);
+          found_main = true;
+        } else {
+          globals.insert(m.captured(1));
+          kept.append(t);
+        }
+      } else {
+        // Function prototype or global variable
+        QRegularExpressionMatch m = function_regex.match(t);
+        if (!m.hasMatch()) {
+          m = global_regex.match(t);
+        }
+        if (!m.hasMatch()) {
+          return ShaderCode();
+        }
+
+        globals.insert(m.captured(1));
+        kept.append(t);
+      }
+    }
+
+    if (!found_main) {
+      return ShaderCode();
+    }
+
+    QString globals_code = kept.join('\n');
+
+    // Only main() may write the output color
+    if (ContainsIdentifier(globals_code, kFragColor)) {
+      return ShaderCode();
+    }
+
+    QString function = QStringLiteral("vec4 %1(vec2 %2)\n{\n  vec4 %3 = vec4(0.0);\n%4\n  return %3;\n}\n")
+        .arg(GetStageFunction(i), kTexCoord, kFragColor, QString(main_body).replace(return_regex, QStringLiteral("return %1;").arg(kFragColor)));
+
+    QString stage_code = globals_code;
+    stage_code.append(QStringLiteral("\n\n"));
+    stage_code.append(function);
+
+    if (replace_main_input) {
+      // Sampling the main input at this fragment's coordinate is the same as running the previous
+      // stage for this fragment
+      QRegularExpression sample_regex(QStringLiteral("\\btexture\\s*\\(\\s*%1\\s*,\\s*%2\\s*\\)").arg(QRegularExpression::escape(main_input), kTexCoord));
+      stage_code.replace(sample_regex, QStringLiteral("%1(%2)").arg(GetStageFunction(i - 1), kTexCoord));
+      stage_code.replace(QRegularExpression(QStringLiteral("\\b%1\\b").arg(QRegularExpression::escape(main_input_enabled))), QStringLiteral("true"));
+
+      // Any other use of the main input means it isn't pointwise after all
+      if (ContainsIdentifier(stage_code, main_input)) {
+        return ShaderCode();
+      }
+    }
+
+    fused.append(PrefixIdentifiers(stage_code, globals, GetStagePrefix(i)));
+    fused.append('\n');
+  }
+
+  fused.append(QStringLiteral("void main()\n{\n  %1 = %2(%3);\n}\n").arg(kFragColor, GetStageFunction(stages.size() - 1), kTexCoord));
+
+  return ShaderCode(fused);
+}
+
+ShaderJob ShaderFusion::FuseJobs(const QVector<const ShaderJob *> &jobs)
+{
+  ShaderJob fused;
+
+  for (int i=0; i<jobs.size(); i++) {
+    const ShaderJob *job = jobs.at(i);
+    QString prefix = GetStagePrefix(i);
+
+    for (auto it=job->GetValues().cbegin(); it!=job->GetValues().cend(); it++) {
+      if (i > 0 && it.key() == job->GetPointwiseInput()) {
+        // Replaced by the previous stage
+        continue;
+      }
+
+      fused.Insert(prefix + it.key(), it.value());
+    }
+
+    for (auto it=job->GetInterpolationMap().cbegin(); it!=job->GetInterpolationMap().cend(); it++) {
+      fused.SetInterpolation(prefix + it.key(), it.value());
+    }
+  }
+
+  // The fused pass produces the last stage's output
+  if (!jobs.isEmpty()) {
+    fused.SetRegionOfInterest(jobs.last()->GetRegionOfInterest());
+  }
+
+  return fused;
+}
+
+QString ShaderFusion::GetStagePrefix(int index)
+{
+  return QStringLiteral("ove_s%1_").arg(index);
+}
+
+QString ShaderFusion::GetStageFunction(int index)
+{
+  return QStringLiteral("ove_stage%1").arg(index);
+}
+
+}
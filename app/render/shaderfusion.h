@@ -0,0 +1,75 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SHADERFUSION_H
+#define SHADERFUSION_H
+
+#include <QVector>
+
+#include "render/job/shaderjob.h"
+#include "shadercode.h"
+
+namespace olive {
+
+/**
+ * @brief Merges a chain of shaders into a single program that renders in one pass
+ *
+ * Each stage's fragment shader is turned into a function returning its color. Every stage but the
+ * first must be pointwise on its main input, i.e. only ever sample it at `ove_texcoord`, so those
+ * samples can be replaced with a call to the previous stage's function. Globals of each stage
+ * (uniforms, functions, macros) are prefixed with GetStagePrefix() to keep stages from colliding,
+ * and FuseJobs() applies the same prefixes to the jobs' values.
+ *
+ * Fusion is conservative: anything the rewriter doesn't understand (custom vertex shaders, full
+ * programs with their own `#version`, structs, samples of the main input at other coordinates)
+ * makes Fuse() fail and the chain is rendered one pass per stage as before.
+ */
+class ShaderFusion
+{
+public:
+  struct Stage
+  {
+    ShaderCode code;
+
+    // Input that carries the previous stage's output, ignored for the first stage
+    QString pointwise_input;
+  };
+
+  /**
+   * @brief Generate the fused program for a chain, ordered from upstream to downstream
+   *
+   * Returns an empty ShaderCode if the chain can't be fused.
+   */
+  static ShaderCode Fuse(const QVector<Stage> &stages);
+
+  /**
+   * @brief Merge the jobs of a chain into a single job for the program generated by Fuse()
+   */
+  static ShaderJob FuseJobs(const QVector<const ShaderJob*> &jobs);
+
+  static QString GetStagePrefix(int index);
+
+  static QString GetStageFunction(int index);
+
+};
+
+}
+
+#endif // SHADERFUSION_H
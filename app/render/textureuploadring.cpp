@@ -0,0 +1,108 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "textureuploadring.h"
+
+#include "renderer.h"
+
+namespace olive {
+
+TextureUploadRing::TextureUploadRing() :
+  renderer_(nullptr),
+  current_(0)
+{
+}
+
+void TextureUploadRing::Advance()
+{
+  current_ = (current_ + 1) % kSlotCount;
+}
+
+TexturePtr TextureUploadRing::Upload(Renderer *renderer, int plane, const VideoParams &params, const void *data, int linesize)
+{
+  if (plane < 0 || plane >= kMaxPlanes) {
+    return nullptr;
+  }
+
+  if (renderer != renderer_) {
+    // Resources from another renderer can't be used here
+    Release();
+    renderer_ = renderer;
+  }
+
+  Plane &p = slots_[current_][plane];
+
+  if (!p.texture
+      || p.texture->width() != params.effective_width()
+      || p.texture->height() != params.effective_height()
+      || p.texture->format() != params.format()
+      || p.texture->channel_count() != params.channel_count()) {
+    p.texture = renderer_->CreateTexture(params);
+  }
+
+  if (!p.texture) {
+    return nullptr;
+  }
+
+  // Staging buffer must be able to hold the data with its full row length
+  int bpp = params.GetBytesPerPixel();
+  int required_size = linesize * bpp * (params.effective_height() - 1) + params.effective_width() * bpp;
+
+  if (p.buffer_size < required_size) {
+    if (!p.buffer.isNull()) {
+      renderer_->DestroyPixelBuffer(p.buffer);
+    }
+
+    p.buffer = renderer_->CreateNativePixelBuffer(required_size);
+    p.buffer_size = p.buffer.isNull() ? 0 : required_size;
+  }
+
+  if (p.buffer.isNull()) {
+    // Backend couldn't give us a pixel buffer, fall back to a direct upload
+    renderer_->UploadToTexture(p.texture->id(), p.texture->params(), data, linesize);
+  } else {
+    renderer_->UploadToTextureFromPixelBuffer(p.texture->id(), p.texture->params(), p.buffer, p.buffer_size, data, linesize);
+  }
+
+  return p.texture;
+}
+
+void TextureUploadRing::Release()
+{
+  for (int i=0; i<kSlotCount; i++) {
+    for (int j=0; j<kMaxPlanes; j++) {
+      Plane &p = slots_[i][j];
+
+      p.texture = nullptr;
+
+      if (!p.buffer.isNull()) {
+        renderer_->DestroyPixelBuffer(p.buffer);
+        p.buffer.clear();
+      }
+
+      p.buffer_size = 0;
+    }
+  }
+
+  renderer_ = nullptr;
+  current_ = 0;
+}
+
+}
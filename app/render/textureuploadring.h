@@ -0,0 +1,95 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TEXTUREUPLOADRING_H
+#define TEXTUREUPLOADRING_H
+
+#include "render/texture.h"
+
+namespace olive {
+
+class Renderer;
+
+/**
+ * @brief Persistent set of textures and pixel buffers for streaming frame planes to the GPU
+ *
+ * Decoders that upload several planes per frame (e.g. Y, U and V) would otherwise allocate new
+ * textures for each frame. This ring keeps kSlotCount sets of plane textures alive along with a
+ * pixel buffer per plane, so an upload is only a memcpy into mapped memory followed by an
+ * asynchronous transfer. Rotating between slots ensures we never write into a texture that the
+ * GPU may still be reading from the previous frame.
+ *
+ * Textures returned by Upload() remain owned by the ring and are only valid until the slot comes
+ * around again, so they should only be used as intermediates (e.g. as shader inputs).
+ *
+ * This class is NOT thread-safe and is expected to be guarded by its owner (such as a Decoder's
+ * mutex). It may be released from any thread.
+ */
+class TextureUploadRing
+{
+public:
+  TextureUploadRing();
+
+  ~TextureUploadRing()
+  {
+    Release();
+  }
+
+  Q_DISABLE_COPY(TextureUploadRing)
+
+  /**
+   * @brief Move to the next slot, call once before uploading the planes of a new frame
+   */
+  void Advance();
+
+  /**
+   * @brief Upload plane data into this slot's texture for `plane`, allocating it if necessary
+   *
+   * `linesize` is in pixels, matching Renderer::UploadToTexture().
+   */
+  TexturePtr Upload(Renderer *renderer, int plane, const VideoParams &params, const void *data, int linesize);
+
+  /**
+   * @brief Free all textures and pixel buffers held by this ring
+   */
+  void Release();
+
+  static const int kSlotCount = 3;
+  static const int kMaxPlanes = 4;
+
+private:
+  struct Plane
+  {
+    TexturePtr texture;
+    QVariant buffer;
+    int buffer_size = 0;
+  };
+
+  Renderer *renderer_;
+
+  Plane slots_[kSlotCount][kMaxPlanes];
+
+  int current_;
+
+};
+
+}
+
+#endif // TEXTUREUPLOADRING_H
@@ -0,0 +1,248 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "thumbnailservice.h"
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "config/config.h"
+
+namespace olive {
+
+ThumbnailService* ThumbnailService::instance_ = nullptr;
+
+void ThumbnailService::CreateInstance()
+{
+  instance_ = new ThumbnailService();
+}
+
+void ThumbnailService::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+ThumbnailService *ThumbnailService::instance()
+{
+  return instance_;
+}
+
+bool ThumbnailService::Get(const FrameHashCache *cache, const rational &time, QImage *image)
+{
+  QString filename = cache->GetValidCacheFilename(time);
+  if (filename.isEmpty()) {
+    return false;
+  }
+
+  auto it = entries_.find(filename);
+  if (it != entries_.end()) {
+    // Move to the front of the LRU list
+    lru_.splice(lru_.begin(), lru_, it->lru);
+    *image = it->image;
+    return true;
+  }
+
+  Track(cache);
+
+  Entry e;
+  e.cache = cache;
+  e.time = Timecode::snap_time_to_timebase(time, cache->GetTimebase(), Timecode::kRound);
+  e.size = 0;
+  e.load_id = next_load_id_++;
+  lru_.push_front(filename);
+  e.lru = lru_.begin();
+  entries_.insert(filename, e);
+
+  quint64 load_id = e.load_id;
+  QtConcurrent::run(&pool_, [this, filename, load_id]{
+    QImage img;
+    img.load(filename, "jpg");
+
+    QMetaObject::invokeMethod(this, [this, filename, load_id, img]{
+      LoadFinished(filename, load_id, img);
+    }, Qt::QueuedConnection);
+  });
+
+  *image = QImage();
+  return true;
+}
+
+void ThumbnailService::Insert(const FrameHashCache *cache, const rational &time, const QImage &image)
+{
+  QString filename = cache->GetValidCacheFilename(time);
+  if (filename.isEmpty() || image.isNull()) {
+    return;
+  }
+
+  auto it = entries_.find(filename);
+  if (it != entries_.end()) {
+    Remove(it);
+  }
+
+  Track(cache);
+
+  Entry e;
+  e.cache = cache;
+  e.time = Timecode::snap_time_to_timebase(time, cache->GetTimebase(), Timecode::kRound);
+  e.size = 0;
+  e.load_id = 0;
+  lru_.push_front(filename);
+  e.lru = lru_.begin();
+  entries_.insert(filename, e);
+
+  LoadFinished(filename, 0, image);
+}
+
+void ThumbnailService::Clear()
+{
+  EvictUntil(0);
+}
+
+qint64 ThumbnailService::TrimMemory(qint64 bytes)
+{
+  return EvictUntil(qMax(qint64(0), bytes_ - bytes));
+}
+
+ThumbnailService::ThumbnailService() :
+  bytes_(0),
+  next_load_id_(1)
+{
+  // Decoding is cheap per image but there can be hundreds queued at once after a zoom, so keep
+  // them out of the global pool that renders and tasks use
+  pool_.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+
+  if (MemoryManager::instance()) {
+    MemoryManager::instance()->RegisterClient(MemoryManager::kThumbnails, this);
+  }
+}
+
+ThumbnailService::~ThumbnailService()
+{
+  pool_.clear();
+  pool_.waitForDone();
+
+  if (MemoryManager::instance()) {
+    MemoryManager::instance()->UnregisterClient(this);
+  }
+
+  Clear();
+}
+
+void ThumbnailService::Track(const FrameHashCache *cache)
+{
+  if (tracked_.contains(cache)) {
+    return;
+  }
+
+  tracked_.insert(cache);
+
+  connect(cache, &FrameHashCache::Invalidated, this, [this, cache](const TimeRange &r){
+    RangeChanged(cache, r);
+  });
+
+  connect(cache, &FrameHashCache::Validated, this, [this, cache](const TimeRange &r){
+    RangeChanged(cache, r);
+  });
+
+  connect(cache, &QObject::destroyed, this, [this, cache]{
+    tracked_.remove(cache);
+
+    for (auto it=entries_.begin(); it!=entries_.end(); ) {
+      if (it->cache == cache) {
+        it = Remove(it);
+      } else {
+        it++;
+      }
+    }
+  });
+}
+
+QHash<QString, ThumbnailService::Entry>::iterator ThumbnailService::Remove(QHash<QString, Entry>::iterator it)
+{
+  if (it->size) {
+    bytes_ -= it->size;
+    MemoryManager::Released(MemoryManager::kThumbnails, it->size);
+  }
+
+  lru_.erase(it->lru);
+  return entries_.erase(it);
+}
+
+qint64 ThumbnailService::EvictUntil(qint64 limit)
+{
+  qint64 freed = 0;
+
+  // Walk from the least recently used end, skipping thumbnails that are still loading
+  auto it = lru_.end();
+  while (bytes_ > limit && it != lru_.begin()) {
+    it--;
+
+    auto entry = entries_.find(*it);
+    if (entry->load_id == 0) {
+      freed += entry->size;
+
+      // Step forward first since Remove() erases this element of the list
+      auto next = std::next(it);
+      Remove(entry);
+      it = next;
+    }
+  }
+
+  return freed;
+}
+
+void ThumbnailService::RangeChanged(const FrameHashCache *cache, const TimeRange &range)
+{
+  for (auto it=entries_.begin(); it!=entries_.end(); ) {
+    if (it->cache == cache && range.Contains(it->time)) {
+      it = Remove(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void ThumbnailService::LoadFinished(const QString &filename, quint64 load_id, const QImage &image)
+{
+  auto it = entries_.find(filename);
+  if (it == entries_.end() || it->load_id != load_id) {
+    // Invalidated or evicted while loading
+    return;
+  }
+
+  if (image.isNull()) {
+    // Leave nothing behind so the next paint tries again
+    Remove(it);
+    return;
+  }
+
+  it->image = image;
+  it->size = image.sizeInBytes();
+  it->load_id = 0;
+
+  bytes_ += it->size;
+  MemoryManager::Allocated(MemoryManager::kThumbnails, it->size);
+
+  EvictUntil(OLIVE_CONFIG("ThumbnailMemoryCacheSize").toLongLong() * 1024 * 1024);
+
+  emit ThumbnailsLoaded();
+}
+
+}
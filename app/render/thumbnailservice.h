@@ -0,0 +1,130 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef THUMBNAILSERVICE_H
+#define THUMBNAILSERVICE_H
+
+#include <list>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QSet>
+#include <QThreadPool>
+
+#include "render/framehashcache.h"
+#include "render/memorymanager.h"
+
+namespace olive {
+
+/**
+ * @brief Keeps decoded thumbnails in memory so the timeline doesn't decode them while painting
+ *
+ * Thumbnails are decoded from the disk cache in a background pool. Until a thumbnail has been
+ * decoded, Get() returns a null image and callers are expected to draw a placeholder and wait for
+ * ThumbnailsLoaded(). The least recently drawn thumbnails are dropped once the cache exceeds the
+ * "ThumbnailMemoryCacheSize" config entry, and thumbnails are dropped whenever the FrameHashCache
+ * they came from is invalidated or re-validated at their time.
+ *
+ * All functions must be called from the main thread.
+ */
+class ThumbnailService : public QObject, public MemoryManager::Client
+{
+  Q_OBJECT
+public:
+  static void CreateInstance();
+
+  static void DestroyInstance();
+
+  static ThumbnailService* instance();
+
+  /**
+   * @brief Retrieve the decoded thumbnail at `time`
+   *
+   * If the thumbnail is on disk but not in memory, `image` is set to a null image and the
+   * thumbnail is queued to load. ThumbnailsLoaded() is emitted once it has.
+   *
+   * @return False if the cache has no thumbnail at this time at all
+   */
+  bool Get(const FrameHashCache *cache, const rational &time, QImage *image);
+
+  /**
+   * @brief Store a thumbnail that was decoded elsewhere
+   */
+  void Insert(const FrameHashCache *cache, const rational &time, const QImage &image);
+
+  /**
+   * @brief Drop all thumbnails
+   */
+  void Clear();
+
+  virtual qint64 TrimMemory(qint64 bytes) override;
+
+signals:
+  void ThumbnailsLoaded();
+
+private:
+  ThumbnailService();
+
+  virtual ~ThumbnailService() override;
+
+  struct Entry
+  {
+    const FrameHashCache *cache;
+    rational time;
+    QImage image;
+    qint64 size;
+
+    // Zero once loaded, otherwise identifies the load so a stale result can be discarded
+    quint64 load_id;
+
+    std::list<QString>::iterator lru;
+  };
+
+  void Track(const FrameHashCache *cache);
+
+  QHash<QString, Entry>::iterator Remove(QHash<QString, Entry>::iterator it);
+
+  qint64 EvictUntil(qint64 limit);
+
+  void RangeChanged(const FrameHashCache *cache, const TimeRange &range);
+
+  void LoadFinished(const QString &filename, quint64 load_id, const QImage &image);
+
+  static ThumbnailService* instance_;
+
+  // Keyed by the cache filename, so passthrough caches share their thumbnails
+  QHash<QString, Entry> entries_;
+
+  // Most recently used at the front
+  std::list<QString> lru_;
+
+  qint64 bytes_;
+
+  quint64 next_load_id_;
+
+  QSet<const FrameHashCache*> tracked_;
+
+  QThreadPool pool_;
+
+};
+
+}
+
+#endif // THUMBNAILSERVICE_H
@@ -30,9 +30,9 @@
 
 namespace olive {
 
-ProjectSaveTask::ProjectSaveTask(Project *project, bool use_compression) :
+ProjectSaveTask::ProjectSaveTask(Project *project, ProjectSerializer::Format format) :
   project_(project),
-  use_compression_(use_compression)
+  format_(format)
 {
   SetTitle(tr("Saving '%1'").arg(project->filename()));
 }
@@ -47,7 +47,7 @@ bool ProjectSaveTask::Run()
   data.SetProject(project_);
   data.SetLayout(layout_);
 
-  ProjectSerializer::Result result = ProjectSerializer::Save(data, use_compression_);
+  ProjectSerializer::Result result = ProjectSerializer::Save(data, format_);
 
   bool success = false;
 
@@ -56,7 +56,11 @@ bool ProjectSaveTask::Run()
     success = true;
     break;
   case ProjectSerializer::kXmlError:
-    SetError(tr("Failed to write XML data."));
+    if (result.GetDetails().isEmpty()) {
+      SetError(tr("Failed to write XML data."));
+    } else {
+      SetError(tr("Failed to write XML data: %1").arg(result.GetDetails()));
+    }
     break;
   case ProjectSerializer::kFileError:
     SetError(tr("Failed to open file \"%1\" for writing.").arg(result.GetDetails()));
@@ -22,6 +22,7 @@
 #define PROJECTSAVEMANAGER_H
 
 #include "node/project.h"
+#include "node/project/serializer/serializer.h"
 #include "task/task.h"
 
 namespace olive {
@@ -30,7 +31,7 @@ class ProjectSaveTask : public Task
 {
   Q_OBJECT
 public:
-  ProjectSaveTask(Project* project, bool use_compression);
+  ProjectSaveTask(Project* project, ProjectSerializer::Format format);
 
   Project* GetProject() const
   {
@@ -55,7 +56,7 @@ private:
 
   QString override_filename_;
 
-  bool use_compression_;
+  ProjectSerializer::Format format_;
 
   MainWindowLayoutInfo layout_;
 
@@ -21,7 +21,6 @@
 #include "render.h"
 
 #include "node/project/sequence/sequence.h"
-#include "render/rendermanager.h"
 
 namespace olive {
 
@@ -82,9 +81,37 @@ bool RenderTask::Render(ColorManager* manager,
   // each of the system's threads are utilized as memory allows.
   const int maximum_rendered_frames = QThread::idealThreadCount();
 
+  // Single-step renders (i.e. exports) don't need each frame's ticket back, so they render in
+  // contiguous chunks that share one traverser and stream frames back as they're done. Two chunks
+  // are kept queued so the render thread never sits idle between them, each half the frame limit
+  // above so no more frames than before can stack up.
+  const bool render_ranges = !TwoStepFrameRendering();
+  std::list<TimeRange> video_chunks;
+
   rational next_frame;
-  for (int i=0; i<maximum_rendered_frames && iterator.GetNext(&next_frame); i++) {
-    StartTicket(&watcher_thread, manager, next_frame, mode, cache, force_size, force_matrix, force_format, force_channel_count, force_color_output);
+  if (render_ranges) {
+    const int frames_per_chunk = std::max(1, maximum_rendered_frames / 2);
+    const rational frame_length = video_params().frame_rate_as_time_base();
+
+    int chunk_frames = 0;
+    while (iterator.GetNext(&next_frame)) {
+      if (chunk_frames > 0 && chunk_frames < frames_per_chunk && next_frame == video_chunks.back().out()) {
+        video_chunks.back() = TimeRange(video_chunks.back().in(), next_frame + frame_length);
+        chunk_frames++;
+      } else {
+        video_chunks.push_back(TimeRange(next_frame, next_frame + frame_length));
+        chunk_frames = 1;
+      }
+    }
+
+    for (int i=0; i<2 && !video_chunks.empty(); i++) {
+      StartRangeTicket(&watcher_thread, manager, video_chunks.front(), mode, cache, force_size, force_matrix, force_format, force_channel_count, force_color_output);
+      video_chunks.pop_front();
+    }
+  } else {
+    for (int i=0; i<maximum_rendered_frames && iterator.GetNext(&next_frame); i++) {
+      StartTicket(&watcher_thread, manager, next_frame, mode, cache, force_size, force_matrix, force_format, force_channel_count, force_color_output);
+    }
   }
 
   bool result = true;
@@ -144,7 +171,28 @@ bool RenderTask::Render(ColorManager* manager,
   finished_watcher_mutex_.lock();
 
   while (result && !IsCancelled()) {
-    while (!finished_watchers_.empty() && !IsCancelled() && result) {
+    while ((!rendered_frames_.empty() || !finished_watchers_.empty()) && !IsCancelled() && result) {
+      // Frames from range tickets arrive before their ticket finishes, so handling them first
+      // means a chunk's frames are all written before the next chunk is started
+      if (!rendered_frames_.empty()) {
+        std::pair<rational, FramePtr> frame = rendered_frames_.front();
+        rendered_frames_.pop_front();
+
+        finished_watcher_mutex_.unlock();
+
+        if (!FrameDownloaded(frame.second, frame.first)) {
+          result = false;
+        }
+
+        if (native_progress_signalling_) {
+          progress_counter += 1.0;
+          emit ProgressChanged(progress_counter / total_length);
+        }
+
+        finished_watcher_mutex_.lock();
+        continue;
+      }
+
       RenderTicketWatcher* watcher = finished_watchers_.front();
       finished_watchers_.pop_front();
 
@@ -166,6 +214,14 @@ bool RenderTask::Render(ColorManager* manager,
         //progress_counter += range.length().toDouble();
         //emit ProgressChanged(progress_counter / total_length);
 
+      } else if (ticket_type == RenderManager::kTypeVideoRange) {
+
+        // Its frames were already handled as they came in, just keep the render thread fed
+        if (!video_chunks.empty()) {
+          StartRangeTicket(&watcher_thread, manager, video_chunks.front(), mode, cache, force_size, force_matrix, force_format, force_channel_count, force_color_output);
+          video_chunks.pop_front();
+        }
+
       } else if (ticket_type == RenderManager::kTypeVideo && TwoStepFrameRendering()) {
 
         if (!DownloadFrame(&watcher_thread, watcher->Get().value<FramePtr>(), watcher->property("time").value<rational>())) {
@@ -232,6 +288,11 @@ bool RenderTask::Render(ColorManager* manager,
     foreach (RenderTicketWatcher* watcher, running_watchers_) {
       watcher->WaitForFinished();
     }
+
+    // Range tickets can't stream any more frames now, drop the ones nobody will write
+    finished_watcher_mutex_.lock();
+    rendered_frames_.clear();
+    finished_watcher_mutex_.unlock();
   }
 
   watcher_thread.quit();
@@ -275,11 +336,11 @@ void RenderTask::IncrementRunningTickets()
   finished_watcher_mutex_.unlock();
 }
 
-void RenderTask::StartTicket(QThread* watcher_thread, ColorManager* manager,
-                             const rational& time, RenderMode::Mode mode, FrameHashCache* cache,
-                             const QSize &force_size, const QMatrix4x4 &force_matrix,
-                             PixelFormat force_format, int force_channel_count,
-                             ColorProcessorPtr force_color_output)
+RenderManager::RenderVideoParams RenderTask::CreateVideoParams(ColorManager *manager, const rational &time,
+                                                               RenderMode::Mode mode, FrameHashCache *cache,
+                                                               const QSize &force_size, const QMatrix4x4 &force_matrix,
+                                                               PixelFormat force_format, int force_channel_count,
+                                                               ColorProcessorPtr force_color_output) const
 {
   RenderManager::RenderVideoParams rvp(viewer_->GetConnectedTextureOutput(), video_params_, audio_params_,
                                        time, manager, mode);
@@ -294,6 +355,18 @@ void RenderTask::StartTicket(QThread* watcher_thread, ColorManager* manager,
     rvp.AddCache(cache);
   }
 
+  return rvp;
+}
+
+void RenderTask::StartTicket(QThread* watcher_thread, ColorManager* manager,
+                             const rational& time, RenderMode::Mode mode, FrameHashCache* cache,
+                             const QSize &force_size, const QMatrix4x4 &force_matrix,
+                             PixelFormat force_format, int force_channel_count,
+                             ColorProcessorPtr force_color_output)
+{
+  RenderManager::RenderVideoParams rvp = CreateVideoParams(manager, time, mode, cache, force_size, force_matrix,
+                                                           force_format, force_channel_count, force_color_output);
+
   RenderTicketWatcher* watcher = new RenderTicketWatcher();
   watcher->setProperty("time", QVariant::fromValue(time));
   PrepareWatcher(watcher, watcher_thread);
@@ -301,6 +374,32 @@ void RenderTask::StartTicket(QThread* watcher_thread, ColorManager* manager,
   watcher->SetTicket(RenderManager::instance()->RenderFrame(rvp));
 }
 
+void RenderTask::StartRangeTicket(QThread *watcher_thread, ColorManager *manager,
+                                  const TimeRange &range, RenderMode::Mode mode, FrameHashCache *cache,
+                                  const QSize &force_size, const QMatrix4x4 &force_matrix,
+                                  PixelFormat force_format, int force_channel_count,
+                                  ColorProcessorPtr force_color_output)
+{
+  RenderManager::RenderVideoParams rvp = CreateVideoParams(manager, range.in(), mode, cache, force_size, force_matrix,
+                                                           force_format, force_channel_count, force_color_output);
+
+  RenderTicketWatcher* watcher = new RenderTicketWatcher();
+  watcher->setProperty("range", QVariant::fromValue(range));
+  PrepareWatcher(watcher, watcher_thread);
+  IncrementRunningTickets();
+  watcher->SetTicket(RenderManager::instance()->RenderFrameRange(rvp, range, [this](const rational &time, const QVariant &result){
+    FrameStreamed(time, result);
+  }));
+}
+
+void RenderTask::FrameStreamed(const rational &time, const QVariant &result)
+{
+  finished_watcher_mutex_.lock();
+  rendered_frames_.push_back({time, result.value<FramePtr>()});
+  finished_watcher_wait_cond_.wakeAll();
+  finished_watcher_mutex_.unlock();
+}
+
 void RenderTask::TicketDone(RenderTicketWatcher* watcher)
 {
   finished_watcher_mutex_.lock();
@@ -26,8 +26,9 @@
 #include "node/block/subtitle/subtitle.h"
 #include "node/color/colormanager/colormanager.h"
 #include "node/output/viewer/viewer.h"
-#include "task/task.h"
+#include "render/rendermanager.h"
 #include "render/renderticket.h"
+#include "task/task.h"
 
 namespace olive {
 
@@ -116,8 +117,17 @@ private:
 
   void IncrementRunningTickets();
 
+  RenderManager::RenderVideoParams CreateVideoParams(ColorManager *manager, const rational &time, RenderMode::Mode mode, FrameHashCache *cache, const QSize &force_size, const QMatrix4x4 &force_matrix, PixelFormat force_format, int force_channel_count, ColorProcessorPtr force_color_output) const;
+
   void StartTicket(QThread *watcher_thread, ColorManager *manager, const rational &time, RenderMode::Mode mode, FrameHashCache *cache, const QSize &force_size, const QMatrix4x4 &force_matrix, PixelFormat force_format, int force_channel_count, ColorProcessorPtr force_color_output);
 
+  void StartRangeTicket(QThread *watcher_thread, ColorManager *manager, const TimeRange &range, RenderMode::Mode mode, FrameHashCache *cache, const QSize &force_size, const QMatrix4x4 &force_matrix, PixelFormat force_format, int force_channel_count, ColorProcessorPtr force_color_output);
+
+  /**
+   * @brief Called directly on the render thread for each frame a range ticket produces
+   */
+  void FrameStreamed(const rational &time, const QVariant &result);
+
   ViewerOutput* viewer_;
 
   VideoParams video_params_;
@@ -126,6 +136,7 @@ private:
 
   QVector<RenderTicketWatcher*> running_watchers_;
   std::list<RenderTicketWatcher*> finished_watchers_;
+  std::list<std::pair<rational, FramePtr> > rendered_frames_;
   int running_tickets_;
   QMutex finished_watcher_mutex_;
   QWaitCondition finished_watcher_wait_cond_;
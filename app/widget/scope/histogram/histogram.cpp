@@ -22,10 +22,8 @@
 
 #include <QPainter>
 #include <QtMath>
-#include <QVector2D>
 
 #include "common/qtutils.h"
-#include "node/node.h"
 
 namespace olive {
 
@@ -36,62 +34,61 @@ HistogramScope::HistogramScope(QWidget* parent) :
 {
 }
 
-void HistogramScope::OnInit()
+void HistogramScope::DrawScope(const ScopeAnalyzer::Result &result)
 {
-  super::OnInit();
-
-  ShaderCode secondary_code(FileFunctions::ReadFileAsString(":/shaders/rgbhistogram_secondary.frag"),
-                            FileFunctions::ReadFileAsString(":/shaders/rgbhistogram.vert"));
-  pipeline_secondary_ = renderer()->CreateNativeShader(secondary_code);
-}
-
-void HistogramScope::OnDestroy()
-{
-  pipeline_secondary_.clear();
-  texture_row_sums_ = nullptr;
+  float histogram_scale = 0.80f;
 
-  super::OnDestroy();
-}
+  QPainter p(paint_device());
 
-ShaderCode HistogramScope::GenerateShaderCode()
-{
-  return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/rgbhistogram.frag"),
-                    FileFunctions::ReadFileAsString(":/shaders/default.vert"));
-}
+  float histogram_dim_x = ceil((width() - 1.0) * histogram_scale);
+  float histogram_dim_y = ceil((height() - 1.0) * histogram_scale);
+  float histogram_start_dim_x =
+      ((width() - 1.0) - histogram_dim_x) / 2.0f;
+  float histogram_start_dim_y =
+      ((height() - 1.0) - histogram_dim_y) / 2.0f;
+  float histogram_end_dim_x = (width() - 1.0) - histogram_start_dim_x;
+  float histogram_end_dim_y = (height() - 1.0) - histogram_start_dim_y;
+
+  // Bins are already normalized against the peak, so the tallest one always reaches the top
+  const QColor channel_colors[ScopeAnalyzer::kChannelCount] = {
+    QColor(255, 0, 0),
+    QColor(0, 255, 0),
+    QColor(0, 0, 255),
+    QColor(255, 255, 255)
+  };
 
-void HistogramScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
-{
-  float histogram_scale = 0.80f;
-  // This value is eyeballed for usefulness. Until we have a geometry
-  // shader approach, it is impossible to normalize against a peak
-  // sum of image values.
-  float histogram_base = 2.5f;
-  float histogram_power = 1.0f / histogram_base;
-
-  ShaderJob shader_job;
-
-  shader_job.Insert(QStringLiteral("viewport"), NodeValue(NodeValue::kVec2, QVector2D(width(), height())));
-  shader_job.Insert(QStringLiteral("histogram_scale"), NodeValue(NodeValue::kFloat, histogram_scale));
-  shader_job.Insert(QStringLiteral("histogram_power"), NodeValue(NodeValue::kFloat, histogram_power));
-
-  if (!texture_row_sums_
-      || texture_row_sums_->width() != this->width()
-      || texture_row_sums_->height() != this->height()) {
-    texture_row_sums_ = renderer()->CreateTexture(VideoParams(width(), height(),
-                                                              managed_tex->format(),
-                                                              managed_tex->channel_count()));
+  p.setCompositionMode(QPainter::CompositionMode_Plus);
+  p.setRenderHint(QPainter::Antialiasing);
+
+  for (int c=0; c<ScopeAnalyzer::kChannelCount; c++) {
+    const QVector<float> &bins = result.histogram[c];
+
+    QPolygonF poly(bins.size() + 2);
+    for (int i=0; i<bins.size(); i++) {
+      poly[i] = QPointF(histogram_start_dim_x + histogram_dim_x * i / (bins.size() - 1),
+                        histogram_end_dim_y - histogram_dim_y * bins.at(i));
+    }
+    poly[bins.size()] = QPointF(histogram_end_dim_x, histogram_end_dim_y);
+    poly[bins.size() + 1] = QPointF(histogram_start_dim_x, histogram_end_dim_y);
+
+    if (c == ScopeAnalyzer::kLuma) {
+      // Luma is drawn as an outline so the color channels underneath stay readable
+      p.setPen(channel_colors[c]);
+      p.setBrush(Qt::NoBrush);
+    } else {
+      QColor fill = channel_colors[c];
+      fill.setAlpha(160);
+      p.setPen(Qt::NoPen);
+      p.setBrush(fill);
+    }
+
+    p.drawPolygon(poly);
   }
 
-  // Draw managed texture to a sums texture
-  shader_job.Insert(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(managed_tex)));
-  renderer()->BlitToTexture(pipeline, shader_job, texture_row_sums_.get());
-
-  // Draw sums into a histogram
-  shader_job.Insert(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(texture_row_sums_)));
-  renderer()->Blit(pipeline_secondary_, shader_job, texture_row_sums_->params());
+  p.setRenderHint(QPainter::Antialiasing, false);
+  p.setBrush(Qt::NoBrush);
 
   // Draw line overlays
-  QPainter p(paint_device());
   QFont font = p.font();
   font.setPixelSize(10);
   QFontMetrics font_metrics = QFontMetrics(font);
@@ -100,45 +97,27 @@ void HistogramScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
     0.00,
     0.25,
     0.50,
+    0.75,
     1.0
   };
 
-  int histogram_steps = histogram_increments.size();
-  QVector<QLine> histogram_lines(histogram_steps + 1);
+  QVector<QLine> histogram_lines(histogram_increments.size());
   int font_x_offset = 0;
   int font_y_offset = font_metrics.capHeight() / 2.0f;
 
-  p.setCompositionMode(QPainter::CompositionMode_Plus);
-
   p.setPen(QColor(0.0, 0.6 * 255.0, 0.0));
   p.setFont(font);
 
-  float histogram_dim_x = ceil((width() - 1.0) * histogram_scale);
-  float histogram_dim_y = ceil((height() - 1.0) * histogram_scale);
-  float histogram_start_dim_x =
-      ((width() - 1.0) - histogram_dim_x) / 2.0f;
-  float histogram_start_dim_y =
-      ((height() - 1.0) - histogram_dim_y) / 2.0f;
-  float histogram_end_dim_x = (width() - 1.0) - histogram_start_dim_x;
+  for (size_t i=0; i<histogram_increments.size(); i++) {
+    float increment = histogram_increments.at(i);
+    float y = (histogram_dim_y * (1.0 - increment)) + histogram_start_dim_y;
+
+    histogram_lines[i].setLine(histogram_start_dim_x, y, histogram_end_dim_x, y);
 
-  // for (int i=0; i <= histogram_steps; i++) {
-  for(std::vector<float>::iterator it = histogram_increments.begin();
-      it != histogram_increments.end(); it++) {
-    histogram_lines[it - histogram_increments.begin()].setLine(
-          histogram_start_dim_x,
-          (histogram_dim_y * pow(1.0 - *it, histogram_base)) +
-          histogram_start_dim_y,
-          histogram_end_dim_x,
-          (histogram_dim_y * pow(1.0 - *it, histogram_base)) +
-          histogram_start_dim_y);
-    label = QString::number(
-          *it * 100, 'f', 1) + "%";
+    label = QString::number(increment * 100, 'f', 1) + "%";
     font_x_offset = QtUtils::QFontMetricsWidth(font_metrics, label) + 4;
 
-    p.drawText(
-          histogram_start_dim_x - font_x_offset,
-          (histogram_dim_y * pow(1.0 - *it, histogram_base)) +
-          histogram_start_dim_y + font_y_offset, label);
+    p.drawText(histogram_start_dim_x - font_x_offset, y + font_y_offset, label);
   }
   p.drawLines(histogram_lines);
 }
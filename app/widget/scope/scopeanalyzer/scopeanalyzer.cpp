@@ -0,0 +1,274 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "scopeanalyzer.h"
+
+#include <cmath>
+#include <QtConcurrent/QtConcurrent>
+#include <vector>
+
+namespace olive {
+
+namespace {
+
+// Written as min then max so NaNs end up at 0
+inline float Clamp01(float v)
+{
+  return std::max(0.0f, std::min(v, 1.0f));
+}
+
+struct Band
+{
+  int x0;
+  int x1;
+
+  std::vector<quint32> histogram;
+  std::vector<quint32> vectorscope;
+};
+
+// Maps counts to 0-255 on a log scale against the peak, so sparse detail remains visible next
+// to large flat areas
+std::vector<uchar> CreateDensityTable(quint32 peak)
+{
+  std::vector<uchar> table(peak + 1);
+
+  float scale = (peak > 0) ? 255.0f / std::log1p(float(peak)) : 0.0f;
+  for (quint32 i=0; i<=peak; i++) {
+    table[i] = uchar(std::lround(std::log1p(float(i)) * scale));
+  }
+
+  return table;
+}
+
+}
+
+ScopeAnalyzer::ScopeAnalyzer(QObject *parent) :
+  QObject(parent),
+  discard_running_(false)
+{
+  connect(&watcher_, &QFutureWatcher<Result>::finished, this, &ScopeAnalyzer::WorkerFinished);
+}
+
+ScopeAnalyzer::~ScopeAnalyzer()
+{
+  watcher_.waitForFinished();
+}
+
+void ScopeAnalyzer::Analyze(FramePtr frame, ColorProcessorPtr display, const QVector3D &luma_coeffs)
+{
+  if (watcher_.isRunning()) {
+    // Only the newest frame matters, anything that was waiting before it is dropped
+    pending_frame_ = frame;
+    pending_display_ = display;
+    pending_luma_coeffs_ = luma_coeffs;
+  } else {
+    Start(frame, display, luma_coeffs);
+  }
+}
+
+ScopeAnalyzer::Result ScopeAnalyzer::AnalyzeFrame(FramePtr frame, ColorProcessorPtr display, const QVector3D &luma_coeffs)
+{
+  Result result;
+
+  if (!frame || !frame->is_allocated() || frame->width() <= 0 || frame->height() <= 0) {
+    return result;
+  }
+
+  // Downsample to a float RGBA working copy, the scopes only need a representative sample
+  int step = std::max(1, (frame->width() + kAnalysisWidth - 1) / kAnalysisWidth);
+  int width = std::max(1, frame->width() / step);
+  int height = std::max(1, frame->height() / step);
+
+  FramePtr working = Frame::Create();
+  working->set_video_params(VideoParams(width, height, PixelFormat::F32, VideoParams::kRGBAChannelCount));
+  if (!working->allocate()) {
+    return result;
+  }
+
+  bool direct_copy = (frame->format() == PixelFormat::F32 && frame->channel_count() == VideoParams::kRGBAChannelCount);
+
+  for (int y=0; y<height; y++) {
+    float *dst = reinterpret_cast<float*>(working->data() + y * working->linesize_bytes());
+
+    if (direct_copy) {
+      const float *src = reinterpret_cast<const float*>(frame->const_data() + (y * step) * frame->linesize_bytes());
+      for (int x=0; x<width; x++) {
+        memcpy(dst + x * 4, src + (x * step) * 4, sizeof(float) * 4);
+      }
+    } else {
+      for (int x=0; x<width; x++) {
+        Color c = frame->get_pixel(x * step, y * step);
+        dst[x * 4 + 0] = c.red();
+        dst[x * 4 + 1] = c.green();
+        dst[x * 4 + 2] = c.blue();
+        dst[x * 4 + 3] = c.alpha();
+      }
+    }
+  }
+
+  if (display) {
+    display->ConvertFrame(working);
+  }
+
+  // Split columns between threads. Waveform columns are then only ever written by one thread, and
+  // the histogram and vectorscope are small enough to give each thread its own copy.
+  int band_count = std::max(1, std::min(QThread::idealThreadCount(), width / 16));
+  std::vector<Band> bands(band_count);
+  for (int i=0; i<band_count; i++) {
+    bands[i].x0 = width * i / band_count;
+    bands[i].x1 = width * (i + 1) / band_count;
+  }
+
+  std::vector<quint32> waveform(size_t(width) * kWaveformLevels * 3, 0);
+
+  const float kr = luma_coeffs.x();
+  const float kg = luma_coeffs.y();
+  const float kb = luma_coeffs.z();
+  const float cb_scale = 0.5f / (1.0f - kb);
+  const float cr_scale = 0.5f / (1.0f - kr);
+
+  QtConcurrent::blockingMap(bands, [&](Band &band) {
+    band.histogram.assign(kChannelCount * kHistogramBins, 0);
+    band.vectorscope.assign(kVectorscopeSize * kVectorscopeSize, 0);
+
+    int n = band.x1 - band.x0;
+    std::vector<int> r_idx(n), g_idx(n), b_idx(n), l_idx(n), vec_idx(n);
+
+    for (int y=0; y<height; y++) {
+      const float *row = reinterpret_cast<const float*>(working->const_data() + y * working->linesize_bytes()) + band.x0 * 4;
+
+      // Branch-free so the compiler can vectorize the conversion to bin indices, the scattered
+      // increments that follow can't be
+      for (int i=0; i<n; i++) {
+        float r = Clamp01(row[i * 4 + 0]);
+        float g = Clamp01(row[i * 4 + 1]);
+        float b = Clamp01(row[i * 4 + 2]);
+        float l = Clamp01(kr * r + kg * g + kb * b);
+        float cb = Clamp01((b - l) * cb_scale + 0.5f);
+        float cr = Clamp01((r - l) * cr_scale + 0.5f);
+
+        r_idx[i] = int(r * (kHistogramBins - 1) + 0.5f);
+        g_idx[i] = int(g * (kHistogramBins - 1) + 0.5f);
+        b_idx[i] = int(b * (kHistogramBins - 1) + 0.5f);
+        l_idx[i] = int(l * (kHistogramBins - 1) + 0.5f);
+        vec_idx[i] = (kVectorscopeSize - 1 - int(cr * (kVectorscopeSize - 1) + 0.5f)) * kVectorscopeSize
+            + int(cb * (kVectorscopeSize - 1) + 0.5f);
+      }
+
+      for (int i=0; i<n; i++) {
+        band.histogram[kRed * kHistogramBins + r_idx[i]]++;
+        band.histogram[kGreen * kHistogramBins + g_idx[i]]++;
+        band.histogram[kBlue * kHistogramBins + b_idx[i]]++;
+        band.histogram[kLuma * kHistogramBins + l_idx[i]]++;
+
+        band.vectorscope[vec_idx[i]]++;
+
+        // Histogram bins and waveform levels are the same resolution so the indices are shared
+        size_t x = size_t(band.x0 + i);
+        waveform[((kWaveformLevels - 1 - r_idx[i]) * size_t(width) + x) * 3 + 0]++;
+        waveform[((kWaveformLevels - 1 - g_idx[i]) * size_t(width) + x) * 3 + 1]++;
+        waveform[((kWaveformLevels - 1 - b_idx[i]) * size_t(width) + x) * 3 + 2]++;
+      }
+    }
+  });
+
+  // Merge and normalize histogram against its peak
+  std::vector<quint32> histogram(kChannelCount * kHistogramBins, 0);
+  std::vector<quint32> vectorscope(kVectorscopeSize * kVectorscopeSize, 0);
+  for (const Band &band : bands) {
+    for (size_t i=0; i<histogram.size(); i++) {
+      histogram[i] += band.histogram[i];
+    }
+    for (size_t i=0; i<vectorscope.size(); i++) {
+      vectorscope[i] += band.vectorscope[i];
+    }
+  }
+
+  quint32 histogram_peak = *std::max_element(histogram.begin(), histogram.end());
+  for (int c=0; c<kChannelCount; c++) {
+    result.histogram[c].resize(kHistogramBins);
+    for (int i=0; i<kHistogramBins; i++) {
+      result.histogram[c][i] = histogram_peak ? float(histogram[c * kHistogramBins + i]) / float(histogram_peak) : 0.0f;
+    }
+  }
+
+  // Waveform
+  std::vector<uchar> waveform_table = CreateDensityTable(*std::max_element(waveform.begin(), waveform.end()));
+  result.waveform = QImage(width, kWaveformLevels, QImage::Format_RGB32);
+  for (int y=0; y<kWaveformLevels; y++) {
+    QRgb *line = reinterpret_cast<QRgb*>(result.waveform.scanLine(y));
+    const quint32 *counts = waveform.data() + size_t(y) * width * 3;
+    for (int x=0; x<width; x++) {
+      line[x] = qRgb(waveform_table[counts[x * 3 + 0]],
+                     waveform_table[counts[x * 3 + 1]],
+                     waveform_table[counts[x * 3 + 2]]);
+    }
+  }
+
+  // Vectorscope
+  std::vector<uchar> vectorscope_table = CreateDensityTable(*std::max_element(vectorscope.begin(), vectorscope.end()));
+  result.vectorscope = QImage(kVectorscopeSize, kVectorscopeSize, QImage::Format_RGB32);
+  for (int y=0; y<kVectorscopeSize; y++) {
+    QRgb *line = reinterpret_cast<QRgb*>(result.vectorscope.scanLine(y));
+    const quint32 *counts = vectorscope.data() + size_t(y) * kVectorscopeSize;
+    for (int x=0; x<kVectorscopeSize; x++) {
+      uchar v = vectorscope_table[counts[x]];
+      line[x] = qRgb(v, v, v);
+    }
+  }
+
+  return result;
+}
+
+void ScopeAnalyzer::Clear()
+{
+  pending_frame_ = nullptr;
+  pending_display_ = nullptr;
+
+  // Whatever is being analyzed now is out of date too
+  discard_running_ = watcher_.isRunning();
+
+  result_ = Result();
+  emit ResultReady();
+}
+
+void ScopeAnalyzer::Start(FramePtr frame, ColorProcessorPtr display, const QVector3D &luma_coeffs)
+{
+  watcher_.setFuture(QtConcurrent::run(&ScopeAnalyzer::AnalyzeFrame, frame, display, luma_coeffs));
+}
+
+void ScopeAnalyzer::WorkerFinished()
+{
+  if (discard_running_) {
+    discard_running_ = false;
+  } else {
+    result_ = watcher_.result();
+    emit ResultReady();
+  }
+
+  if (pending_frame_) {
+    FramePtr frame = pending_frame_;
+    pending_frame_ = nullptr;
+
+    Start(frame, pending_display_, pending_luma_coeffs_);
+  }
+}
+
+}
@@ -0,0 +1,132 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SCOPEANALYZER_H
+#define SCOPEANALYZER_H
+
+#include <QFutureWatcher>
+#include <QImage>
+#include <QObject>
+#include <QVector3D>
+
+#include "codec/frame.h"
+#include "render/colorprocessor.h"
+
+namespace olive {
+
+/**
+ * @brief Computes histogram, waveform and vectorscope data from a frame on the CPU
+ *
+ * Frames are downsampled, converted to display space with the CPU color processor, and analyzed
+ * by several threads at once. Analysis always happens off the calling thread: if a frame arrives
+ * while the previous one is still being analyzed, only the newest one is kept and analyzed next,
+ * so a slow analysis drops frames rather than holding up playback.
+ */
+class ScopeAnalyzer : public QObject
+{
+  Q_OBJECT
+public:
+  ScopeAnalyzer(QObject *parent = nullptr);
+
+  virtual ~ScopeAnalyzer() override;
+
+  enum Channel {
+    kRed,
+    kGreen,
+    kBlue,
+    kLuma,
+
+    kChannelCount
+  };
+
+  static const int kHistogramBins = 256;
+  static const int kWaveformLevels = 256;
+  static const int kVectorscopeSize = 256;
+
+  /**
+   * @brief Frames wider than this are downsampled before being analyzed
+   */
+  static const int kAnalysisWidth = 512;
+
+  struct Result
+  {
+    /// Bins of each channel, normalized so the tallest bin of any channel is 1.0
+    QVector<float> histogram[kChannelCount];
+
+    /// One column per analyzed column with 1.0 at the top row, red/green/blue densities are in
+    /// the matching color channels and log-scaled against the densest point
+    QImage waveform;
+
+    /// Cb along X and Cr along Y (increasing upwards), log-scaled against the densest point
+    QImage vectorscope;
+
+    bool is_null() const
+    {
+      return waveform.isNull();
+    }
+  };
+
+  /**
+   * @brief Queue a frame in reference space for analysis, emits ResultReady() when done
+   *
+   * `display` converts the frame to display space before analysis, it may be nullptr if the
+   * frame is already in display space.
+   */
+  void Analyze(FramePtr frame, ColorProcessorPtr display, const QVector3D &luma_coeffs);
+
+  /**
+   * @brief Analyze a frame on the calling thread
+   */
+  static Result AnalyzeFrame(FramePtr frame, ColorProcessorPtr display, const QVector3D &luma_coeffs);
+
+  /**
+   * @brief Most recently finished analysis, null until the first one completes
+   */
+  const Result &GetResult() const
+  {
+    return result_;
+  }
+
+  void Clear();
+
+signals:
+  void ResultReady();
+
+private:
+  void Start(FramePtr frame, ColorProcessorPtr display, const QVector3D &luma_coeffs);
+
+  QFutureWatcher<Result> watcher_;
+
+  Result result_;
+
+  FramePtr pending_frame_;
+  ColorProcessorPtr pending_display_;
+  QVector3D pending_luma_coeffs_;
+
+  bool discard_running_;
+
+private slots:
+  void WorkerFinished();
+
+};
+
+}
+
+#endif // SCOPEANALYZER_H
@@ -20,7 +20,10 @@
 
 #include "scopebase.h"
 
+#include <QMatrix4x4>
+
 #include "config/config.h"
+#include "node/color/colormanager/colormanager.h"
 
 namespace olive {
 
@@ -29,37 +32,45 @@ namespace olive {
 ScopeBase::ScopeBase(QWidget* parent) :
   super(parent),
   texture_(nullptr),
-  managed_tex_up_to_date_(false)
+  analysis_up_to_date_(false)
 {
   EnableDefaultContextMenu();
+
+  analyzer_ = new ScopeAnalyzer(this);
+  connect(analyzer_, &ScopeAnalyzer::ResultReady, this, [this]{ update(); });
 }
 
 void ScopeBase::SetBuffer(TexturePtr frame)
 {
   texture_ = frame;
-  managed_tex_up_to_date_ = false;
-  update();
-}
 
-void ScopeBase::showEvent(QShowEvent* e)
-{
-  super::showEvent(e);
+  if (texture_) {
+    // Textures can only be read back with our context current, which happens in OnPaint()
+    analysis_up_to_date_ = false;
+    update();
+  } else {
+    analyzer_->Clear();
+  }
 }
 
-void ScopeBase::DrawScope(TexturePtr managed_tex, QVariant pipeline)
+void ScopeBase::ColorProcessorChangedEvent()
 {
-  ShaderJob job;
-
-  job.Insert(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(managed_tex)));
+  // Analysis happens in display space so it has to be redone
+  analysis_up_to_date_ = false;
 
-  renderer()->Blit(pipeline, job, GetViewportParams());
+  super::ColorProcessorChangedEvent();
 }
 
-void ScopeBase::OnInit()
+QVector3D ScopeBase::GetLumaCoefficients() const
 {
-  super::OnInit();
+  if (color_manager()) {
+    double luma_coeffs[3] = {0.0, 0.0, 0.0};
+    color_manager()->GetDefaultLumaCoefs(luma_coeffs);
+    return QVector3D(luma_coeffs[0], luma_coeffs[1], luma_coeffs[2]);
+  }
 
-  pipeline_ = renderer()->CreateNativeShader(GenerateShaderCode());
+  // Rec. 709
+  return QVector3D(0.2126f, 0.7152f, 0.0722f);
 }
 
 void ScopeBase::OnPaint()
@@ -67,29 +78,38 @@ void ScopeBase::OnPaint()
   // Clear display surface
   renderer()->ClearDestination();
 
-  if (texture_) {
-    // Convert reference frame to display space
-    if (!managed_tex_ || !managed_tex_up_to_date_
-        || managed_tex_->params() != texture_->params()) {
-      managed_tex_ = renderer()->CreateTexture(texture_->params());
+  if (texture_ && !analysis_up_to_date_) {
+    // Read back a copy no larger than the analyzer would downsample to anyway
+    int analysis_width = std::min(texture_->width(), ScopeAnalyzer::kAnalysisWidth);
+    int analysis_height = std::max(1, texture_->height() * analysis_width / std::max(1, texture_->width()));
+    VideoParams analysis_params(analysis_width, analysis_height, PixelFormat::F32, VideoParams::kRGBAChannelCount);
+
+    TexturePtr analysis_tex = renderer()->CreateTexture(analysis_params);
 
-      ColorTransformJob job;
-      job.SetColorProcessor(color_service());
-      job.SetInputTexture(texture_);
-      job.SetInputAlphaAssociation(kAlphaNone);
+    ShaderJob job;
+    job.Insert(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(texture_)));
+    job.Insert(QStringLiteral("ove_mvpmat"), NodeValue(NodeValue::kMatrix, QMatrix4x4()));
+    renderer()->BlitToTexture(renderer()->GetDefaultShader(), job, analysis_tex.get());
 
-      renderer()->BlitColorManaged(job, managed_tex_.get());
-    }
+    FramePtr frame = Frame::Create();
+    frame->set_video_params(analysis_params);
+    frame->allocate();
+    analysis_tex->Download(frame->data(), frame->linesize_pixels());
+
+    analyzer_->Analyze(frame, color_service(), GetLumaCoefficients());
+
+    analysis_up_to_date_ = true;
+  }
 
-    DrawScope(managed_tex_, pipeline_);
+  const ScopeAnalyzer::Result &result = analyzer_->GetResult();
+  if (!result.is_null()) {
+    DrawScope(result);
   }
 }
 
 void ScopeBase::OnDestroy()
 {
-  managed_tex_ = nullptr;
   texture_ = nullptr;
-  pipeline_.clear();
 
   super::OnDestroy();
 }
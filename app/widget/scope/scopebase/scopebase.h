@@ -24,9 +24,16 @@
 #include "codec/frame.h"
 #include "render/colorprocessor.h"
 #include "widget/manageddisplay/manageddisplay.h"
+#include "widget/scope/scopeanalyzer/scopeanalyzer.h"
 
 namespace olive {
 
+/**
+ * @brief Base class for scopes that draw results from a ScopeAnalyzer
+ *
+ * Displayed textures are read back at analysis resolution and analyzed on the CPU in the
+ * background by a ScopeAnalyzer, sub-classes only draw the finished results.
+ */
 class ScopeBase : public ManagedDisplayWidget
 {
 public:
@@ -38,32 +45,31 @@ public slots:
   void SetBuffer(TexturePtr frame);
 
 protected slots:
-  virtual void OnInit() override;
-
   virtual void OnPaint() override;
 
   virtual void OnDestroy() override;
 
 protected:
-  virtual void showEvent(QShowEvent* e) override;
-
-  virtual ShaderCode GenerateShaderCode() = 0;
+  virtual void ColorProcessorChangedEvent() override;
 
   /**
    * @brief Draw function
    *
-   * Override this if your sub-class scope needs extra drawing.
+   * Called with the most recent analysis whenever the scope is painted.
+   */
+  virtual void DrawScope(const ScopeAnalyzer::Result &result) = 0;
+
+  /**
+   * @brief Luma coefficients of the connected color manager, Rec. 709 if there isn't one
    */
-  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline);
+  QVector3D GetLumaCoefficients() const;
 
 private:
-  QVariant pipeline_;
+  ScopeAnalyzer *analyzer_;
 
   TexturePtr texture_;
 
-  TexturePtr managed_tex_;
-
-  bool managed_tex_up_to_date_;
+  bool analysis_up_to_date_;
 
 };
 
@@ -0,0 +1,102 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "vectorscope.h"
+
+#include <QPainter>
+#include <QtMath>
+
+namespace olive {
+
+#define super ScopeBase
+
+VectorScope::VectorScope(QWidget* parent) :
+  super(parent)
+{
+}
+
+void VectorScope::DrawScope(const ScopeAnalyzer::Result &result)
+{
+  float vectorscope_scale = 0.80f;
+
+  // The vectorscope is always square
+  float vectorscope_dim = ceil((std::min(width(), height()) - 1.0) * vectorscope_scale);
+  QRectF scope_rect(((width() - 1.0) - vectorscope_dim) / 2.0f,
+                    ((height() - 1.0) - vectorscope_dim) / 2.0f,
+                    vectorscope_dim,
+                    vectorscope_dim);
+
+  QPainter p(paint_device());
+
+  // Draw analyzed density
+  p.setRenderHint(QPainter::SmoothPixmapTransform);
+  p.drawImage(scope_rect, result.vectorscope);
+
+  // Draw graticule
+  p.setCompositionMode(QPainter::CompositionMode_Plus);
+  p.setRenderHint(QPainter::Antialiasing);
+  p.setPen(QColor(0.0, 0.6 * 255.0, 0.0));
+  p.setBrush(Qt::NoBrush);
+
+  QPointF center = scope_rect.center();
+  p.drawEllipse(scope_rect);
+  p.drawLine(QPointF(scope_rect.left(), center.y()), QPointF(scope_rect.right(), center.y()));
+  p.drawLine(QPointF(center.x(), scope_rect.top()), QPointF(center.x(), scope_rect.bottom()));
+
+  // Targets for 75% color bars, placed with the same coefficients the analysis used
+  QVector3D luma_coeffs = GetLumaCoefficients();
+  float cb_scale = 0.5f / (1.0f - luma_coeffs.z());
+  float cr_scale = 0.5f / (1.0f - luma_coeffs.x());
+
+  struct Target {
+    QVector3D rgb;
+    QString label;
+  };
+
+  const Target targets[] = {
+    {QVector3D(0.75f, 0.0f, 0.0f), tr("R")},
+    {QVector3D(0.75f, 0.75f, 0.0f), tr("Yl")},
+    {QVector3D(0.0f, 0.75f, 0.0f), tr("G")},
+    {QVector3D(0.0f, 0.75f, 0.75f), tr("Cy")},
+    {QVector3D(0.0f, 0.0f, 0.75f), tr("B")},
+    {QVector3D(0.75f, 0.0f, 0.75f), tr("Mg")}
+  };
+
+  QFont font = p.font();
+  font.setPixelSize(10);
+  p.setFont(font);
+
+  float target_size = vectorscope_dim * 0.04f;
+
+  for (const Target &t : targets) {
+    float y = QVector3D::dotProduct(t.rgb, luma_coeffs);
+    float cb = (t.rgb.z() - y) * cb_scale;
+    float cr = (t.rgb.x() - y) * cr_scale;
+
+    QPointF pos(center.x() + cb * vectorscope_dim,
+                center.y() - cr * vectorscope_dim);
+
+    QRectF box(pos.x() - target_size / 2, pos.y() - target_size / 2, target_size, target_size);
+    p.drawRect(box);
+    p.drawText(box.bottomRight() + QPointF(2, 0), t.label);
+  }
+}
+
+}
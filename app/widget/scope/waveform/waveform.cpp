@@ -23,13 +23,8 @@
 
 #include <QPainter>
 #include <QtMath>
-#include <QDebug>
-#include <QVector2D>
-#include <QVector3D>
 
 #include "common/qtutils.h"
-#include "config/config.h"
-#include "node/node.h"
 
 namespace olive {
 
@@ -40,40 +35,10 @@ WaveformScope::WaveformScope(QWidget* parent) :
 {
 }
 
-ShaderCode WaveformScope::GenerateShaderCode()
-{
-  return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/rgbwaveform.frag"),
-                    FileFunctions::ReadFileAsString(":/shaders/rgbwaveform.vert"));
-}
-
-void WaveformScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
+void WaveformScope::DrawScope(const ScopeAnalyzer::Result &result)
 {
   float waveform_scale = 0.80f;
 
-  // Draw waveform through shader
-  ShaderJob job;
-
-  // Set viewport size
-  job.Insert(QStringLiteral("viewport"),
-                  NodeValue(NodeValue::kVec2, QVector2D(width(), height())));
-
-  // Set luma coefficients
-  double luma_coeffs[3] = {0.0f, 0.0f, 0.0f};
-  color_manager()->GetDefaultLumaCoefs(luma_coeffs);
-  job.Insert(QStringLiteral("luma_coeffs"),
-                  NodeValue(NodeValue::kVec3, QVector3D(luma_coeffs[0], luma_coeffs[1], luma_coeffs[2])));
-
-
-  // Scale of the waveform relative to the viewport surface.
-  job.Insert(QStringLiteral("waveform_scale"),
-                  NodeValue(NodeValue::kFloat, waveform_scale));
-
-  // Insert source texture
-  job.Insert(QStringLiteral("ove_maintex"),
-                  NodeValue(NodeValue::kTexture, QVariant::fromValue(managed_tex)));
-
-  renderer()->Blit(pipeline, job, GetViewportParams());
-
   float waveform_dim_x = ceil((width() - 1.0) * waveform_scale);
   float waveform_dim_y = ceil((height() - 1.0) * waveform_scale);
   float waveform_start_dim_x =
@@ -82,8 +47,13 @@ void WaveformScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
       ((height() - 1.0) - waveform_dim_y) / 2.0f;
   float waveform_end_dim_x = (width() - 1.0) - waveform_start_dim_x;
 
-  // Draw line overlays
   QPainter p(paint_device());
+
+  // Draw analyzed waveform into the scope area
+  p.setRenderHint(QPainter::SmoothPixmapTransform);
+  p.drawImage(QRectF(waveform_start_dim_x, waveform_start_dim_y, waveform_dim_x, waveform_dim_y), result.waveform);
+
+  // Draw line overlays
   QFont font;
   font.setPixelSize(10);
   QFontMetrics font_metrics = QFontMetrics(font);
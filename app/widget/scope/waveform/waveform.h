@@ -34,9 +34,7 @@ public:
   MANAGEDDISPLAYWIDGET_DEFAULT_DESTRUCTOR(WaveformScope)
 
 protected:
-  virtual ShaderCode GenerateShaderCode() override;
-
-  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline) override;
+  virtual void DrawScope(const ScopeAnalyzer::Result &result) override;
 
 };
 
@@ -32,6 +32,7 @@
 #include "node/project/footage/footage.h"
 #include "panel/panelmanager.h"
 #include "panel/timeline/timeline.h"
+#include "render/thumbnailservice.h"
 #include "ui/colorcoding.h"
 #include "widget/timelinewidget/timelinewidget.h"
 
@@ -57,6 +58,9 @@ TimelineView::TimelineView(Qt::Alignment vertical_alignment, QWidget *parent) :
   viewport()->setMouseTracking(true);
 
   SetIsTimelineAxes(true);
+
+  // Thumbnails are decoded in the background, so repaint when they become available
+  connect(ThumbnailService::instance(), &ThumbnailService::ThumbnailsLoaded, viewport(), static_cast<void(QWidget::*)()>(&QWidget::update));
 }
 
 void TimelineView::mousePressEvent(QMouseEvent *event)
@@ -695,15 +699,23 @@ qreal TimelineView::GetTimelineRightBound() const
 
 void TimelineView::DrawThumbnail(QPainter *painter, const FrameHashCache *thumbs, const rational &time, int x, const QRect &preview_rect, QRect *thumb_rect) const
 {
-  QString thumbnail = thumbs->GetValidCacheFilename(time);
+  QImage img;
+  if (!ThumbnailService::instance()->Get(thumbs, time, &img)) {
+    return;
+  }
 
-  if (!thumbnail.isEmpty()) {
-    QImage img;
-    if (img.load(thumbnail, "jpg")) {
-      double scale = double(preview_rect.height())/double(img.height());
-      *thumb_rect = QRect(x, preview_rect.top(), img.width() * scale, preview_rect.height());
-      painter->drawImage(*thumb_rect, img);
+  if (img.isNull()) {
+    // Still decoding, draw a placeholder the size we expect the thumbnail to be
+    int width = thumb_rect->width();
+    if (width <= 0) {
+      width = preview_rect.height() * 16 / 9;
     }
+    *thumb_rect = QRect(x, preview_rect.top(), width, preview_rect.height());
+    painter->fillRect(*thumb_rect, QColor(0, 0, 0, 64));
+  } else {
+    double scale = double(preview_rect.height())/double(img.height());
+    *thumb_rect = QRect(x, preview_rect.top(), img.width() * scale, preview_rect.height());
+    painter->drawImage(*thumb_rect, img);
   }
 }
 
@@ -41,6 +41,7 @@
 #include "node/project.h"
 #include "panel/multicam/multicampanel.h"
 #include "panel/panelmanager.h"
+#include "render/memorymanager.h"
 #include "render/rendermanager.h"
 #include "viewerpreventsleep.h"
 #include "widget/audiomonitor/audiomonitor.h"
@@ -76,7 +77,8 @@ ViewerWidget::ViewerWidget(ViewerDisplayWidget *display, QWidget *parent) :
   enable_audio_scrubbing_(true),
   waveform_mode_(kWFAutomatic),
   ignore_scrub_(0),
-  multicam_panel_(nullptr)
+  multicam_panel_(nullptr),
+  full_frame_required_(0)
 {
   // Set up main layout
   QVBoxLayout* layout = new QVBoxLayout(this);
@@ -99,6 +101,7 @@ ViewerWidget::ViewerWidget(ViewerDisplayWidget *display, QWidget *parent) :
   connect(display_widget_, &ViewerDisplayWidget::QueueStarved, this, &ViewerWidget::QueueStarved);
   connect(display_widget_, &ViewerDisplayWidget::QueueNoLongerStarved, this, &ViewerWidget::QueueNoLongerStarved);
   connect(display_widget_, &ViewerDisplayWidget::CreateAddableAt, this, &ViewerWidget::CreateAddableAt);
+  connect(display_widget_, &ViewerDisplayWidget::VisibleRegionChanged, this, &ViewerWidget::VisibleRegionChanged);
   connect(sizer_, &ViewerSizer::RequestScale, display_widget_, &ViewerDisplayWidget::SetMatrixZoom);
   connect(sizer_, &ViewerSizer::RequestTranslate, display_widget_, &ViewerDisplayWidget::SetMatrixTranslate);
   connect(display_widget_, &ViewerDisplayWidget::HandDragMoved, sizer_, &ViewerSizer::HandDragMove);
@@ -316,7 +319,73 @@ void ViewerWidget::resizeEvent(QResizeEvent *event)
 
 RenderTicketPtr ViewerWidget::GetSingleFrame(const rational &t, bool dry)
 {
-  return RenderManager::instance()->GetCacher()->GetSingleFrame(this->GetConnectedNode(), t, dry);
+  QRectF roi;
+  if (!dry) {
+    roi = GetRegionOfInterest();
+    requested_region_ = roi;
+  }
+
+  return RenderManager::instance()->GetCacher()->GetSingleFrame(this->GetConnectedNode(), t, dry, roi, GetPlaybackDivider());
+}
+
+int ViewerWidget::GetPlaybackDivider() const
+{
+  // Paused frames are always rendered at the sequence's full quality
+  if (IsPlaying() && OLIVE_CONFIG("AutoPlaybackResolution").toBool() && quality_governor_.IsReduced()) {
+    return quality_governor_.GetDivider();
+  }
+
+  return 0;
+}
+
+void ViewerWidget::UpdatePlaybackDividerDisplay()
+{
+  int d = IsPlaying() && OLIVE_CONFIG("AutoPlaybackResolution").toBool() ? quality_governor_.GetDivider() : 0;
+
+  foreach (ViewerDisplayWidget *dw, playback_devices_) {
+    dw->SetPlaybackDivider(d);
+  }
+}
+
+QRectF ViewerWidget::GetRegionOfInterest() const
+{
+  if (full_frame_required_ > 0) {
+    return QRectF();
+  }
+
+  QRectF visible;
+  foreach (ViewerDisplayWidget *dw, playback_devices_) {
+    if (dynamic_cast<MulticamDisplay*>(dw)) {
+      return QRectF();
+    }
+
+    visible = visible.united(dw->GetVisibleRegion());
+  }
+
+  // Render some margin around what's visible so small pans don't need a new frame
+  const double margin = 0.25;
+  QRectF roi = visible.adjusted(-visible.width() * margin, -visible.height() * margin,
+                                visible.width() * margin, visible.height() * margin).intersected(QRectF(0, 0, 1, 1));
+
+  // Not worth it if most of the frame is needed anyway
+  if (roi.width() * roi.height() > 0.75) {
+    return QRectF();
+  }
+
+  return roi;
+}
+
+void ViewerWidget::VisibleRegionChanged()
+{
+  if (IsPlaying() || requested_region_.isNull()) {
+    // Playback picks up the new region on the next frame, and full frames are always sufficient
+    return;
+  }
+
+  QRectF roi = GetRegionOfInterest();
+  if (roi.isNull() || !requested_region_.contains(roi)) {
+    UpdateTextureFromNode();
+  }
 }
 
 void ViewerWidget::TogglePlayPause()
@@ -375,6 +444,7 @@ void ViewerWidget::SetFullScreen(QScreen *screen)
   vw->display_widget()->ConnectColorManager(color_manager());
   connect(vw, &ViewerWindow::destroyed, this, &ViewerWidget::WindowAboutToClose);
   connect(vw->display_widget(), &ViewerDisplayWidget::customContextMenuRequested, this, &ViewerWidget::ShowContextMenu);
+  connect(vw->display_widget(), &ViewerDisplayWidget::VisibleRegionChanged, this, &ViewerWidget::VisibleRegionChanged);
 
   if (GetConnectedNode()) {
     vw->SetVideoParams(GetConnectedNode()->GetVideoParams());
@@ -385,6 +455,9 @@ void ViewerWidget::SetFullScreen(QScreen *screen)
 
   playback_devices_.append(vw->display_widget());
 
+  // The new window likely shows more of the image than was rendered for the existing displays
+  VisibleRegionChanged();
+
   (*vw->display_widget()->queue()) = *playback_devices_.first()->queue();
   if (IsPlaying()) {
     vw->display_widget()->Play(GetTimestamp(), playback_speed_, timebase(), true);
@@ -774,6 +847,7 @@ void ViewerWidget::ReceivedAudioBufferForPlayback()
             if (prequeuing_audio_) {
               // Add to prequeued audio buffer
               prequeued_audio_.append(pack);
+              MemoryManager::Allocated(MemoryManager::kAudioPrequeue, pack.size());
             } else {
               // Push directly to audio manager
               AudioManager::instance()->PushToOutput(audio_processor_.to(), pack);
@@ -838,6 +912,11 @@ void ViewerWidget::QueueStarved()
 
   if (!queue_starved_start_) {
     queue_starved_start_ = now;
+
+    // Drop resolution right away rather than waiting for the render times to catch up
+    if (OLIVE_CONFIG("AutoPlaybackResolution").toBool() && quality_governor_.Starved()) {
+      UpdatePlaybackDividerDisplay();
+    }
   } else if (now > queue_starved_start_ + kMaximumWaitTimeMs) {
     if (first_requeue_watcher_) {
       if (GetConnectedNode()->GetPlayhead() + kMaximumWaitTime < first_requeue_watcher_->property("time").value<rational>()) {
@@ -963,6 +1042,9 @@ void ViewerWidget::PlayInternal(int speed, bool in_to_out_only)
 
   queue_starved_start_ = 0;
 
+  quality_governor_.Start(GetConnectedNode()->GetVideoParams().divider(), timebase());
+  UpdatePlaybackDividerDisplay();
+
   // Attempt to fill playback queue
   if (IsVideoVisible()) {
     prequeue_length_ = DeterminePlaybackQueueSize();
@@ -1027,6 +1109,7 @@ void ViewerWidget::PauseInternal()
     // Handle audio
     AudioManager::instance()->StopOutput();
     AudioMonitor::StopOnAll();
+    MemoryManager::Released(MemoryManager::kAudioPrequeue, prequeued_audio_.size());
     prequeued_audio_.clear();
     disconnect(AudioManager::instance(), &AudioManager::OutputNotify, this, &ViewerWidget::QueueNextAudioBuffer);
     qDeleteAll(audio_playback_queue_);
@@ -1035,6 +1118,8 @@ void ViewerWidget::PauseInternal()
 
     RenderManager::instance()->GetCacher()->SetThumbnailsPaused(false);
 
+    // Frame will be re-rendered at full quality since we're no longer playing
+    UpdatePlaybackDividerDisplay();
     UpdateTextureFromNode();
 
     RenderManager::instance()->SetAggressiveGarbageCollection(false);
@@ -1139,6 +1224,7 @@ RenderTicketWatcher *ViewerWidget::RequestNextFrameForQueue(bool increment)
 
     watcher = new RenderTicketWatcher();
     watcher->setProperty("time", QVariant::fromValue(next_time));
+    watcher->setProperty("divider", quality_governor_.GetDivider());
     DetectMulticamNode(next_time);
     connect(watcher, &RenderTicketWatcher::Finished, this, &ViewerWidget::RendererGeneratedFrameForQueue);
     queue_watchers_.append(watcher);
@@ -1157,6 +1243,7 @@ RenderTicketPtr ViewerWidget::GetFrame(const rational &t)
     return GetSingleFrame(t);
   } else {
     // Frame has been cached, grab the frame
+    requested_region_ = QRectF();
     RenderTicketPtr ticket = std::make_shared<RenderTicket>();
     ticket->setProperty("time", QVariant::fromValue(t));
     QtConcurrent::run(static_cast<void(*)(RenderTicketPtr, const QString &, const QUuid &, const int64_t &)>(ViewerWidget::DecodeCachedImage), ticket, GetConnectedNode()->video_frame_cache()->GetCacheDirectory(), GetConnectedNode()->video_frame_cache()->GetUuid(), Timecode::time_to_timestamp(t, timebase(), Timecode::kFloor));
@@ -1180,6 +1267,7 @@ void ViewerWidget::FinishPlayPreprocess()
       QMessageBox::critical(this, tr("Audio Error"), tr("Failed to start audio: %1\n\n"
                                                         "Please check your audio preferences and try again.").arg(error));
     }
+    MemoryManager::Released(MemoryManager::kAudioPrequeue, prequeued_audio_.size());
     prequeued_audio_.clear();
 
     AudioMonitor::StartWaveformOnAll(GetConnectedNode()->GetConnectedWaveform(),
@@ -1238,6 +1326,12 @@ void ViewerWidget::ContextMenuSetPlaybackRes(QAction *action)
   Core::instance()->undo_stack()->push(c, tr("Changed Playback Resolution"));
 }
 
+void ViewerWidget::ContextMenuSetAutoPlaybackRes(bool e)
+{
+  OLIVE_CONFIG("AutoPlaybackResolution") = e;
+  UpdatePlaybackDividerDisplay();
+}
+
 void ViewerWidget::ContextMenuDisableSafeMargins()
 {
   context_menu_widget_->SetSafeMargins(ViewerSafeMarginInfo(false));
@@ -1302,6 +1396,13 @@ void ViewerWidget::RendererGeneratedFrameForQueue()
       if (IsPlaying() || prequeuing_video_) {
         rational ts = watcher->property("time").value<rational>();
 
+        // Frames decoded from the disk cache have no render time and don't tell us anything
+        QVariant render_time = watcher->GetTicket()->property("rendertime");
+        if (render_time.isValid() && OLIVE_CONFIG("AutoPlaybackResolution").toBool()
+            && quality_governor_.AddSample(render_time.toLongLong(), watcher->property("divider").toInt())) {
+          UpdatePlaybackDividerDisplay();
+        }
+
         foreach (ViewerDisplayWidget *dw, playback_devices_) {
           QVariant push;
           if (dynamic_cast<MulticamDisplay*>(dw)) {
@@ -1417,6 +1518,11 @@ void ViewerWidget::ShowContextMenu(const QPoint &pos)
       }
 
       connect(playback_res_menu, &QMenu::triggered, this, &ViewerWidget::ContextMenuSetPlaybackRes);
+
+      QAction *auto_res_action = menu.addAction(tr("Lower Resolution To Maintain Frame Rate"));
+      auto_res_action->setCheckable(true);
+      auto_res_action->setChecked(OLIVE_CONFIG("AutoPlaybackResolution").toBool());
+      connect(auto_res_action, &QAction::triggered, this, &ViewerWidget::ContextMenuSetAutoPlaybackRes);
     }
 
     {
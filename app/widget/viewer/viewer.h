@@ -34,6 +34,7 @@
 #include "render/previewaudiodevice.h"
 #include "render/previewautocacher.h"
 #include "viewerdisplay.h"
+#include "viewerqualitygovernor.h"
 #include "viewersizer.h"
 #include "viewerwindow.h"
 #include "widget/playbackcontrols/playbackcontrols.h"
@@ -106,6 +107,18 @@ public:
   void AddPlaybackDevice(ViewerDisplayWidget *vw)
   {
     playback_devices_.push_back(vw);
+    connect(vw, &ViewerDisplayWidget::VisibleRegionChanged, this, &ViewerWidget::VisibleRegionChanged);
+  }
+
+  /**
+   * @brief Always render entire frames rather than only the region visible in the displays
+   *
+   * Calls are counted, every call enabling this must be matched by one disabling it. Used by
+   * anything that reads the whole displayed texture, e.g. scopes.
+   */
+  void SetFullFrameRequired(bool e)
+  {
+    full_frame_required_ += e ? 1 : -1;
   }
 
   void SetTimelineSelectedBlocks(const QVector<Block*> &b)
@@ -228,6 +241,15 @@ private:
 
   void UpdateTimeInternal(int64_t i);
 
+  QRectF GetRegionOfInterest() const;
+
+  /**
+   * @brief Divider to render playback frames at, or 0 to use the sequence's own
+   */
+  int GetPlaybackDivider() const;
+
+  void UpdatePlaybackDividerDisplay();
+
   void PlayInternal(int speed, bool in_to_out_only);
 
   void PauseInternal();
@@ -334,6 +356,8 @@ private:
   qint64 queue_starved_start_;
   RenderTicketWatcher *first_requeue_watcher_;
 
+  ViewerQualityGovernor quality_governor_;
+
   bool enable_audio_scrubbing_;
 
   WaveformMode waveform_mode_;
@@ -347,6 +371,10 @@ private:
 
   MulticamWidget *multicam_panel_;
 
+  int full_frame_required_;
+
+  QRectF requested_region_;
+
 private slots:
   void PlaybackTimerUpdate();
 
@@ -368,6 +396,8 @@ private slots:
 
   void ContextMenuSetPlaybackRes(QAction* action);
 
+  void ContextMenuSetAutoPlaybackRes(bool e);
+
   void ContextMenuDisableSafeMargins();
 
   void ContextMenuSetSafeMargins();
@@ -415,6 +445,8 @@ private slots:
 
   void DetectMulticamNodeNow();
 
+  void VisibleRegionChanged();
+
 };
 
 }
@@ -63,6 +63,7 @@ ViewerDisplayWidget::ViewerDisplayWidget(QWidget *parent) :
   deinterlace_(false),
   show_fps_(false),
   frames_skipped_(0),
+  playback_divider_(0),
   show_widget_background_(false),
   playback_speed_(0),
   push_mode_(kPushNull),
@@ -107,6 +108,8 @@ void ViewerDisplayWidget::SetMatrixCrop(const QMatrix4x4 &mat)
   crop_matrix_ = mat;
 
   update();
+
+  emit VisibleRegionChanged();
 }
 
 void ViewerDisplayWidget::UpdateCursor()
@@ -532,9 +535,17 @@ void ViewerDisplayWidget::OnPaint()
 
       DrawTextWithCrudeShadow(&p, GetInnerRect(), tr("%1 FPS").arg(QString::number(average, 'f', 1)));
 
+      int line = 1;
+
       if (frames_skipped_ > 0) {
-        DrawTextWithCrudeShadow(&p, GetInnerRect().adjusted(0, p.fontMetrics().height(), 0, 0),
+        DrawTextWithCrudeShadow(&p, GetInnerRect().adjusted(0, p.fontMetrics().height() * line, 0, 0),
                                 tr("%1 frames skipped").arg(frames_skipped_));
+        line++;
+      }
+
+      if (playback_divider_ > 0) {
+        DrawTextWithCrudeShadow(&p, GetInnerRect().adjusted(0, p.fontMetrics().height() * line, 0, 0),
+                                tr("Resolution: %1").arg(VideoParams::GetNameForDivider(playback_divider_)));
       }
     }
   }
@@ -617,6 +628,27 @@ void ViewerDisplayWidget::UpdateMatrix()
   combined_matrix_flipped_ *= combined_matrix_;
 
   update();
+
+  emit VisibleRegionChanged();
+}
+
+QRectF ViewerDisplayWidget::GetVisibleRegion() const
+{
+  // Mirrors the mapping in colormanage.frag: the display's clip space is mapped back onto the
+  // drawn quad, then through the crop into the texture
+  bool invertible;
+  QMatrix4x4 to_quad = combined_matrix_flipped_.inverted(&invertible);
+  if (!invertible) {
+    return QRectF(0, 0, 1, 1);
+  }
+
+  QMatrix4x4 to_cropped = crop_matrix_.inverted().transposed();
+
+  QRectF quad = to_quad.mapRect(QRectF(-1, -1, 2, 2));
+  QRectF uncropped((quad.x() + 1.0) * 0.5 - 0.5, (quad.y() + 1.0) * 0.5 - 0.5,
+                   quad.width() * 0.5, quad.height() * 0.5);
+
+  return to_cropped.mapRect(uncropped).translated(0.5, 0.5).intersected(QRectF(0, 0, 1, 1));
 }
 
 QTransform ViewerDisplayWidget::GenerateWorldTransform()
@@ -112,6 +112,16 @@ public:
 
   void IncrementSkippedFrames();
 
+  /**
+   * @brief Set the divider playback is currently being rendered at to show in the FPS overlay
+   *
+   * Set to 0 to hide it.
+   */
+  void SetPlaybackDivider(int d)
+  {
+    playback_divider_ = d;
+  }
+
   void IncrementFrameCount()
   {
     fps_timer_update_count_++;
@@ -122,6 +132,13 @@ public:
     return texture_;
   }
 
+  /**
+   * @brief Area of the image currently visible in this display in normalized texture coordinates
+   *
+   * Accounts for zoom, translation and crop.
+   */
+  QRectF GetVisibleRegion() const;
+
   void Play(const int64_t &start_timestamp, const int &playback_speed, const rational &timebase, bool start_updating);
 
   void Pause();
@@ -225,6 +242,11 @@ signals:
 
   void CreateAddableAt(const QRectF &rect);
 
+  /**
+   * @brief Emitted when the zoom, translation or crop changes what part of the image is visible
+   */
+  void VisibleRegionChanged();
+
 protected:
   QTransform GenerateWorldTransform();
 
@@ -382,6 +404,7 @@ private:
 
   bool show_fps_;
   int frames_skipped_;
+  int playback_divider_;
 
   QVector<double> frame_rate_averages_;
   int frame_rate_average_count_;
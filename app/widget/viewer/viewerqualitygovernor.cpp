@@ -0,0 +1,123 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "viewerqualitygovernor.h"
+
+#include "render/videoparams.h"
+
+namespace olive {
+
+// Number of frames to observe at a level before deciding to change it again
+const int kMinimumSamples = 4;
+
+// Weight of each new sample in the moving average
+const double kAverageWeight = 0.25;
+
+// Fraction of the frame budget a frame may take before dropping resolution. Leaves some room for
+// compositing and uploading the frame to the display.
+const double kDropThreshold = 0.9;
+
+// Fraction of the frame budget the next resolution up is predicted to take before raising it
+const double kRaiseThreshold = 0.6;
+
+ViewerQualityGovernor::ViewerQualityGovernor() :
+  base_divider_(1),
+  base_level_(0),
+  level_(0),
+  budget_ms_(0),
+  average_ms_(0),
+  samples_since_change_(0)
+{
+}
+
+void ViewerQualityGovernor::Start(int base_divider, const rational &timebase)
+{
+  base_divider_ = base_divider;
+
+  // Start at the first supported divider that's at least as low in quality as the base
+  base_level_ = VideoParams::kSupportedDividers.size() - 1;
+  for (int i=0; i<VideoParams::kSupportedDividers.size(); i++) {
+    if (VideoParams::kSupportedDividers.at(i) >= base_divider) {
+      base_level_ = i;
+      break;
+    }
+  }
+
+  level_ = base_level_;
+  budget_ms_ = timebase.toDouble() * 1000.0;
+  average_ms_ = 0;
+  samples_since_change_ = 0;
+}
+
+bool ViewerQualityGovernor::AddSample(qint64 render_time_ms, int divider)
+{
+  if (budget_ms_ <= 0 || divider != GetDivider()) {
+    return false;
+  }
+
+  if (samples_since_change_ == 0) {
+    average_ms_ = render_time_ms;
+  } else {
+    average_ms_ = average_ms_ * (1.0 - kAverageWeight) + render_time_ms * kAverageWeight;
+  }
+  samples_since_change_++;
+
+  if (samples_since_change_ < kMinimumSamples) {
+    return false;
+  }
+
+  if (average_ms_ > budget_ms_ * kDropThreshold) {
+    return SetLevel(level_ + 1);
+  }
+
+  if (level_ > base_level_) {
+    // Render time scales roughly with pixel count, so predict what the next level up would cost
+    double ratio = double(VideoParams::kSupportedDividers.at(level_)) / double(VideoParams::kSupportedDividers.at(level_ - 1));
+    if (average_ms_ * ratio * ratio < budget_ms_ * kRaiseThreshold) {
+      return SetLevel(level_ - 1);
+    }
+  }
+
+  return false;
+}
+
+bool ViewerQualityGovernor::Starved()
+{
+  return SetLevel(level_ + 1);
+}
+
+int ViewerQualityGovernor::GetDivider() const
+{
+  return qMax(base_divider_, VideoParams::kSupportedDividers.at(level_));
+}
+
+bool ViewerQualityGovernor::SetLevel(int level)
+{
+  level = qBound(base_level_, level, int(VideoParams::kSupportedDividers.size()) - 1);
+
+  if (level == level_) {
+    return false;
+  }
+
+  level_ = level;
+  samples_since_change_ = 0;
+  return true;
+}
+
+}
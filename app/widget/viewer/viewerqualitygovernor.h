@@ -0,0 +1,96 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef VIEWERQUALITYGOVERNOR_H
+#define VIEWERQUALITYGOVERNOR_H
+
+#include <QtGlobal>
+
+#include "common/rational.h"
+
+namespace olive {
+
+/**
+ * @brief Chooses a playback resolution divider that keeps rendering within the frame budget
+ *
+ * Fed with the time the renderer took for each frame queued during playback, the governor
+ * raises the divider when frames take longer than the sequence's frame interval and lowers it
+ * again once there's enough headroom for the next resolution up. It never goes below the
+ * divider the user chose for the sequence.
+ */
+class ViewerQualityGovernor
+{
+public:
+  ViewerQualityGovernor();
+
+  /**
+   * @brief Reset for a new playback session
+   *
+   * @param base_divider
+   *
+   * The sequence's own divider, used as the highest quality the governor will pick.
+   */
+  void Start(int base_divider, const rational &timebase);
+
+  /**
+   * @brief Provide the time in milliseconds the renderer took to produce one frame
+   *
+   * @param divider
+   *
+   * The divider GetDivider() returned when the frame was requested. Frames still in flight from
+   * before the last change say nothing about the current divider, so they're ignored.
+   *
+   * @return True if the divider changed as a result of this sample
+   */
+  bool AddSample(qint64 render_time_ms, int divider);
+
+  /**
+   * @brief Notify that the playback queue ran dry, which drops quality immediately
+   *
+   * @return True if the divider changed
+   */
+  bool Starved();
+
+  int GetDivider() const;
+
+  bool IsReduced() const
+  {
+    return GetDivider() != base_divider_;
+  }
+
+private:
+  bool SetLevel(int level);
+
+  int base_divider_;
+
+  int base_level_;
+
+  int level_;
+
+  double budget_ms_;
+
+  double average_ms_;
+
+  int samples_since_change_;
+
+};
+
+}
+
+#endif // VIEWERQUALITYGOVERNOR_H
@@ -23,6 +23,8 @@
 #include <QActionGroup>
 #include <QDesktopServices>
 #include <QEvent>
+#include <QFileDialog>
+#include <QMessageBox>
 #include <QStyleFactory>
 
 #include "config/config.h"
@@ -31,6 +33,7 @@
 #include "dialog/diskcache/diskcachedialog.h"
 #include "dialog/task/task.h"
 #include "panel/panelmanager.h"
+#include "render/rendertrace.h"
 #include "tool/tool.h"
 #include "ui/style/style.h"
 #include "undo/undostack.h"
@@ -279,6 +282,9 @@ MainMenu::MainMenu(MainWindow *parent) :
 
   tools_menu_->addSeparator();
 
+  tools_render_trace_item_ = tools_menu_->AddItem("rendertrace", this, &MainMenu::RenderTraceTriggered);
+  tools_render_trace_item_->setCheckable(true);
+
   tools_preferences_item_ = tools_menu_->AddItem("prefs", Core::instance(), &Core::DialogPreferencesShow, tr("Ctrl+,"));
 
 #ifndef NDEBUG
@@ -379,6 +385,8 @@ void MainMenu::ToolsMenuAboutToShow()
 
   // Ensure snapping value is correct
   tools_snapping_item_->setChecked(Core::instance()->snapping());
+
+  tools_render_trace_item_->setChecked(RenderTrace::IsEnabled());
 }
 
 void MainMenu::PlaybackMenuAboutToShow()
@@ -684,6 +692,27 @@ void MainMenu::HelpFeedbackTriggered()
   QDesktopServices::openUrl(QStringLiteral("https://github.com/olive-editor/olive/issues"));
 }
 
+void MainMenu::RenderTraceTriggered(bool e)
+{
+  if (e) {
+    RenderTrace::SetEnabled(true);
+    return;
+  }
+
+  RenderTrace::SetEnabled(false);
+
+  QString fn = QFileDialog::getSaveFileName(parentWidget(), tr("Save Render Trace"), QString(), tr("Trace Files (*.json)"));
+  if (!fn.isEmpty()) {
+    if (!fn.endsWith(QStringLiteral(".json"), Qt::CaseInsensitive)) {
+      fn.append(QStringLiteral(".json"));
+    }
+
+    if (!RenderTrace::Export(fn)) {
+      QMessageBox::critical(parentWidget(), tr("Error saving render trace"), tr("Failed to open file for writing"));
+    }
+  }
+}
+
 void MainMenu::Retranslate()
 {
   // MenuShared is not a QWidget and therefore does not receive a LanguageEvent, we use MainMenu's to update it
@@ -778,6 +807,7 @@ void MainMenu::Retranslate()
   tools_add_item_->setText(tr("Add Tool"));
   tools_record_item_->setText(tr("Record Tool"));
   tools_snapping_item_->setText(tr("Enable Snapping"));
+  tools_render_trace_item_->setText(tr("Record Render Trace"));
   tools_preferences_item_->setText(tr("Preferences"));
   tools_add_item_menu_->setTitle(tr("Add Tool Item"));
 #ifndef NDEBUG
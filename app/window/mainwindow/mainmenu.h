@@ -188,6 +188,11 @@ private slots:
 
   void HelpFeedbackTriggered();
 
+  /**
+   * @brief Starts recording a render trace, or stops and asks where to save it
+   */
+  void RenderTraceTriggered(bool e);
+
 private:
   /**
    * @brief Set strings based on the current application language.
@@ -280,6 +285,7 @@ private:
   QAction* tools_add_item_;
   QAction* tools_record_item_;
   QAction* tools_snapping_item_;
+  QAction* tools_render_trace_item_;
   QAction* tools_preferences_item_;
   Menu *tools_add_item_menu_;
 
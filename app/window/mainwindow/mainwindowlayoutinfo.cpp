@@ -183,4 +183,33 @@ void MainWindowLayoutInfo::set_state(const QByteArray &layout)
   state_ = layout;
 }
 
+MainWindowLayoutInfo MainWindowLayoutInfo::MapNodes(const QHash<Node *, Node *> &nodes) const
+{
+  MainWindowLayoutInfo info = *this;
+
+  info.open_folders_.clear();
+  info.open_sequences_.clear();
+  info.open_viewers_.clear();
+
+  foreach (Folder *folder, open_folders_) {
+    if (Node *n = nodes.value(folder)) {
+      info.add_folder(static_cast<Folder*>(n));
+    }
+  }
+
+  foreach (Sequence *sequence, open_sequences_) {
+    if (Node *n = nodes.value(sequence)) {
+      info.add_sequence(static_cast<Sequence*>(n));
+    }
+  }
+
+  foreach (ViewerOutput *viewer, open_viewers_) {
+    if (Node *n = nodes.value(viewer)) {
+      info.add_viewer(static_cast<ViewerOutput*>(n));
+    }
+  }
+
+  return info;
+}
+
 }
@@ -28,6 +28,12 @@ public:
 
   void set_state(const QByteArray& layout);
 
+  /**
+   * @brief Copy of this layout with its folders, sequences and viewers swapped for what they map
+   * to in `nodes`, e.g. the copies made by Project::CreateSnapshot()
+   */
+  MainWindowLayoutInfo MapNodes(const QHash<Node*, Node*> &nodes) const;
+
   const std::vector<Folder*>& open_folders() const
   {
     return open_folders_;
@@ -0,0 +1,607 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include <cmath>
+#include <iostream>
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSurfaceFormat>
+#include <QTemporaryDir>
+
+#include "audio/audiovisualwaveform.h"
+#include "codec/conformmanager.h"
+#include "codec/frame.h"
+#include "node/audio/volume/volume.h"
+#include "node/block/clip/clip.h"
+#include "node/distort/transform/transformdistortnode.h"
+#include "node/factory.h"
+#include "node/filter/blur/blur.h"
+#include "node/generator/solid/solid.h"
+#include "node/generator/text/textv3.h"
+#include "node/project.h"
+#include "node/project/sequence/sequence.h"
+#include "node/project/serializer/serializer.h"
+#include "node/traverser.h"
+#include "render/framehashcache.h"
+#include "render/framemanager.h"
+#include "render/rendermanager.h"
+#include "task/taskmanager.h"
+#include "timeline/timelineundogeneral.h"
+
+namespace olive {
+
+struct BenchmarkParams
+{
+  int video_tracks;
+  int audio_tracks;
+  int frames;
+  int width;
+  int height;
+  bool gpu;
+};
+
+class Benchmark
+{
+public:
+  Benchmark(const BenchmarkParams &params) :
+    params_(params)
+  {
+  }
+
+  /**
+   * @brief Run every benchmark and collect results
+   *
+   * @return False if any benchmark failed to produce a result
+   */
+  bool Run();
+
+  QJsonDocument ToJson() const;
+
+  /**
+   * @brief Compare results against a previous run
+   *
+   * @return Number of results that were worse than the baseline by more than the tolerance, or
+   * that were missing from either this run or the baseline
+   */
+  int CompareToBaseline(const QJsonDocument &baseline, double tolerance) const;
+
+private:
+  struct Result
+  {
+    QString name;
+    double value;
+    QString unit;
+    bool higher_is_better;
+  };
+
+  void AddResult(const QString &name, double value, const QString &unit, bool higher_is_better);
+
+  Sequence *CreateSyntheticSequence(Project *project);
+
+  bool BenchTraversal(Sequence *sequence);
+  bool BenchRender(Sequence *sequence);
+  bool BenchAudioMixdown(Sequence *sequence);
+  bool BenchWaveform(const AudioParams &params);
+  bool BenchFrameCache(const VideoParams &params);
+  bool BenchProjectSaveLoad(Project *project);
+
+  /**
+   * @brief Number of frames to sample from each section, starting at its beginning
+   */
+  int GetSectionFrameCount(const rational &timebase) const;
+
+  static double Seconds(const QElapsedTimer &timer)
+  {
+    return double(timer.nsecsElapsed()) / 1000000000.0;
+  }
+
+  BenchmarkParams params_;
+
+  QVector<Result> results_;
+
+  QTemporaryDir temp_dir_;
+
+};
+
+// Length of each synthetic section: clips, then a still, then a title
+const rational kSectionLength(10);
+
+// Video benchmarks are reported per section since each one exercises a different render path
+const QString kSectionNames[] = {QStringLiteral("clips"), QStringLiteral("still"), QStringLiteral("title")};
+const int kSectionCount = 3;
+
+SampleBuffer CreateTone(const AudioParams &params, const rational &length)
+{
+  SampleBuffer tone(params, params.time_to_samples(length));
+
+  for (int c=0; c<params.channel_count(); c++) {
+    float *data = tone.data(c);
+    for (size_t i=0; i<tone.sample_count(); i++) {
+      data[i] = 0.5f * std::sin(2.0 * M_PI * 440.0 * double(i) / double(params.sample_rate()));
+    }
+  }
+
+  return tone;
+}
+
+Sequence *Benchmark::CreateSyntheticSequence(Project *project)
+{
+  Sequence *sequence = new Sequence();
+  sequence->setParent(project);
+
+  sequence->SetVideoParams(VideoParams(params_.width, params_.height, rational(1, 30),
+                                       PixelFormat::F16, VideoParams::kInternalChannelCount));
+  sequence->SetAudioParams(AudioParams(48000, AV_CH_LAYOUT_STEREO, ViewerOutput::kDefaultSampleFormat));
+
+  for (int i=0; i<params_.video_tracks; i++) {
+    Track *track = TimelineAddTrackCommand::RunImmediately(sequence->track_list(Track::kVideo), true);
+
+    // Generated footage through a transform and a blur
+    SolidGenerator *solid = new SolidGenerator();
+    solid->setParent(project);
+
+    TransformDistortNode *transform = new TransformDistortNode();
+    transform->setParent(project);
+    transform->SetStandardValue(TransformDistortNode::kRotationInput, 15.0 * (i + 1));
+    Node::ConnectEdge(solid, NodeInput(transform, TransformDistortNode::kTextureInput));
+
+    BlurFilterNode *blur = new BlurFilterNode();
+    blur->setParent(project);
+    blur->SetStandardValue(BlurFilterNode::kMethodInput, BlurFilterNode::kGaussian);
+    Node::ConnectEdge(transform, NodeInput(blur, BlurFilterNode::kTextureInput));
+
+    ClipBlock *clip = new ClipBlock();
+    clip->setParent(project);
+    clip->set_length_and_media_out(kSectionLength);
+    Node::ConnectEdge(blur, NodeInput(clip, ClipBlock::kBufferIn));
+    track->AppendBlock(clip);
+
+    if (i == 0) {
+      // Long still section with no effects
+      SolidGenerator *still = new SolidGenerator();
+      still->setParent(project);
+
+      ClipBlock *still_clip = new ClipBlock();
+      still_clip->setParent(project);
+      still_clip->set_length_and_media_out(kSectionLength);
+      Node::ConnectEdge(still, NodeInput(still_clip, ClipBlock::kBufferIn));
+      track->AppendBlock(still_clip);
+
+      // Long title section
+      TextGeneratorV3 *title = new TextGeneratorV3();
+      title->setParent(project);
+
+      ClipBlock *title_clip = new ClipBlock();
+      title_clip->setParent(project);
+      title_clip->set_length_and_media_out(kSectionLength);
+      Node::ConnectEdge(title, NodeInput(title_clip, ClipBlock::kBufferIn));
+      track->AppendBlock(title_clip);
+    }
+  }
+
+  // There's no audio generator node, so a one second tone is set directly as the volume node's
+  // sample input. Audio is rendered in one second chunks below so it lines up.
+  SampleBuffer tone = CreateTone(sequence->GetAudioParams(), rational(1));
+
+  for (int i=0; i<params_.audio_tracks; i++) {
+    Track *track = TimelineAddTrackCommand::RunImmediately(sequence->track_list(Track::kAudio), true);
+
+    VolumeNode *volume = new VolumeNode();
+    volume->setParent(project);
+    volume->SetStandardValue(VolumeNode::kSamplesInput, QVariant::fromValue(tone));
+
+    // Keyframed fade so the volume has to be evaluated per sample
+    volume->SetInputIsKeyframing(VolumeNode::kVolumeInput, true);
+    new NodeKeyframe(0, 0.0, NodeKeyframe::kLinear, 0, -1, VolumeNode::kVolumeInput, volume);
+    new NodeKeyframe(kSectionLength, 1.0, NodeKeyframe::kLinear, 0, -1, VolumeNode::kVolumeInput, volume);
+
+    ClipBlock *clip = new ClipBlock();
+    clip->setParent(project);
+    clip->set_length_and_media_out(kSectionLength);
+    Node::ConnectEdge(volume, NodeInput(clip, ClipBlock::kBufferIn));
+    track->AppendBlock(clip);
+  }
+
+  return sequence;
+}
+
+void Benchmark::AddResult(const QString &name, double value, const QString &unit, bool higher_is_better)
+{
+  results_.append({name, value, unit, higher_is_better});
+
+  std::cout << name.toStdString() << ": " << value << " " << unit.toStdString() << std::endl;
+}
+
+int Benchmark::GetSectionFrameCount(const rational &timebase) const
+{
+  return qMin(params_.frames, int(std::floor((kSectionLength / timebase).toDouble())));
+}
+
+bool Benchmark::BenchTraversal(Sequence *sequence)
+{
+  // Traverse without resolving any jobs, so this is the cost of walking the graph alone
+  NodeTraverser traverser;
+  traverser.SetCacheVideoParams(sequence->GetVideoParams());
+  traverser.SetCacheAudioParams(sequence->GetAudioParams());
+
+  rational tb = sequence->GetVideoParams().frame_rate_as_time_base();
+  int frames = GetSectionFrameCount(tb);
+
+  for (int s=0; s<kSectionCount; s++) {
+    rational section_start = kSectionLength * s;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i=0; i<frames; i++) {
+      rational t = section_start + tb * i;
+      traverser.GenerateTable(sequence->GetConnectedTextureOutput(), TimeRange(t, t + tb));
+    }
+
+    AddResult(QStringLiteral("traversal_video_%1").arg(kSectionNames[s]), Seconds(timer) * 1000.0 / frames, QStringLiteral("ms/frame"), false);
+  }
+
+  return true;
+}
+
+bool Benchmark::BenchRender(Sequence *sequence)
+{
+  rational tb = sequence->GetVideoParams().frame_rate_as_time_base();
+  int frames = GetSectionFrameCount(tb);
+
+  for (int s=0; s<kSectionCount; s++) {
+    rational section_start = kSectionLength * s;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Frames are requested one at a time and read back, as an export would
+    for (int i=0; i<frames; i++) {
+      RenderManager::RenderVideoParams rvp(sequence->GetConnectedTextureOutput(),
+                                           sequence->GetVideoParams(),
+                                           sequence->GetAudioParams(),
+                                           section_start + tb * i,
+                                           sequence->project()->color_manager(),
+                                           RenderMode::kOffline);
+      rvp.return_type = RenderManager::kFrame;
+
+      RenderTicketPtr ticket = RenderManager::instance()->RenderFrame(rvp);
+      ticket->WaitForFinished();
+
+      if (!ticket->HasResult() || !ticket->Get().value<FramePtr>()) {
+        std::cerr << "Failed to render frame " << i << " of section " << kSectionNames[s].toStdString() << std::endl;
+        return false;
+      }
+    }
+
+    AddResult(QStringLiteral("render_video_%1").arg(kSectionNames[s]), frames / Seconds(timer), QStringLiteral("fps"), true);
+  }
+
+  return true;
+}
+
+bool Benchmark::BenchAudioMixdown(Sequence *sequence)
+{
+  const AudioParams &params = sequence->GetAudioParams();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  for (int i=0; i<kSectionLength.toDouble(); i++) {
+    RenderManager::RenderAudioParams rap(sequence->GetConnectedSampleOutput(),
+                                         TimeRange(i, i + 1),
+                                         params,
+                                         RenderMode::kOffline);
+
+    RenderTicketPtr ticket = RenderManager::instance()->RenderAudio(rap);
+    ticket->WaitForFinished();
+
+    if (!ticket->HasResult()) {
+      std::cerr << "Failed to render audio at " << i << "s" << std::endl;
+      return false;
+    }
+  }
+
+  AddResult(QStringLiteral("audio_mixdown"), kSectionLength.toDouble() / Seconds(timer), QStringLiteral("x realtime"), true);
+
+  return true;
+}
+
+bool Benchmark::BenchWaveform(const AudioParams &params)
+{
+  const rational length(60);
+  SampleBuffer tone = CreateTone(params, length);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  AudioVisualWaveform waveform;
+  waveform.set_channel_count(params.channel_count());
+  waveform.OverwriteSamples(tone, params.sample_rate());
+
+  AddResult(QStringLiteral("waveform_generation"), length.toDouble() / Seconds(timer), QStringLiteral("x realtime"), true);
+
+  return true;
+}
+
+bool Benchmark::BenchFrameCache(const VideoParams &params)
+{
+  FramePtr frame = Frame::Create();
+  frame->set_video_params(params);
+  frame->allocate();
+
+  // Gradient rather than a flat color so compression has some work to do
+  for (int y=0; y<params.height(); y++) {
+    char *line = frame->data() + y * frame->linesize_bytes();
+    for (int x=0; x<frame->linesize_bytes(); x++) {
+      line[x] = char((x + y) & 0xFF);
+    }
+  }
+
+  QVector<QString> filenames(params_.frames);
+  for (int i=0; i<params_.frames; i++) {
+    filenames[i] = temp_dir_.filePath(QStringLiteral("frame%1.exr").arg(i));
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  for (const QString &fn : filenames) {
+    if (!FrameHashCache::SaveCacheFrame(fn, frame)) {
+      std::cerr << "Failed to save cache frame" << std::endl;
+      return false;
+    }
+  }
+
+  AddResult(QStringLiteral("frame_cache_save"), params_.frames / Seconds(timer), QStringLiteral("fps"), true);
+
+  timer.restart();
+
+  for (const QString &fn : filenames) {
+    if (!FrameHashCache::LoadCacheFrame(fn)) {
+      std::cerr << "Failed to load cache frame" << std::endl;
+      return false;
+    }
+  }
+
+  AddResult(QStringLiteral("frame_cache_load"), params_.frames / Seconds(timer), QStringLiteral("fps"), true);
+  AddResult(QStringLiteral("frame_pool_hit_rate"), FrameManager::GetStatistics().hit_rate() * 100.0, QStringLiteral("%"), true);
+
+  for (const QString &fn : filenames) {
+    QFile::remove(fn);
+  }
+
+  return true;
+}
+
+bool Benchmark::BenchProjectSaveLoad(Project *project)
+{
+  QString filename = temp_dir_.filePath(QStringLiteral("bench.ove"));
+
+  ProjectSerializer::SaveData data(ProjectSerializer::kProject, project, filename);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  if (ProjectSerializer::Save(data, ProjectSerializer::kCompressedXml) != ProjectSerializer::kSuccess) {
+    std::cerr << "Failed to save project" << std::endl;
+    return false;
+  }
+
+  AddResult(QStringLiteral("project_save"), Seconds(timer) * 1000.0, QStringLiteral("ms"), false);
+
+  Project loaded;
+
+  timer.restart();
+
+  if (ProjectSerializer::Load(&loaded, filename, ProjectSerializer::kProject) != ProjectSerializer::kSuccess) {
+    std::cerr << "Failed to load project" << std::endl;
+    return false;
+  }
+
+  AddResult(QStringLiteral("project_load"), Seconds(timer) * 1000.0, QStringLiteral("ms"), false);
+
+  return true;
+}
+
+bool Benchmark::Run()
+{
+  Project project;
+  Sequence *sequence = CreateSyntheticSequence(&project);
+
+  // Keep going after a failure so the rest still get reported
+  bool ok = BenchTraversal(sequence);
+
+  if (params_.gpu) {
+    ok &= BenchRender(sequence);
+  }
+
+  ok &= BenchAudioMixdown(sequence);
+  ok &= BenchWaveform(sequence->GetAudioParams());
+  ok &= BenchFrameCache(VideoParams(params_.width, params_.height, PixelFormat::F16, VideoParams::kRGBAChannelCount));
+  ok &= BenchProjectSaveLoad(&project);
+
+  return ok;
+}
+
+QJsonDocument Benchmark::ToJson() const
+{
+  QJsonObject parameters;
+  parameters.insert(QStringLiteral("video_tracks"), params_.video_tracks);
+  parameters.insert(QStringLiteral("audio_tracks"), params_.audio_tracks);
+  parameters.insert(QStringLiteral("frames"), params_.frames);
+  parameters.insert(QStringLiteral("width"), params_.width);
+  parameters.insert(QStringLiteral("height"), params_.height);
+
+  QJsonArray results;
+  for (const Result &r : results_) {
+    QJsonObject o;
+    o.insert(QStringLiteral("name"), r.name);
+    o.insert(QStringLiteral("value"), r.value);
+    o.insert(QStringLiteral("unit"), r.unit);
+    o.insert(QStringLiteral("higher_is_better"), r.higher_is_better);
+    results.append(o);
+  }
+
+  QJsonObject root;
+  root.insert(QStringLiteral("parameters"), parameters);
+  root.insert(QStringLiteral("results"), results);
+  return QJsonDocument(root);
+}
+
+int Benchmark::CompareToBaseline(const QJsonDocument &baseline, double tolerance) const
+{
+  QHash<QString, double> baseline_values;
+  const QJsonArray baseline_results = baseline.object().value(QStringLiteral("results")).toArray();
+  for (const QJsonValue &v : baseline_results) {
+    QJsonObject o = v.toObject();
+    baseline_values.insert(o.value(QStringLiteral("name")).toString(), o.value(QStringLiteral("value")).toDouble());
+  }
+
+  int regressions = 0;
+
+  for (const Result &r : results_) {
+    if (!baseline_values.contains(r.name)) {
+      std::cout << "MISSING FROM BASELINE: " << r.name.toStdString() << std::endl;
+      regressions++;
+      continue;
+    }
+
+    double base = baseline_values.take(r.name);
+    bool regressed = r.higher_is_better ? (r.value < base * (1.0 - tolerance)) : (r.value > base * (1.0 + tolerance));
+
+    if (regressed) {
+      std::cout << "REGRESSION: " << r.name.toStdString() << " " << r.value << " " << r.unit.toStdString()
+                << " (baseline " << base << ")" << std::endl;
+      regressions++;
+    }
+  }
+
+  // Anything left in the baseline wasn't measured this time
+  for (auto it=baseline_values.cbegin(); it!=baseline_values.cend(); it++) {
+    std::cout << "MISSING FROM RESULTS: " << it.key().toStdString() << std::endl;
+    regressions++;
+  }
+
+  return regressions;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  using namespace olive;
+
+  QCoreApplication::setAttribute(Qt::AA_UseDesktopOpenGL);
+  QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
+  QSurfaceFormat format;
+  format.setVersion(3, 2);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+  QSurfaceFormat::setDefaultFormat(format);
+
+  QApplication a(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Olive performance benchmarks"));
+  parser.addHelpOption();
+
+  QCommandLineOption output_option(QStringLiteral("output"), QStringLiteral("Write results to JSON file."), QStringLiteral("file"));
+  QCommandLineOption baseline_option(QStringLiteral("baseline"), QStringLiteral("Fail if results regress from this JSON file."), QStringLiteral("file"));
+  QCommandLineOption tolerance_option(QStringLiteral("tolerance"), QStringLiteral("Allowed fraction of regression (default 0.15)."), QStringLiteral("fraction"), QStringLiteral("0.15"));
+  QCommandLineOption video_option(QStringLiteral("video-tracks"), QStringLiteral("Number of video tracks (default 4)."), QStringLiteral("n"), QStringLiteral("4"));
+  QCommandLineOption audio_option(QStringLiteral("audio-tracks"), QStringLiteral("Number of audio tracks (default 8)."), QStringLiteral("n"), QStringLiteral("8"));
+  QCommandLineOption frames_option(QStringLiteral("frames"), QStringLiteral("Number of frames per section in video benchmarks (default 120)."), QStringLiteral("n"), QStringLiteral("120"));
+  QCommandLineOption no_gpu_option(QStringLiteral("no-gpu"), QStringLiteral("Skip benchmarks that need an OpenGL context."));
+  parser.addOptions({output_option, baseline_option, tolerance_option, video_option, audio_option, frames_option, no_gpu_option});
+
+  parser.process(a);
+
+  BenchmarkParams params;
+  params.video_tracks = parser.value(video_option).toInt();
+  params.audio_tracks = parser.value(audio_option).toInt();
+  params.frames = qMax(1, parser.value(frames_option).toInt());
+  params.width = 1920;
+  params.height = 1080;
+  params.gpu = !parser.isSet(no_gpu_option);
+
+  qRegisterMetaType<olive::core::rational>();
+  qRegisterMetaType<NodeValue>();
+  qRegisterMetaType<NodeValueTable>();
+  qRegisterMetaType<FramePtr>();
+  qRegisterMetaType<SampleBuffer>();
+  qRegisterMetaType<AudioParams>();
+  qRegisterMetaType<olive::core::TimeRange>();
+  qRegisterMetaType<olive::AudioVisualWaveform>();
+  qRegisterMetaType<olive::VideoParams>();
+  qRegisterMetaType<olive::RenderTicketPtr>();
+
+  NodeFactory::Initialize();
+  ColorManager::SetUpDefaultConfig();
+  TaskManager::CreateInstance();
+  ConformManager::CreateInstance();
+  RenderManager::CreateInstance();
+  FrameManager::CreateInstance();
+  ProjectSerializer::Initialize();
+
+  int ret = 0;
+
+  {
+    Benchmark bench(params);
+    if (!bench.Run()) {
+      ret = 1;
+    }
+
+    if (parser.isSet(output_option)) {
+      QFile f(parser.value(output_option));
+      if (f.open(QFile::WriteOnly | QFile::Truncate)) {
+        f.write(bench.ToJson().toJson());
+      } else {
+        std::cerr << "Failed to open output file" << std::endl;
+        ret = 1;
+      }
+    }
+
+    if (parser.isSet(baseline_option)) {
+      QFile f(parser.value(baseline_option));
+      if (f.open(QFile::ReadOnly)) {
+        if (bench.CompareToBaseline(QJsonDocument::fromJson(f.readAll()), parser.value(tolerance_option).toDouble()) > 0) {
+          ret = 1;
+        }
+      } else {
+        std::cerr << "Failed to open baseline file" << std::endl;
+        ret = 1;
+      }
+    }
+  }
+
+  ProjectSerializer::Destroy();
+  FrameManager::DestroyInstance();
+  RenderManager::DestroyInstance();
+  ConformManager::DestroyInstance();
+  TaskManager::DestroyInstance();
+  NodeFactory::Destroy();
+
+  return ret;
+}
@@ -21,6 +21,7 @@
 #include "testutil.h"
 
 #include "common/digit.h"
+#include "render/framemanager.h"
 
 namespace olive {
 
@@ -46,4 +47,23 @@ OLIVE_ADD_TEST(DigitTest)
   OLIVE_TEST_END;
 }
 
+OLIVE_ADD_TEST(FrameSizeClassTest)
+{
+  // Four classes per power of two, the smallest being 4 KiB
+  OLIVE_ASSERT_EQUAL(FrameManager::GetClassSize(FrameManager::GetSizeClass(1)), 4096);
+  OLIVE_ASSERT_EQUAL(FrameManager::GetClassSize(FrameManager::GetSizeClass(4096)), 4096);
+  OLIVE_ASSERT_EQUAL(FrameManager::GetClassSize(FrameManager::GetSizeClass(4097)), 5120);
+  OLIVE_ASSERT_EQUAL(FrameManager::GetClassSize(FrameManager::GetSizeClass(8192)), 8192);
+  OLIVE_ASSERT_EQUAL(FrameManager::GetClassSize(FrameManager::GetSizeClass(8193)), 10240);
+
+  // Every size gets the smallest class that fits it
+  for (int size=1; size<=(1 << 20); size+=7) {
+    int size_class = FrameManager::GetSizeClass(size);
+    OLIVE_ASSERT(FrameManager::GetClassSize(size_class) >= size);
+    OLIVE_ASSERT(size_class == 0 || FrameManager::GetClassSize(size_class - 1) < size);
+  }
+
+  OLIVE_TEST_END;
+}
+
 }
@@ -0,0 +1,94 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "testutil.h"
+
+#include "widget/scope/scopeanalyzer/scopeanalyzer.h"
+
+namespace olive {
+
+OLIVE_ADD_TEST(ScopeAnalyzeSyntheticFrame)
+{
+  // Null frames produce a null result
+  OLIVE_ASSERT(ScopeAnalyzer::AnalyzeFrame(nullptr, nullptr, QVector3D(0.2126f, 0.7152f, 0.0722f)).is_null());
+
+  // 4x2 frame, already in display space, with one solid color per column
+  const float columns[4][4] = {
+    {0.0f, 0.0f, 0.0f, 1.0f}, // Black
+    {1.0f, 1.0f, 1.0f, 1.0f}, // White
+    {1.0f, 0.0f, 0.0f, 1.0f}, // Red
+    {0.0f, 0.0f, 1.0f, 1.0f}, // Blue
+  };
+
+  FramePtr frame = Frame::Create();
+  frame->set_video_params(VideoParams(4, 2, PixelFormat::F32, VideoParams::kRGBAChannelCount));
+  OLIVE_ASSERT(frame->allocate());
+
+  for (int y=0; y<frame->height(); y++) {
+    float *row = reinterpret_cast<float*>(frame->data() + y * frame->linesize_bytes());
+    memcpy(row, columns, sizeof(columns));
+  }
+
+  ScopeAnalyzer::Result result = ScopeAnalyzer::AnalyzeFrame(frame, nullptr, QVector3D(0.2126f, 0.7152f, 0.0722f));
+  OLIVE_ASSERT(!result.is_null());
+
+  // Histogram is normalized against the tallest bin, which is green's 6 zeros
+  const float peak = 6.0f;
+  const int bins = ScopeAnalyzer::kHistogramBins;
+  OLIVE_ASSERT_EQUAL(result.histogram[ScopeAnalyzer::kRed].size(), bins);
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kRed][0], 4.0f / peak));
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kRed][255], 4.0f / peak));
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kGreen][0], 1.0f));
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kGreen][255], 2.0f / peak));
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kBlue][0], 4.0f / peak));
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kBlue][255], 4.0f / peak));
+  OLIVE_ASSERT_EQUAL(result.histogram[ScopeAnalyzer::kRed][128], 0.0f);
+
+  // Luma of black, blue, red and white lands in separate bins
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kLuma][0], 2.0f / peak));
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kLuma][18], 2.0f / peak));
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kLuma][54], 2.0f / peak));
+  OLIVE_ASSERT(qFuzzyCompare(result.histogram[ScopeAnalyzer::kLuma][255], 2.0f / peak));
+
+  // One waveform column per frame column, 1.0 at the top row. Every lit point has the same count
+  // so it's at full density.
+  OLIVE_ASSERT_EQUAL(result.waveform.width(), 4);
+  const int levels = ScopeAnalyzer::kWaveformLevels;
+  OLIVE_ASSERT_EQUAL(result.waveform.height(), levels);
+
+  const int top = 0;
+  const int bottom = levels - 1;
+  OLIVE_ASSERT_EQUAL(result.waveform.pixel(0, top), qRgb(0, 0, 0));
+  OLIVE_ASSERT_EQUAL(result.waveform.pixel(0, bottom), qRgb(255, 255, 255));
+  OLIVE_ASSERT_EQUAL(result.waveform.pixel(1, top), qRgb(255, 255, 255));
+  OLIVE_ASSERT_EQUAL(result.waveform.pixel(1, bottom), qRgb(0, 0, 0));
+  OLIVE_ASSERT_EQUAL(result.waveform.pixel(2, top), qRgb(255, 0, 0));
+  OLIVE_ASSERT_EQUAL(result.waveform.pixel(2, bottom), qRgb(0, 255, 255));
+  OLIVE_ASSERT_EQUAL(result.waveform.pixel(3, top), qRgb(0, 0, 255));
+  OLIVE_ASSERT_EQUAL(result.waveform.pixel(3, bottom), qRgb(255, 255, 0));
+
+  for (int x=0; x<4; x++) {
+    OLIVE_ASSERT_EQUAL(result.waveform.pixel(x, 128), qRgb(0, 0, 0));
+  }
+
+  OLIVE_TEST_END;
+}
+
+}
@@ -0,0 +1,93 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2022 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "testutil.h"
+
+#include "node/project/serializer/binaryformat.h"
+
+namespace olive {
+
+OLIVE_ADD_TEST(ProjectBinaryRoundTrip)
+{
+  const QString xml = QStringLiteral(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<olive version=\"230220\">\n"
+        "  <project>\n"
+        "    <nodes version=\"1\">\n"
+        "      <node id=\"org.olivevideoeditor.Olive.transform\" ptr=\"1\">\n"
+        "        <label> &lt;Spaced&gt; &amp; \u00e9 </label>\n"
+        "        <input id=\"pos\">\n"
+        "          <keyframes>\n"
+        "            <track>\n"
+        "              <key input=\"pos\" time=\"0/1\">0:0</key>\n"
+        "              <key input=\"pos\" time=\"1/1\">1:1</key>\n"
+        "            </track>\n"
+        "          </keyframes>\n"
+        "        </input>\n"
+        "        <custom/>\n"
+        "      </node>\n"
+        "    </nodes>\n"
+        "  </project>\n"
+        "</olive>\n");
+
+  QXmlStreamReader xml_reader(xml);
+  QByteArray binary;
+  OLIVE_ASSERT(ProjectBinaryFormat::FromXml(&xml_reader, &binary));
+
+  ProjectBinaryFormat::Reader reader(reinterpret_cast<const uchar*>(binary.constData()), binary.size());
+  OLIVE_ASSERT(reader.IsValid());
+  OLIVE_ASSERT_EQUAL(reader.GetElementCount(), 11u);
+
+  // Elements are in document order, each one knowing its parent and where its subtree ends
+  ProjectBinaryFormat::ElementRecord node = reader.GetElement(3);
+  OLIVE_ASSERT(reader.GetString(node.name) == QStringLiteral("node"));
+  OLIVE_ASSERT_EQUAL(node.parent, 2u);
+  OLIVE_ASSERT_EQUAL(node.end, 11u);
+  OLIVE_ASSERT_EQUAL(node.attribute_count, 2u);
+  OLIVE_ASSERT(node.text == ProjectBinaryFormat::kNone);
+
+  ProjectBinaryFormat::ElementRecord key = reader.GetElement(9);
+  OLIVE_ASSERT(reader.GetString(key.name) == QStringLiteral("key"));
+  OLIVE_ASSERT_EQUAL(key.parent, 7u);
+  OLIVE_ASSERT(reader.GetString(key.text) == QStringLiteral("1:1"));
+  OLIVE_ASSERT(reader.GetString(reader.GetAttribute(key.first_attribute + 1).value) == QStringLiteral("1/1"));
+
+  // Repeated strings are only stored once
+  OLIVE_ASSERT_EQUAL(reader.GetAttribute(key.first_attribute).name, reader.GetAttribute(reader.GetElement(8).first_attribute).name);
+
+  ProjectBinaryFormat::ElementRecord label = reader.GetElement(4);
+  OLIVE_ASSERT(reader.GetString(label.text) == QStringLiteral(" <Spaced> & \u00e9 "));
+
+  // Converting back to XML and to binary again must give exactly the same file
+  QByteArray round_trip_xml;
+  OLIVE_ASSERT(ProjectBinaryFormat::ToXml(reinterpret_cast<const uchar*>(binary.constData()), binary.size(), &round_trip_xml));
+
+  QXmlStreamReader round_trip_reader(round_trip_xml);
+  QByteArray round_trip_binary;
+  OLIVE_ASSERT(ProjectBinaryFormat::FromXml(&round_trip_reader, &round_trip_binary));
+  OLIVE_ASSERT(round_trip_binary == binary);
+
+  // Corrupt files must be rejected rather than read out of bounds
+  OLIVE_ASSERT(!ProjectBinaryFormat::Reader(reinterpret_cast<const uchar*>(binary.constData()), binary.size() / 2).IsValid());
+
+  OLIVE_TEST_END;
+}
+
+}
@@ -21,6 +21,7 @@
 #include "testutil.h"
 
 #include "node/filter/shader/shaderinputsparser.h"
+#include "render/shaderfusion.h"
 
 // shortcut for std::string
 #define STR(x)   QString(x).toStdString()
@@ -533,6 +534,163 @@ OLIVE_ADD_TEST(WrongNumOfIterations)
   OLIVE_TEST_END;
 }
 
+// Fragment shader that only samples its main input at the fragment's own coordinate
+static const char *kFusionPassthrough =
+    "uniform sampler2D tex_in;""\n"
+    "in vec2 ove_texcoord;""\n"
+    "out vec4 frag_color;""\n"
+    "void main()""\n"
+    "{""\n"
+    "  frag_color = texture(tex_in, ove_texcoord);""\n"
+    "}""\n";
+
+static ShaderCode FuseTwo(const QString &first, const QString &second, const QString &pointwise_input = QStringLiteral("tex_in"))
+{
+  QVector<ShaderFusion::Stage> stages(2);
+  stages[0].code = ShaderCode(first);
+  stages[1].code = ShaderCode(second);
+  stages[1].pointwise_input = pointwise_input;
+  return ShaderFusion::Fuse(stages);
+}
+
+// Globals are prefixed per stage and the main input is replaced by the previous stage
+OLIVE_ADD_TEST(FusionRenameTest)
+{
+  QString first(
+        "uniform sampler2D tex_in;""\n"
+        "uniform float amount;""\n"
+        "in vec2 ove_texcoord;""\n"
+        "out vec4 frag_color;""\n"
+        "vec4 scale(vec4 c)""\n"
+        "{""\n"
+        "  return c * amount;""\n"
+        "}""\n"
+        "void main()""\n"
+        "{""\n"
+        "  frag_color = scale(texture(tex_in, ove_texcoord));""\n"
+        "}""\n"
+        );
+
+  QString second(
+        "uniform sampler2D tex_in;""\n"
+        "uniform bool tex_in_enabled;""\n"
+        "uniform float amount;""\n"
+        "in vec2 ove_texcoord;""\n"
+        "out vec4 frag_color;""\n"
+        "void main()""\n"
+        "{""\n"
+        "  if (tex_in_enabled) {""\n"
+        "    frag_color = texture(tex_in, ove_texcoord) + vec4(amount);""\n"
+        "  }""\n"
+        "}""\n"
+        );
+
+  ShaderCode fused = FuseTwo(first, second);
+  const QString &code = fused.frag_code();
+
+  OLIVE_ASSERT(!code.isEmpty());
+  OLIVE_ASSERT(fused.vert_code().isEmpty());
+
+  // Uniforms and functions of each stage can't collide
+  OLIVE_ASSERT(code.contains(QStringLiteral("uniform sampler2D ove_s0_tex_in;")));
+  OLIVE_ASSERT(code.contains(QStringLiteral("uniform float ove_s0_amount;")));
+  OLIVE_ASSERT(code.contains(QStringLiteral("uniform float ove_s1_amount;")));
+  OLIVE_ASSERT(code.contains(QStringLiteral("vec4 ove_s0_scale(vec4 c)")));
+  OLIVE_ASSERT(code.contains(QStringLiteral("return c * ove_s0_amount;")));
+
+  // Each main() becomes a stage function
+  OLIVE_ASSERT(code.contains(QStringLiteral("vec4 ove_stage0(vec2 ove_texcoord)")));
+  OLIVE_ASSERT(code.contains(QStringLiteral("vec4 ove_stage1(vec2 ove_texcoord)")));
+  OLIVE_ASSERT(code.contains(QStringLiteral("frag_color = ove_s0_scale(texture(ove_s0_tex_in, ove_texcoord));")));
+
+  // The second stage's main input and its enabled flag are gone
+  OLIVE_ASSERT(code.contains(QStringLiteral("frag_color = ove_stage0(ove_texcoord) + vec4(ove_s1_amount);")));
+  OLIVE_ASSERT(code.contains(QStringLiteral("if (true)")));
+  OLIVE_ASSERT(!code.contains(QStringLiteral("ove_s1_tex_in")));
+  OLIVE_ASSERT(!code.contains(QStringLiteral("tex_in_enabled")));
+
+  // Varyings are declared once and the real main() runs the last stage
+  OLIVE_ASSERT_EQUAL(code.count(QStringLiteral("in vec2 ove_texcoord;")), 1);
+  OLIVE_ASSERT_EQUAL(code.count(QStringLiteral("out vec4 frag_color;")), 1);
+  OLIVE_ASSERT(code.contains(QStringLiteral("frag_color = ove_stage1(ove_texcoord);")));
+
+  OLIVE_TEST_END;
+}
+
+// Anything the rewriter doesn't understand makes fusion fail rather than produce a wrong program
+OLIVE_ADD_TEST(FusionBailOutTest)
+{
+  const QString pass(kFusionPassthrough);
+
+  // Sanity check that the passthrough itself fuses
+  OLIVE_ASSERT(!FuseTwo(pass, pass).frag_code().isEmpty());
+
+  // A single stage has nothing to fuse
+  QVector<ShaderFusion::Stage> single(1);
+  single[0].code = ShaderCode(pass);
+  OLIVE_ASSERT(ShaderFusion::Fuse(single).frag_code().isEmpty());
+
+  // Later stages need to know their main input
+  OLIVE_ASSERT(FuseTwo(pass, pass, QString()).frag_code().isEmpty());
+
+  // Custom vertex shader
+  QVector<ShaderFusion::Stage> vertex(2);
+  vertex[0].code = ShaderCode(pass, QStringLiteral("void main() {}"));
+  vertex[1].code = ShaderCode(pass);
+  vertex[1].pointwise_input = QStringLiteral("tex_in");
+  OLIVE_ASSERT(ShaderFusion::Fuse(vertex).frag_code().isEmpty());
+
+  // Full program with its own version
+  OLIVE_ASSERT(FuseTwo(QStringLiteral("#version 150\n") + pass, pass).frag_code().isEmpty());
+
+  // Structs
+  OLIVE_ASSERT(FuseTwo(QStringLiteral("struct Foo { float a; };\n") + pass, pass).frag_code().isEmpty());
+
+  // Unknown varying
+  OLIVE_ASSERT(FuseTwo(QStringLiteral("in vec4 color_in;\n") + pass, pass).frag_code().isEmpty());
+
+  // Unterminated comment
+  OLIVE_ASSERT(FuseTwo(pass + QStringLiteral("/* unterminated"), pass).frag_code().isEmpty());
+
+  // Output written outside of main()
+  QString helper_writes_output(
+        "uniform sampler2D tex_in;""\n"
+        "in vec2 ove_texcoord;""\n"
+        "out vec4 frag_color;""\n"
+        "void write() { frag_color = vec4(1.0); }""\n"
+        "void main()""\n"
+        "{""\n"
+        "  write();""\n"
+        "}""\n"
+        );
+  OLIVE_ASSERT(FuseTwo(pass, helper_writes_output).frag_code().isEmpty());
+
+  // Main input sampled somewhere other than this fragment
+  QString offset_sample(
+        "uniform sampler2D tex_in;""\n"
+        "in vec2 ove_texcoord;""\n"
+        "out vec4 frag_color;""\n"
+        "void main()""\n"
+        "{""\n"
+        "  frag_color = texture(tex_in, ove_texcoord + vec2(0.01));""\n"
+        "}""\n"
+        );
+  OLIVE_ASSERT(FuseTwo(pass, offset_sample).frag_code().isEmpty());
+
+  // Main input isn't a texture
+  QString float_input(
+        "uniform float tex_in;""\n"
+        "in vec2 ove_texcoord;""\n"
+        "out vec4 frag_color;""\n"
+        "void main()""\n"
+        "{""\n"
+        "  frag_color = vec4(tex_in);""\n"
+        "}""\n"
+        );
+  OLIVE_ASSERT(FuseTwo(pass, float_input).frag_code().isEmpty());
+
+  OLIVE_TEST_END;
+}
 
 }  // olive
 
@@ -601,4 +601,71 @@ OLIVE_ADD_TEST(InsertGaps_SingleTrack)
   OLIVE_TEST_END;
 }
 
+OLIVE_ADD_TEST(BlockLookup)
+{
+  TIMELINE_TEST_START;
+
+  sequence.add_default_nodes();
+
+  Track* track = sequence.GetTracks().first();
+
+  // Blocks at [0, 2), [2, 5) and [5, 6)
+  ClipBlock* a = new ClipBlock();
+  a->set_length_and_media_out(2);
+  a->setParent(&project);
+  track->AppendBlock(a);
+
+  ClipBlock* b = new ClipBlock();
+  b->set_length_and_media_out(3);
+  b->setParent(&project);
+  track->AppendBlock(b);
+
+  ClipBlock* c = new ClipBlock();
+  c->set_length_and_media_out(1);
+  c->setParent(&project);
+  track->AppendBlock(c);
+
+  OLIVE_ASSERT(track->BlockContainingTime(1) == a);
+  OLIVE_ASSERT(track->BlockContainingTime(2) == nullptr);
+  OLIVE_ASSERT(track->BlockContainingTime(rational(7, 2)) == b);
+  OLIVE_ASSERT(track->BlockContainingTime(6) == nullptr);
+
+  OLIVE_ASSERT(track->NearestBlockBefore(2) == a);
+  OLIVE_ASSERT(track->NearestBlockBefore(0) == nullptr);
+  OLIVE_ASSERT(track->NearestBlockBefore(3) == b);
+  OLIVE_ASSERT(track->NearestBlockBefore(7) == nullptr);
+
+  OLIVE_ASSERT(track->NearestBlockBeforeOrAt(0) == a);
+  OLIVE_ASSERT(track->NearestBlockBeforeOrAt(2) == b);
+  OLIVE_ASSERT(track->NearestBlockBeforeOrAt(5) == c);
+  OLIVE_ASSERT(track->NearestBlockBeforeOrAt(6) == nullptr);
+
+  OLIVE_ASSERT(track->NearestBlockAfterOrAt(0) == a);
+  OLIVE_ASSERT(track->NearestBlockAfterOrAt(1) == b);
+  OLIVE_ASSERT(track->NearestBlockAfterOrAt(5) == c);
+  OLIVE_ASSERT(track->NearestBlockAfterOrAt(6) == nullptr);
+
+  OLIVE_ASSERT(track->NearestBlockAfter(0) == b);
+  OLIVE_ASSERT(track->NearestBlockAfter(2) == c);
+  OLIVE_ASSERT(track->NearestBlockAfter(5) == nullptr);
+
+  {
+    // Lookups must follow ripples
+    BlockTrimCommand command(track, a, 1, Timeline::kTrimOut);
+    command.redo_now();
+
+    OLIVE_ASSERT(a->out() == 1);
+    OLIVE_ASSERT(track->BlockContainingTime(rational(1, 2)) == a);
+    OLIVE_ASSERT(track->NearestBlockBeforeOrAt(1) == a->next());
+    OLIVE_ASSERT(track->NearestBlockAfter(0) == a->next());
+
+    command.undo_now();
+
+    OLIVE_ASSERT(track->BlockContainingTime(rational(3, 2)) == a);
+    OLIVE_ASSERT(track->NearestBlockAfter(0) == b);
+  }
+
+  OLIVE_TEST_END;
+}
+
 }